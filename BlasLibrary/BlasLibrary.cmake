@@ -18,6 +18,22 @@ if( NOT TARGET BlasLibrary )
 
     add_library( BlasLibrary STATIC ${SOURCES} )
 
-    target_link_libraries( BlasLibrary PUBLIC Eigen )
+    # Kernels/Kernels.cpp is also built for wider instruction sets, each copy
+    # in its own namespace, and Kernels/Dispatch.cpp picks one at run time
+    if( CMAKE_SYSTEM_PROCESSOR MATCHES "x86_64|AMD64|i.86" AND NOT EMSCRIPTEN )
+        foreach( isa avx2 avx512 )
+            add_library( BlasKernels_${isa} OBJECT ${CMAKE_CURRENT_LIST_DIR}/Source/Kernels/Kernels.cpp )
+            target_include_directories( BlasKernels_${isa} PRIVATE ${CMAKE_CURRENT_LIST_DIR}/Source )
+            target_compile_definitions( BlasKernels_${isa} PRIVATE BLAS_KERNELS_ISA=${isa} )
+            target_sources( BlasLibrary PRIVATE $<TARGET_OBJECTS:BlasKernels_${isa}> )
+        endforeach()
+        target_compile_options( BlasKernels_avx2 PRIVATE -mavx2 -mfma )
+        target_compile_options( BlasKernels_avx512 PRIVATE -mavx512f -mavx2 -mfma )
+        target_compile_definitions( BlasLibrary PRIVATE BLAS_KERNELS_X86 )
+    endif()
+
+    find_package( Threads REQUIRED )
+
+    target_link_libraries( BlasLibrary PUBLIC Eigen Threads::Threads )
     target_include_directories( BlasLibrary PUBLIC ${CMAKE_CURRENT_LIST_DIR}/Source )
 endif()
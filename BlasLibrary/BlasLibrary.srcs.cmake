@@ -3,6 +3,17 @@ set( SOURCES "" )
 set( Source
     ${CMAKE_CURRENT_LIST_DIR}/Source/Blas.cpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/Blas.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/BlockSparse.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/BlockSparse.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/CpuFeatures.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/CpuFeatures.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/FFT.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/FFT.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/PackedMatrix.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/PackedMatrix.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/Simd.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/ThreadPool.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/ThreadPool.hpp
 )
 source_group( "Source" FILES ${Source} )
 list( APPEND SOURCES ${Source} )
@@ -17,6 +28,14 @@ set( Source_Eigen
 source_group( "Source\\Eigen" FILES ${Source_Eigen} )
 list( APPEND SOURCES ${Source_Eigen} )
 
+set( Source_Kernels
+    ${CMAKE_CURRENT_LIST_DIR}/Source/Kernels/Dispatch.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/Kernels/Kernels.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/Kernels/Kernels.hpp
+)
+source_group( "Source\\Kernels" FILES ${Source_Kernels} )
+list( APPEND SOURCES ${Source_Kernels} )
+
 set( Source_Naive
     ${CMAKE_CURRENT_LIST_DIR}/Source/Naive/BlasNaive.cpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/Naive/BlasNaive.hpp
@@ -2,14 +2,141 @@
 #include "Naive/BlasNaive.hpp"
 
 #include "Eigen/BlasEigen.hpp"
+#include "ThreadPool.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+// Multiply-adds a GEMM must have before it is split, and the least every
+// part gets: each part re-packs the operand it shares with the others and
+// has to wake a pool thread, which smaller parts do not pay back
+#define GEMM_PARALLEL_MIN_WORK (1 << 20)
+// Parts start at multiples of this, so they keep the kernels' register tiles
+#define GEMM_PARALLEL_ALIGN 8
 
 namespace Blas {
 
+namespace {
+
+std::atomic<int> gemm_threads(0);
+std::atomic<int> gemm_backend(GEMM_EIGEN);
+
+// Runs part(i0, mi, j0, nj) for blocks of rows [i0, i0 + mi) or columns
+// [j0, j0 + nj) of the m x n C that cover it, in parallel.  The longer side is
+// split, which keeps the operand every part re-packs the smaller one.
+template <typename Part>
+void parallelGemm(int m, int n, int k, const Part& part) {
+    const bool splitRows = m > n;
+    const int dim = splitRows ? m : n;
+    const double work = (double)m * n * k;
+    int parts = (int)std::min<double>(gemmThreads(), work / GEMM_PARALLEL_MIN_WORK);
+    parts = std::min(parts, (dim + GEMM_PARALLEL_ALIGN - 1) / GEMM_PARALLEL_ALIGN);
+    if (parts <= 1) {
+        part(0, m, 0, n);
+        return;
+    }
+    int step = (dim + parts - 1) / parts;
+    step = (step + GEMM_PARALLEL_ALIGN - 1) / GEMM_PARALLEL_ALIGN * GEMM_PARALLEL_ALIGN;
+    const int count = (dim + step - 1) / step;
+    ThreadPool::shared().parallelFor(count, count, [&](int index, int) {
+        const int lo = index * step;
+        const int len = std::min(step, dim - lo);
+        if (splitRows) {
+            part(lo, len, 0, n);
+        } else {
+            part(0, m, lo, len);
+        }
+    });
+}
+
+// Row i0 of op(A) and column j0 of op(B)
+inline float* rowOf(char trans, float* a, int lda, int i0) {
+    return (trans == 'n' || trans == 'N') ? a + i0 : a + (long)i0 * lda;
+}
+
+inline float* columnOf(char trans, float* b, int ldb, int j0) {
+    return (trans == 'n' || trans == 'N') ? b + (long)j0 * ldb : b + j0;
+}
+
+// Eigen's blocking reads the cache sizes from a function local static
+// (manage_caching_sizes), which gets no guard as we build with
+// -fno-threadsafe-statics.  One serial product initializes it before any
+// two threads (a split GEMM's parts, or callers on the pool) can race on it.
+std::once_flag eigenOnce;
+
+void primeEigen() {
+    std::call_once(eigenOnce, [] {
+        float a = 0, b = 0, c = 0;
+        BlasEigen::gemm('n', 'n', 1, 1, 1, 1, &a, 1, &b, 1, 0, &c, 1);
+    });
+}
+
+bool nativeGemm() {
+    return gemmBackend() == GEMM_NATIVE;
+}
+
+}
+
+void setGemmThreads(int threads) {
+    gemm_threads = std::max(threads, 0);
+}
+
+int gemmThreads() {
+    const int threads = gemm_threads;
+    return threads > 0 ? threads : ThreadPool::shared().threads();
+}
+
+void setGemmBackend(GemmBackend backend) {
+    gemm_backend = backend;
+}
+
+GemmBackend gemmBackend() {
+    return (GemmBackend)gemm_backend.load();
+}
+
 void gemm(char transA, char transB, int m, int n, int k, float alpha, float* a, int lda,
             float* b, int ldb, float beta, float* c, int ldc) {
 
-    BlasEigen::gemm(transA, transB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+    const bool native = nativeGemm();
+    if (!native) {
+        primeEigen();
+    }
+    parallelGemm(m, n, k, [&](int i0, int mi, int j0, int nj) {
+        float* ai = rowOf(transA, a, lda, i0);
+        float* bj = columnOf(transB, b, ldb, j0);
+        float* cij = c + i0 + (long)j0 * ldc;
+        if (native) {
+            BlasNaive::gemm(transA, transB, mi, nj, k, alpha, ai, lda, bj, ldb, beta, cij, ldc);
+        } else {
+            BlasEigen::gemm(transA, transB, mi, nj, k, alpha, ai, lda, bj, ldb, beta, cij, ldc);
+        }
+    });
+
+}
+
+void gemmBias(char transA, char transB, int m, int n, int k, float alpha, float* a, int lda,
+            float* b, int ldb, float beta, float* c, int ldc, const float* bias,
+            BiasMode biasMode) {
+
+    const bool native = nativeGemm();
+    if (!native) {
+        primeEigen();
+    }
+    const bool perColumn = biasMode == BIAS_COLUMNS;
+    parallelGemm(m, n, k, [&](int i0, int mi, int j0, int nj) {
+        float* ai = rowOf(transA, a, lda, i0);
+        float* bj = columnOf(transB, b, ldb, j0);
+        float* cij = c + i0 + (long)j0 * ldc;
+        const float* part = bias + (perColumn ? j0 : i0);
+        if (native) {
+            BlasNaive::gemmBias(transA, transB, mi, nj, k, alpha, ai, lda, bj, ldb, beta, cij,
+                ldc, part, perColumn);
+        } else {
+            BlasEigen::gemmBias(transA, transB, mi, nj, k, alpha, ai, lda, bj, ldb, beta, cij,
+                ldc, part, perColumn);
+        }
+    });
 
 }
 
@@ -19,4 +146,12 @@ void im2col(float* imgData, int channels, int height, int width, int kernelH, in
     BlasNaive::im2col(imgData, channels, height, width, kernelH, kernelW, padH, padW, strideH, strideW, colData);
 }
 
+void im2colRows(float* imgData, int channels, int height, int width, int kernelH, int kernelW,
+              int padH, int padW, int strideH, int strideW, int firstRow, int numRows,
+              float* colData) {
+
+    BlasNaive::im2colRows(imgData, channels, height, width, kernelH, kernelW, padH, padW,
+        strideH, strideW, firstRow, numRows, colData);
+}
+
 }
@@ -2,11 +2,61 @@
 
 namespace Blas {
 
+// Bias applied by gemmBias while writing C (column major, m x n): BIAS_ROWS
+// adds bias[i] to every element of row i, BIAS_COLUMNS adds bias[j] to
+// every element of column j.
+enum BiasMode {
+    BIAS_ROWS,
+    BIAS_COLUMNS,
+};
+
+// gemm and gemmBias split products of more than GEMM_PARALLEL_MIN_WORK
+// multiply-adds over the shared ThreadPool, by blocks of rows or columns of
+// C.  setGemmThreads caps the threads one call may use (the calling thread
+// included); 1 keeps every call serial and 0, the default, allows one per
+// pool thread.
+//
+// TorchLib's convolutions multiply through PackedMatrix and Linear through
+// its own kernels, neither goes through gemm.  Its one caller there is
+// SpatialConvolutionFFT (FFT_CONV_BLOCK_BATCH x feats_out x feats_in per
+// frequency bin), which only reaches the split with feats_in * feats_out of
+// 2^17 or more; the split is for callers of gemm outside TorchLib.
+void setGemmThreads(int threads);
+int gemmThreads();
+
+// Implementation behind gemm and gemmBias: Eigen's, the default, or the
+// library's own register-blocked SGEMM (BlasNaive, on the kernels of the
+// running CPU).  The native one is faster on large square-ish products with
+// AVX2 / AVX-512, but packs both operands on every call and leaves most of
+// its tile idle when m is below the kernel's width: on SpatialConvolutionFFT,
+// the one caller in TorchLib (m = FFT_CONV_BLOCK_BATCH), it is 5-70% slower
+// than Eigen, so it is opt-in.
+enum GemmBackend {
+    GEMM_EIGEN,
+    GEMM_NATIVE,
+};
+
+void setGemmBackend(GemmBackend backend);
+GemmBackend gemmBackend();
+
 void gemm(char transA, char transB, int m, int n, int k, float alpha, float* a, int lda,
             float* b, int ldb, float beta, float* c, int ldc);
 
+// C = alpha * op(A) * op(B) + beta * C + bias, with the bias folded into the
+// pass over C the GEMM makes anyway (so it costs no extra pass or call).
+void gemmBias(char transA, char transB, int m, int n, int k, float alpha, float* a, int lda,
+            float* b, int ldb, float beta, float* c, int ldc, const float* bias,
+            BiasMode biasMode);
+
 void im2col(float* imgData, int channels, int height, int width, int kernelH, int kernelW,
               int padH, int padW, int strideH, int strideW, float* colData);
 
+// im2col restricted to output rows [firstRow, firstRow + numRows): colData
+// is ( channels * kernelH * kernelW ) x ( numRows * outputWidth ), so a
+// convolution can be computed one bounded panel of output rows at a time.
+void im2colRows(float* imgData, int channels, int height, int width, int kernelH, int kernelW,
+              int padH, int padW, int strideH, int strideW, int firstRow, int numRows,
+              float* colData);
+
 
 }
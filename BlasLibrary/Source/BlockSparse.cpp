@@ -0,0 +1,70 @@
+#include "BlockSparse.hpp"
+#include "Kernels/Kernels.hpp"
+
+#include <cstddef>
+
+namespace Blas {
+
+namespace {
+
+int const B = BlockSparseMatrix::BLOCK;
+
+}
+
+BlockSparseMatrix::BlockSparseMatrix() : m_( 0 ), k_( 0 ) {
+}
+
+void BlockSparseMatrix::pack( float const * a, int m, int k, int rowStride, int colStride ) {
+    clear();
+    m_ = m;
+    k_ = k;
+    int const mb = ( m + B - 1 ) / B;
+    int const kb = ( k + B - 1 ) / B;
+    rowStart_.reserve( mb + 1 );
+    for ( int br = 0; br < mb; br++ ) {
+        rowStart_.push_back( (int)col_.size() );
+        for ( int bc = 0; bc < kb; bc++ ) {
+            float block[ B * B ] = { 0 };
+            bool nonzero = false;
+            for ( int kk = 0; kk < B && bc * B + kk < k; kk++ ) {
+                for ( int r = 0; r < B && br * B + r < m; r++ ) {
+                    float const v = a[ (size_t)( br * B + r ) * rowStride +
+                                       (size_t)( bc * B + kk ) * colStride ];
+                    block[ kk * B + r ] = v;
+                    nonzero = nonzero || v != 0;
+                }
+            }
+            if ( nonzero ) {
+                col_.push_back( bc );
+                values_.insert( values_.end(), block, block + B * B );
+            }
+        }
+    }
+    rowStart_.push_back( (int)col_.size() );
+}
+
+void BlockSparseMatrix::clear() {
+    m_ = 0;
+    k_ = 0;
+    std::vector< int >().swap( rowStart_ );
+    std::vector< int >().swap( col_ );
+    std::vector< float >().swap( values_ );
+}
+
+float BlockSparseMatrix::density() const {
+    size_t const blocks = (size_t)( ( m_ + B - 1 ) / B ) * ( ( k_ + B - 1 ) / B );
+    return blocks == 0 ? 0 : (float)col_.size() / (float)blocks;
+}
+
+void BlockSparseMatrix::multiply( float const * b, int ldb, int n, float const * bias, int i0,
+                                  int in, float * c, int ldc ) const {
+    kernels().sparseMultiply( values_.data(), rowStart_.data(), col_.data(), m_, k_, b, ldb, n,
+                              bias, i0, in, c, ldc );
+}
+
+void BlockSparseMatrix::multiplyVector( float const * x, float const * bias, float * y ) const {
+    kernels().sparseMultiplyVector( values_.data(), rowStart_.data(), col_.data(), m_, k_, x,
+                                    bias, y );
+}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+
+namespace Blas {
+
+// Block compressed sparse row (BCSR) copy of a pruned m x k matrix.  The
+// matrix is cut into BLOCK x BLOCK blocks and only the blocks with a nonzero
+// value are stored (zero filled past the edges), so the products below skip
+// the work and the weight traffic of every zero block.  A block keeps its
+// BLOCK rows of one column together, so each input value meets a vector of
+// BLOCK weights.
+class BlockSparseMatrix {
+public:
+    enum { BLOCK = 4 };
+
+    BlockSparseMatrix();
+
+    // Packs the m x k matrix with element ( i, j ) at a[ i * rowStride +
+    // j * colStride ].
+    void pack( float const * a, int m, int k, int rowStride, int colStride );
+    void clear();
+
+    bool empty() const { return rowStart_.empty(); }
+    int rows() const { return m_; }
+    int cols() const { return k_; }
+    // Stored blocks over all blocks (of the matrix as packed)
+    float density() const;
+
+    // C = A * B + bias for rows [ i0, i0 + in ) of A: B is k x n with rows
+    // ldb apart, row i of C is at c + ( i - i0 ) * ldc and bias is indexed
+    // by the row of A.
+    void multiply( float const * b, int ldb, int n, float const * bias, int i0, int in,
+                   float * c, int ldc ) const;
+
+    // y = A * x + bias, blocks whose BLOCK inputs are all zero are skipped.
+    void multiplyVector( float const * x, float const * bias, float * y ) const;
+
+private:
+    int m_;
+    int k_;
+    std::vector< int > rowStart_;  // First block of every block row, and the end
+    std::vector< int > col_;  // Block column of every stored block
+    std::vector< float > values_;  // BLOCK * BLOCK per block, [ column ][ row ]
+};
+
+}
@@ -0,0 +1,67 @@
+#include "CpuFeatures.hpp"
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define BLAS_X86
+#endif
+
+namespace Blas {
+
+namespace {
+
+#ifdef BLAS_X86
+unsigned long long readXcr0() {
+    unsigned eax, edx;
+    __asm__ volatile( "xgetbv" : "=a"( eax ), "=d"( edx ) : "c"( 0 ) );
+    return ( (unsigned long long)edx << 32 ) | eax;
+}
+#endif
+
+unsigned detect() {
+    unsigned features = 0;
+#ifdef BLAS_X86
+    unsigned eax, ebx, ecx, edx;
+    if ( !__get_cpuid( 1, &eax, &ebx, &ecx, &edx ) ) return 0;
+    if ( edx & bit_SSE2  ) features |= CPU_SSE2;
+    if ( ecx & bit_SSE4_1 ) features |= CPU_SSE41;
+
+    // AVX state has to be enabled by the OS as well (OSXSAVE + XCR0)
+    bool const osxsave = ( ecx & bit_OSXSAVE ) != 0;
+    unsigned long long const xcr0 = osxsave ? readXcr0() : 0;
+    bool const ymm = ( xcr0 & 0x6 ) == 0x6;
+    bool const zmm = ( xcr0 & 0xe6 ) == 0xe6;
+    if ( ymm && ( ecx & bit_AVX ) ) features |= CPU_AVX;
+    if ( ymm && ( ecx & bit_FMA ) ) features |= CPU_FMA;
+
+    if ( __get_cpuid_max( 0, nullptr ) >= 7 ) {
+        __cpuid_count( 7, 0, eax, ebx, ecx, edx );
+        if ( ymm && ( ebx & bit_AVX2    ) ) features |= CPU_AVX2;
+        if ( zmm && ( ebx & bit_AVX512F ) ) features |= CPU_AVX512F;
+    }
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+    features |= CPU_NEON;
+#elif defined(__wasm_simd128__)
+    features |= CPU_WASM_SIMD128;
+#endif
+    return features;
+}
+
+// Constant-initialized, so no (non thread safe) static guard is involved
+std::atomic< unsigned > cachedFeatures{ 0 };
+unsigned const kDetected = 1u << 31;
+
+}
+
+unsigned cpuFeatures() {
+    unsigned features = cachedFeatures.load( std::memory_order_acquire );
+    if ( !( features & kDetected ) ) {
+        // Racing threads compute the same value, any of them may publish it
+        features = detect() | kDetected;
+        cachedFeatures.store( features, std::memory_order_release );
+    }
+    return features & ~kDetected;
+}
+
+}
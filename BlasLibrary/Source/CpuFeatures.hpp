@@ -0,0 +1,20 @@
+#pragma once
+
+namespace Blas {
+
+enum CpuFeature {
+    CPU_SSE2    = 1 << 0,
+    CPU_SSE41   = 1 << 1,
+    CPU_AVX     = 1 << 2,
+    CPU_AVX2    = 1 << 3,
+    CPU_FMA     = 1 << 4,
+    CPU_AVX512F = 1 << 5,
+    CPU_NEON    = 1 << 6,
+    CPU_WASM_SIMD128 = 1 << 7,
+};
+
+// Bitmask of CpuFeature supported by the running CPU (and enabled by the OS).
+// Detected once, safe to call from any thread.
+unsigned cpuFeatures();
+
+}
@@ -9,4 +9,34 @@ void gemm(char transA, char transB, int m, int n, int k, float alpha, float* a,
     eigen_gemm(&transA, &transB, &m, &n, &k, &alpha, a, &lda, b, &ldb, &beta, c, &ldc);
 }
 
+void gemmBias(char transA, char transB, int m, int n, int k, float alpha, float* a, int lda,
+            float* b, int ldb, float beta, float* c, int ldc, const float* bias,
+            bool perColumn) {
+
+    // Eigen's kernels have no epilogue hook, but eigen_gemm makes a pass over
+    // C for any beta != 1 (zero fill / scale) before accumulating into it.
+    // Doing that pass here with the bias added and running the product with
+    // beta = 1 applies the bias at no extra cost.
+    for (int j = 0; j < n; j++) {
+        float* col = c + (long)j * ldc;
+        if (perColumn) {
+            const float bj = bias[j];
+            if (beta == 0) {
+                for (int i = 0; i < m; i++) col[i] = bj;
+            } else {
+                for (int i = 0; i < m; i++) col[i] = beta * col[i] + bj;
+            }
+        } else {
+            if (beta == 0) {
+                for (int i = 0; i < m; i++) col[i] = bias[i];
+            } else {
+                for (int i = 0; i < m; i++) col[i] = beta * col[i] + bias[i];
+            }
+        }
+    }
+
+    float one = 1;
+    eigen_gemm(&transA, &transB, &m, &n, &k, &alpha, a, &lda, b, &ldb, &one, c, &ldc);
+}
+
 }
@@ -0,0 +1,152 @@
+#include "FFT.hpp"
+
+#include <cmath>
+
+namespace Blas {
+
+RealFFT2D::RealFFT2D( int n ) :
+    n_( n ), cos_( n / 2 ), sin_( n / 2 ), rev_( n ),
+    rowRe_( n * ( n / 2 + 1 ) ), rowIm_( n * ( n / 2 + 1 ) ),
+    re_( n ), im_( n )
+{
+    double const pi = 3.14159265358979323846;
+    for ( int j = 0; j < n / 2; j++ ) {
+        cos_[ j ] = (float)std::cos( 2.0 * pi * j / n );
+        sin_[ j ] = (float)std::sin( 2.0 * pi * j / n );
+    }
+    int bits = 0;
+    while ( ( 1 << bits ) < n ) bits++;
+    for ( int i = 0; i < n; i++ ) {
+        int r = 0;
+        for ( int b = 0; b < bits; b++ ) {
+            if ( i & ( 1 << b ) ) r |= 1 << ( bits - 1 - b );
+        }
+        rev_[ i ] = r;
+    }
+}
+
+void RealFFT2D::fft( float * re, float * im, bool inverse ) const {
+    int const n = n_;
+    for ( int i = 0; i < n; i++ ) {
+        int const r = rev_[ i ];
+        if ( r > i ) {
+            float t = re[ i ]; re[ i ] = re[ r ]; re[ r ] = t;
+            t = im[ i ]; im[ i ] = im[ r ]; im[ r ] = t;
+        }
+    }
+    float const sign = inverse ? 1.f : -1.f;
+    for ( int len = 2; len <= n; len <<= 1 ) {
+        int const half = len / 2;
+        int const step = n / len;
+        for ( int i = 0; i < n; i += len ) {
+            for ( int j = 0; j < half; j++ ) {
+                float const wr = cos_[ j * step ];
+                float const wi = sign * sin_[ j * step ];
+                int const a = i + j;
+                int const b = a + half;
+                float const vr = re[ b ] * wr - im[ b ] * wi;
+                float const vi = re[ b ] * wi + im[ b ] * wr;
+                re[ b ] = re[ a ] - vr;
+                im[ b ] = im[ a ] - vi;
+                re[ a ] += vr;
+                im[ a ] += vi;
+            }
+        }
+    }
+}
+
+void RealFFT2D::forward( float const * in, int rows, int cols, int inStride,
+                         float * re, float * im, int binStride ) {
+    int const n = n_;
+    int const h = n / 2 + 1;
+
+    // Rows, two at a time: z = x0 + i x1, X0 = ( Z + Z*(-k) ) / 2,
+    // X1 = ( Z - Z*(-k) ) / 2i.  Rows past the block are zero.
+    for ( int y = 0; y < n; y += 2 ) {
+        if ( y >= rows ) {
+            for ( int k = 0; k < 2 * h; k++ ) {
+                rowRe_[ y * h + k ] = 0.f;
+                rowIm_[ y * h + k ] = 0.f;
+            }
+            continue;
+        }
+        float const * r0 = in + y * inStride;
+        float const * r1 = r0 + inStride;
+        bool const second = y + 1 < rows;
+        for ( int x = 0; x < n; x++ ) {
+            re_[ x ] = x < cols ? r0[ x ] : 0.f;
+            im_[ x ] = ( second && x < cols ) ? r1[ x ] : 0.f;
+        }
+        fft( re_.data(), im_.data(), false );
+        for ( int k = 0; k < h; k++ ) {
+            int const m = ( n - k ) & ( n - 1 );
+            float const zr = re_[ k ], zi = im_[ k ];
+            float const cr = re_[ m ], ci = -im_[ m ];
+            rowRe_[ y * h + k ] = 0.5f * ( zr + cr );
+            rowIm_[ y * h + k ] = 0.5f * ( zi + ci );
+            rowRe_[ ( y + 1 ) * h + k ] = 0.5f * ( zi - ci );
+            rowIm_[ ( y + 1 ) * h + k ] = -0.5f * ( zr - cr );
+        }
+    }
+
+    // Columns
+    for ( int k = 0; k < h; k++ ) {
+        for ( int y = 0; y < n; y++ ) {
+            re_[ y ] = rowRe_[ y * h + k ];
+            im_[ y ] = rowIm_[ y * h + k ];
+        }
+        fft( re_.data(), im_.data(), false );
+        for ( int y = 0; y < n; y++ ) {
+            re[ ( y * h + k ) * binStride ] = re_[ y ];
+            im[ ( y * h + k ) * binStride ] = im_[ y ];
+        }
+    }
+}
+
+void RealFFT2D::inverse( float const * re, float const * im, int binStride,
+                         float * out ) {
+    int const n = n_;
+    int const h = n / 2 + 1;
+
+    // Columns
+    for ( int k = 0; k < h; k++ ) {
+        for ( int y = 0; y < n; y++ ) {
+            re_[ y ] = re[ ( y * h + k ) * binStride ];
+            im_[ y ] = im[ ( y * h + k ) * binStride ];
+        }
+        fft( re_.data(), im_.data(), true );
+        for ( int y = 0; y < n; y++ ) {
+            rowRe_[ y * h + k ] = re_[ y ];
+            rowIm_[ y * h + k ] = im_[ y ];
+        }
+    }
+
+    // Rows, two at a time: every row is Hermitian, so z = t0 + i t1
+    // transforms back to x0 + i x1.
+    float const scale = 1.f / ( (float)n * n );
+    for ( int y = 0; y < n; y += 2 ) {
+        float const * t0r = &rowRe_[ y * h ];
+        float const * t0i = &rowIm_[ y * h ];
+        float const * t1r = &rowRe_[ ( y + 1 ) * h ];
+        float const * t1i = &rowIm_[ ( y + 1 ) * h ];
+        for ( int x = 0; x < n; x++ ) {
+            float ar, ai, br, bi;
+            if ( x < h ) {
+                ar = t0r[ x ]; ai = t0i[ x ];
+                br = t1r[ x ]; bi = t1i[ x ];
+            } else {
+                ar = t0r[ n - x ]; ai = -t0i[ n - x ];
+                br = t1r[ n - x ]; bi = -t1i[ n - x ];
+            }
+            re_[ x ] = ar - bi;
+            im_[ x ] = ai + br;
+        }
+        fft( re_.data(), im_.data(), true );
+        for ( int x = 0; x < n; x++ ) {
+            out[ y * n + x ] = re_[ x ] * scale;
+            out[ ( y + 1 ) * n + x ] = im_[ x ] * scale;
+        }
+    }
+}
+
+}
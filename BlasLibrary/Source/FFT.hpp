@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+namespace Blas {
+
+// Real 2D FFT of an n x n tile, n a power of two.  Only the non-redundant
+// half of the spectrum is kept: n rows x (n / 2 + 1) columns, bin
+// ky * ( n / 2 + 1 ) + kx.  Real and imaginary parts are written to separate
+// arrays, bin i at [ i * binStride ], so callers can interleave many spectra
+// (e.g. one per channel) bin by bin.
+//
+// Radix-2, iterative; two real rows are transformed with one complex FFT.
+// An instance holds scratch buffers, use one per thread.
+class RealFFT2D {
+public:
+    explicit RealFFT2D( int n );
+
+    int size() const { return n_; }
+    int bins() const { return n_ * ( n_ / 2 + 1 ); }
+
+    // Transforms the rows x cols block at in (row stride inStride), zero
+    // padded to n x n.
+    void forward( float const * in, int rows, int cols, int inStride,
+                  float * re, float * im, int binStride );
+
+    // Inverse of forward, including the 1 / n^2 scaling; writes n x n reals.
+    void inverse( float const * re, float const * im, int binStride,
+                  float * out );
+
+private:
+    void fft( float * re, float * im, bool inverse ) const;
+
+    int n_;
+    std::vector< float > cos_;  // cos( 2 pi j / n ), j < n / 2
+    std::vector< float > sin_;
+    std::vector< int > rev_;    // bit reversal permutation
+
+    std::vector< float > rowRe_;  // n x ( n / 2 + 1 ) half spectra of the rows
+    std::vector< float > rowIm_;
+    std::vector< float > re_;     // one length n complex line
+    std::vector< float > im_;
+};
+
+}
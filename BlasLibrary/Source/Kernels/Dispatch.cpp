@@ -0,0 +1,59 @@
+#include "Kernels.hpp"
+#include "CpuFeatures.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+namespace Blas {
+
+// The copies of Kernels.cpp built into the library (BlasLibrary.cmake)
+namespace baseline { extern Kernels const table; }
+#ifdef BLAS_KERNELS_X86
+namespace avx2 { extern Kernels const table; }
+namespace avx512 { extern Kernels const table; }
+#endif
+
+namespace {
+
+// Widest first
+Kernels const * const sets[] = {
+#ifdef BLAS_KERNELS_X86
+    &avx512::table,
+    &avx2::table,
+#endif
+    &baseline::table,
+};
+
+Kernels const * select() {
+    unsigned const features = cpuFeatures();
+    char const * forced = std::getenv( "BLAS_ISA" );
+    // A set BLAS_ISA names but the CPU lacks (or an unknown name) falls back
+    // to the automatic choice
+    for ( int pass = forced != NULL ? 0 : 1; pass < 2; pass++ ) {
+        for ( size_t i = 0; i < sizeof( sets ) / sizeof( sets[ 0 ] ); i++ ) {
+            bool const supported = ( sets[ i ]->features & features ) == sets[ i ]->features;
+            if ( supported && ( pass == 1 || std::strcmp( forced, sets[ i ]->name ) == 0 ) ) {
+                return sets[ i ];
+            }
+        }
+    }
+    return &baseline::table;
+}
+
+// Constant-initialized, so no (non thread safe) static guard is involved
+std::atomic< Kernels const * > selected{ nullptr };
+
+}
+
+Kernels const & kernels() {
+    Kernels const * set = selected.load( std::memory_order_acquire );
+    if ( set == nullptr ) {
+        // Racing threads pick the same set, any of them may publish it
+        set = select();
+        selected.store( set, std::memory_order_release );
+    }
+    return *set;
+}
+
+}
@@ -0,0 +1,487 @@
+#include "Kernels.hpp"
+#include "BlockSparse.hpp"
+#include "CpuFeatures.hpp"
+#include "PackedMatrix.hpp"
+#include "Simd.hpp"
+
+#include <cstddef>
+#include <cstring>
+
+// Compiled once per instruction set level, BLAS_KERNELS_ISA naming the
+// namespace of the copy (BlasLibrary.cmake).  Nothing here may instantiate
+// an inline function or template with external linkage (std::min, ...): the
+// linker keeps one copy of those for the whole program, which could then be
+// one built for an instruction set the CPU does not have.
+#ifndef BLAS_KERNELS_ISA
+#define BLAS_KERNELS_ISA baseline
+#endif
+
+#define BLAS_STRINGIFY( x ) BLAS_STRINGIFY_( x )
+#define BLAS_STRINGIFY_( x ) #x
+
+#if defined( __AVX512F__ )
+#define BLAS_KERNELS_FEATURES ( CPU_AVX512F | CPU_AVX2 | CPU_FMA )
+#elif defined( __AVX2__ )
+#define BLAS_KERNELS_FEATURES ( CPU_AVX2 | CPU_FMA )
+#else
+#define BLAS_KERNELS_FEATURES 0
+#endif
+
+// Depth of the rank-k updates: a panel's PANEL x PACKED_K weights and the
+// PACKED_K rows of the columns of B they meet stay in L1
+#define PACKED_K 256
+// Columns of B every panel is run over in turn, PACKED_K x PACKED_N of B
+// stay in L2 (a multiple of the widest tile, 2 * 16)
+#define PACKED_N 128
+
+namespace Blas {
+namespace BLAS_KERNELS_ISA {
+
+namespace {
+
+using simd::float4;
+using simd::floatv;
+#if SIMD_LANES > 8
+// Half of an AVX-512 vector, for column tails
+typedef float float8 __attribute__(( vector_size( 32 ) ));
+#endif
+
+int const P = PackedMatrix::PANEL;
+int const B = BlockSparseMatrix::BLOCK;
+int const L = SIMD_LANES;
+
+inline int minInt( int a, int b ) { return a < b ? a : b; }
+inline int maxInt( int a, int b ) { return a > b ? a : b; }
+
+// C += A * B over kc for a panel and V vectors of columns (C is first set to
+// the bias if first): w is the panel at the first row of the block, b the
+// first row of B for the columns.  Rows [ rlo, rhi ) of the panel are
+// stored, row rlo at c.
+template< typename Vec, int V >
+void panel( float const * w, int kc, float const * b, int ldb, float const * bias, bool first,
+            int rlo, int rhi, float * c, int ldc ) {
+    int const W = sizeof( Vec ) / sizeof( float );
+    Vec acc[ P ][ V ];
+    for ( int r = 0; r < P; r++ ) {
+        for ( int v = 0; v < V; v++ ) {
+            if ( r < rlo || r >= rhi ) {
+                acc[ r ][ v ] = simd::broadcast< Vec >( 0 );
+            } else if ( first ) {
+                acc[ r ][ v ] = simd::broadcast< Vec >( bias != NULL ? bias[ r ] : 0 );
+            } else {
+                acc[ r ][ v ] = simd::load< Vec >( c + (size_t)( r - rlo ) * ldc + W * v );
+            }
+        }
+    }
+    for ( int kk = 0; kk < kc; kk++, w += P, b += ldb ) {
+        Vec x[ V ];
+        for ( int v = 0; v < V; v++ ) {
+            x[ v ] = simd::load< Vec >( b + W * v );
+        }
+        for ( int r = 0; r < P; r++ ) {
+            Vec const wr = simd::broadcast< Vec >( w[ r ] );
+            for ( int v = 0; v < V; v++ ) {
+                acc[ r ][ v ] += wr * x[ v ];
+            }
+        }
+    }
+    for ( int r = rlo; r < rhi; r++ ) {
+        for ( int v = 0; v < V; v++ ) {
+            simd::store< Vec >( c + (size_t)( r - rlo ) * ldc + W * v, acc[ r ][ v ] );
+        }
+    }
+}
+
+// The same for a single column
+void panelColumn( float const * w, int kc, float const * b, int ldb, float const * bias,
+                  bool first, int rlo, int rhi, float * c, int ldc ) {
+    float acc[ P ];
+    for ( int r = 0; r < P; r++ ) {
+        if ( r < rlo || r >= rhi ) {
+            acc[ r ] = 0;
+        } else {
+            acc[ r ] = !first ? c[ (size_t)( r - rlo ) * ldc ] : ( bias != NULL ? bias[ r ] : 0 );
+        }
+    }
+    for ( int kk = 0; kk < kc; kk++, w += P, b += ldb ) {
+        float const x = *b;
+        for ( int r = 0; r < P; r++ ) {
+            acc[ r ] += w[ r ] * x;
+        }
+    }
+    for ( int r = rlo; r < rhi; r++ ) {
+        c[ (size_t)( r - rlo ) * ldc ] = acc[ r ];
+    }
+}
+
+void packedMultiply( float const * values, int m, int k, float const * b, int ldb, int n,
+                     float const * bias, int i0, int in, float * c, int ldc ) {
+    int const i1 = minInt( i0 + in, m );
+    for ( int k0 = 0; k0 < k; k0 += PACKED_K ) {
+        int const kc = minInt( PACKED_K, k - k0 );
+        bool const first = k0 == 0;
+        float const * bk = b + (size_t)k0 * ldb;
+        for ( int n0 = 0; n0 < n; n0 += PACKED_N ) {
+            int const n1 = minInt( n0 + PACKED_N, n );
+            for ( int p = i0 / P; p * P < i1; p++ ) {
+                int const row = p * P;
+                int const rlo = maxInt( i0, row ) - row;
+                int const rhi = minInt( i1, row + P ) - row;
+                float const * w = values + ( (size_t)p * k + k0 ) * P;
+                float * cr = c + (size_t)( row + rlo - i0 ) * ldc;
+                float const * pb = bias != NULL ? bias + row : NULL;
+                int j = n0;
+                for ( ; j + 2 * L <= n1; j += 2 * L ) {
+                    panel< floatv, 2 >( w, kc, bk + j, ldb, pb, first, rlo, rhi, cr + j, ldc );
+                }
+                for ( ; j + L <= n1; j += L ) {
+                    panel< floatv, 1 >( w, kc, bk + j, ldb, pb, first, rlo, rhi, cr + j, ldc );
+                }
+                for ( ; L > 4 && j + 4 <= n1; j += 4 ) {
+                    panel< float4, 1 >( w, kc, bk + j, ldb, pb, first, rlo, rhi, cr + j, ldc );
+                }
+                for ( ; j < n1; j++ ) {
+                    panelColumn( w, kc, bk + j, ldb, pb, first, rlo, rhi, cr + j, ldc );
+                }
+            }
+        }
+    }
+}
+
+// One block row of C for V vectors of columns: rows [ rlo, rhi ) of the
+// block are stored, row rlo at c.  x is the first row of B for the columns.
+template< typename Vec, int V >
+void blockRow( float const * values, int const * cols, int blocks, int k, float const * x,
+               int ldb, float const * bias, int rlo, int rhi, float * c, int ldc ) {
+    int const W = sizeof( Vec ) / sizeof( float );
+    Vec acc[ B ][ V ];
+    for ( int r = 0; r < B; r++ ) {
+        Vec const init = simd::broadcast< Vec >( r >= rlo && r < rhi ? bias[ r ] : 0 );
+        for ( int v = 0; v < V; v++ ) {
+            acc[ r ][ v ] = init;
+        }
+    }
+    for ( int q = 0; q < blocks; q++ ) {
+        float const * w = values + q * B * B;
+        int const j = cols[ q ] * B;
+        int const kn = minInt( B, k - j );
+        float const * xr = x + (size_t)j * ldb;
+        for ( int kk = 0; kk < kn; kk++, w += B, xr += ldb ) {
+            Vec xv[ V ];
+            for ( int v = 0; v < V; v++ ) {
+                xv[ v ] = simd::load< Vec >( xr + W * v );
+            }
+            for ( int r = 0; r < B; r++ ) {
+                Vec const wr = simd::broadcast< Vec >( w[ r ] );
+                for ( int v = 0; v < V; v++ ) {
+                    acc[ r ][ v ] += wr * xv[ v ];
+                }
+            }
+        }
+    }
+    for ( int r = rlo; r < rhi; r++ ) {
+        for ( int v = 0; v < V; v++ ) {
+            simd::store< Vec >( c + (size_t)( r - rlo ) * ldc + W * v, acc[ r ][ v ] );
+        }
+    }
+}
+
+// The same for a single column
+void blockRowColumn( float const * values, int const * cols, int blocks, int k,
+                     float const * x, int ldb, float const * bias, int rlo, int rhi,
+                     float * c, int ldc ) {
+    float acc[ B ];
+    for ( int r = 0; r < B; r++ ) {
+        acc[ r ] = r >= rlo && r < rhi ? bias[ r ] : 0;
+    }
+    for ( int q = 0; q < blocks; q++ ) {
+        float const * w = values + q * B * B;
+        int const j = cols[ q ] * B;
+        int const kn = minInt( B, k - j );
+        for ( int kk = 0; kk < kn; kk++, w += B ) {
+            float const xv = x[ (size_t)( j + kk ) * ldb ];
+            for ( int r = 0; r < B; r++ ) {
+                acc[ r ] += w[ r ] * xv;
+            }
+        }
+    }
+    for ( int r = rlo; r < rhi; r++ ) {
+        c[ (size_t)( r - rlo ) * ldc ] = acc[ r ];
+    }
+}
+
+void sparseMultiply( float const * values, int const * rowStart, int const * cols, int m, int k,
+                     float const * b, int ldb, int n, float const * bias, int i0, int in,
+                     float * c, int ldc ) {
+    int const i1 = minInt( i0 + in, m );
+    // Column strips outside, so the strip of B stays in L1 while every block
+    // row is run over it
+    for ( int j = 0; j < n; ) {
+        int const width = n - j >= 2 * L ? 2 * L : ( n - j >= L ? L : ( n - j >= 4 ? 4 : 1 ) );
+        for ( int br = i0 / B; br * B < i1; br++ ) {
+            int const row = br * B;
+            int const rlo = maxInt( i0, row ) - row;
+            int const rhi = minInt( i1, row + B ) - row;
+            int const first = rowStart[ br ];
+            int const blocks = rowStart[ br + 1 ] - first;
+            float const * v = values + (size_t)first * B * B;
+            int const * bc = cols + first;
+            float * cr = c + (size_t)( row + rlo - i0 ) * ldc + j;
+            if ( width == 2 * L ) {
+                blockRow< floatv, 2 >( v, bc, blocks, k, b + j, ldb, bias + row, rlo, rhi, cr, ldc );
+            } else if ( width == L ) {
+                blockRow< floatv, 1 >( v, bc, blocks, k, b + j, ldb, bias + row, rlo, rhi, cr, ldc );
+            } else if ( width == 4 ) {
+                blockRow< float4, 1 >( v, bc, blocks, k, b + j, ldb, bias + row, rlo, rhi, cr, ldc );
+            } else {
+                blockRowColumn( v, bc, blocks, k, b + j, ldb, bias + row, rlo, rhi, cr, ldc );
+            }
+        }
+        j += width;
+    }
+}
+
+void sparseMultiplyVector( float const * values, int const * rowStart, int const * cols, int m,
+                           int k, float const * x, float const * bias, float * y ) {
+    int const mb = ( m + B - 1 ) / B;
+    for ( int br = 0; br < mb; br++ ) {
+        int const row = br * B;
+        int const rn = minInt( B, m - row );
+        // One accumulator per column of the block, so consecutive blocks do
+        // not wait on each other's additions
+        float4 acc0 = simd::broadcast4( 0 );
+        float4 acc1 = simd::broadcast4( 0 );
+        float4 acc2 = simd::broadcast4( 0 );
+        float4 acc3 = simd::broadcast4( 0 );
+        for ( int r = 0; r < rn; r++ ) {
+            acc0[ r ] = bias[ row + r ];
+        }
+        for ( int q = rowStart[ br ]; q < rowStart[ br + 1 ]; q++ ) {
+            float const * w = values + (size_t)q * B * B;
+            int const j = cols[ q ] * B;
+            float xv[ B ] = { 0 };
+            if ( j + B <= k ) {
+                std::memcpy( xv, x + j, sizeof( xv ) );
+            } else {
+                std::memcpy( xv, x + j, sizeof( float ) * ( k - j ) );
+            }
+            if ( xv[ 0 ] == 0 && xv[ 1 ] == 0 && xv[ 2 ] == 0 && xv[ 3 ] == 0 ) {
+                continue;
+            }
+            acc0 += simd::broadcast4( xv[ 0 ] ) * simd::load4( w );
+            acc1 += simd::broadcast4( xv[ 1 ] ) * simd::load4( w + B );
+            acc2 += simd::broadcast4( xv[ 2 ] ) * simd::load4( w + 2 * B );
+            acc3 += simd::broadcast4( xv[ 3 ] ) * simd::load4( w + 3 * B );
+        }
+        float4 const acc = ( acc0 + acc1 ) + ( acc2 + acc3 );
+        for ( int r = 0; r < rn; r++ ) {
+            y[ row + r ] = acc[ r ];
+        }
+    }
+}
+
+// Independent accumulators along k for a tile of rows * vectors: the
+// additions into one accumulator wait on each other, so small tiles (down
+// to the single row of a matrix-vector product) spread k over several
+constexpr int chains( int rv ) { return rv >= 8 ? 1 : ( rv >= 4 ? 2 : 4 ); }
+
+// gemmTile for R rows and V vectors of columns
+template< typename Vec, int V, int R >
+void tile( int kc, float const * a, float const * b, int ldb, float * c, int ldc, float beta,
+           float const * rowBias, float const * colBias ) {
+    int const W = sizeof( Vec ) / sizeof( float );
+    int const U = chains( R * V );
+    Vec acc[ U ][ R ][ V ];
+    for ( int u = 0; u < U; u++ ) {
+        for ( int r = 0; r < R; r++ ) {
+            for ( int v = 0; v < V; v++ ) {
+                acc[ u ][ r ][ v ] = simd::broadcast< Vec >( 0 );
+            }
+        }
+    }
+    int kk = 0;
+    for ( ; kk + U <= kc; kk += U ) {
+        for ( int u = 0; u < U; u++ ) {
+            float const * bk = b + (size_t)( kk + u ) * ldb;
+            float const * ak = a + ( kk + u ) * P;
+            Vec x[ V ];
+            for ( int v = 0; v < V; v++ ) {
+                x[ v ] = simd::load< Vec >( bk + W * v );
+            }
+            for ( int r = 0; r < R; r++ ) {
+                Vec const wr = simd::broadcast< Vec >( ak[ r ] );
+                for ( int v = 0; v < V; v++ ) {
+                    acc[ u ][ r ][ v ] += wr * x[ v ];
+                }
+            }
+        }
+    }
+    for ( ; kk < kc; kk++ ) {
+        float const * bk = b + (size_t)kk * ldb;
+        for ( int r = 0; r < R; r++ ) {
+            Vec const wr = simd::broadcast< Vec >( a[ kk * P + r ] );
+            for ( int v = 0; v < V; v++ ) {
+                acc[ 0 ][ r ][ v ] += wr * simd::load< Vec >( bk + W * v );
+            }
+        }
+    }
+    for ( int r = 0; r < R; r++ ) {
+        float * cr = c + (size_t)r * ldc;
+        for ( int v = 0; v < V; v++ ) {
+            Vec out = acc[ 0 ][ r ][ v ];
+            for ( int u = 1; u < U; u++ ) {
+                out += acc[ u ][ r ][ v ];
+            }
+            if ( rowBias != NULL ) {
+                out += simd::broadcast< Vec >( rowBias[ r ] );
+            }
+            if ( colBias != NULL ) {
+                out += simd::load< Vec >( colBias + W * v );
+            }
+            if ( beta == 1 ) {
+                out += simd::load< Vec >( cr + W * v );
+            } else if ( beta != 0 ) {
+                out += simd::broadcast< Vec >( beta ) * simd::load< Vec >( cr + W * v );
+            }
+            simd::store< Vec >( cr + W * v, out );
+        }
+    }
+}
+
+// The same for a single column
+template< int R >
+void tileColumn( int kc, float const * a, float const * b, int ldb, float * c, int ldc,
+                 float beta, float const * rowBias, float const * colBias ) {
+    int const U = chains( R );
+    float acc[ U ][ R ] = {};
+    int kk = 0;
+    for ( ; kk + U <= kc; kk += U ) {
+        for ( int u = 0; u < U; u++ ) {
+            float const x = b[ (size_t)( kk + u ) * ldb ];
+            for ( int r = 0; r < R; r++ ) {
+                acc[ u ][ r ] += a[ ( kk + u ) * P + r ] * x;
+            }
+        }
+    }
+    for ( ; kk < kc; kk++ ) {
+        float const x = b[ (size_t)kk * ldb ];
+        for ( int r = 0; r < R; r++ ) {
+            acc[ 0 ][ r ] += a[ kk * P + r ] * x;
+        }
+    }
+    for ( int r = 0; r < R; r++ ) {
+        float out = acc[ 0 ][ r ];
+        for ( int u = 1; u < U; u++ ) {
+            out += acc[ u ][ r ];
+        }
+        if ( rowBias != NULL ) {
+            out += rowBias[ r ];
+        }
+        if ( colBias != NULL ) {
+            out += colBias[ 0 ];
+        }
+        float & cr = c[ (size_t)r * ldc ];
+        cr = beta == 0 ? out : ( beta == 1 ? cr + out : beta * cr + out );
+    }
+}
+
+inline float const * offset( float const * bias, int j ) {
+    return bias != NULL ? bias + j : NULL;
+}
+
+// Columns in tiles as wide as fit, so no value of B past cols is read
+template< int R >
+void tileRows( int kc, float const * a, float const * b, int ldb, int cols, float * c, int ldc,
+               float beta, float const * rowBias, float const * colBias ) {
+    int j = 0;
+    for ( ; j + 2 * L <= cols; j += 2 * L ) {
+        tile< floatv, 2, R >( kc, a, b + j, ldb, c + j, ldc, beta, rowBias, offset( colBias, j ) );
+    }
+    for ( ; j + L <= cols; j += L ) {
+        tile< floatv, 1, R >( kc, a, b + j, ldb, c + j, ldc, beta, rowBias, offset( colBias, j ) );
+    }
+#if SIMD_LANES > 8
+    for ( ; j + 8 <= cols; j += 8 ) {
+        tile< float8, 1, R >( kc, a, b + j, ldb, c + j, ldc, beta, rowBias, offset( colBias, j ) );
+    }
+#endif
+    for ( ; L > 4 && j + 4 <= cols; j += 4 ) {
+        tile< float4, 1, R >( kc, a, b + j, ldb, c + j, ldc, beta, rowBias, offset( colBias, j ) );
+    }
+    for ( ; j < cols; j++ ) {
+        tileColumn< R >( kc, a, b + j, ldb, c + j, ldc, beta, rowBias, offset( colBias, j ) );
+    }
+}
+
+void gemmTile( int kc, float const * a, float const * b, int ldb, int rows, int cols, float * c,
+               int ldc, float beta, float const * rowBias, float const * colBias ) {
+    switch ( rows ) {
+    case 1: tileRows< 1 >( kc, a, b, ldb, cols, c, ldc, beta, rowBias, colBias ); break;
+    case 2: tileRows< 2 >( kc, a, b, ldb, cols, c, ldc, beta, rowBias, colBias ); break;
+    case 3: tileRows< 3 >( kc, a, b, ldb, cols, c, ldc, beta, rowBias, colBias ); break;
+    case 4: tileRows< 4 >( kc, a, b, ldb, cols, c, ldc, beta, rowBias, colBias ); break;
+    case 5: tileRows< 5 >( kc, a, b, ldb, cols, c, ldc, beta, rowBias, colBias ); break;
+    default: tileRows< 6 >( kc, a, b, ldb, cols, c, ldc, beta, rowBias, colBias ); break;
+    }
+}
+
+void im2colRows( float const * img, int channels, int height, int width, int kernelH,
+                 int kernelW, int padH, int padW, int strideH, int strideW, int firstRow,
+                 int numRows, float * col ) {
+    int const colWidth = ( width + 2 * padW - kernelW ) / strideW + 1;
+    int const rowSize = numRows * colWidth;
+
+    // Column channel ( c, kh, kw ) reads input channel c shifted by ( kh, kw ).
+    // Every output row splits into a left padding run, an interior run read
+    // from one input row and a right padding run, so the bounds are worked
+    // out once per row instead of once per element.  Channels write disjoint
+    // parts of col.
+    for ( int c = 0; c < channels; ++c ) {
+        float const * plane = img + (size_t)c * height * width;
+        for ( int kh = 0; kh < kernelH; ++kh ) {
+            for ( int kw = 0; kw < kernelW; ++kw ) {
+                float * dst = col + (size_t)( ( c * kernelH + kh ) * kernelW + kw ) * rowSize;
+
+                // Output columns [ wLo, wHi ) read inside the input row
+                int const shift = kw - padW;
+                int const wLo = shift >= 0 ? 0 : minInt( colWidth, ( -shift + strideW - 1 ) / strideW );
+                int const last = width - 1 - shift;
+                int const wHi = maxInt( last < 0 ? 0 : minInt( colWidth, last / strideW + 1 ), wLo );
+
+                for ( int r = 0; r < numRows; ++r, dst += colWidth ) {
+                    int const hPad = ( firstRow + r ) * strideH - padH + kh;
+                    if ( hPad < 0 || hPad >= height ) {
+                        std::memset( dst, 0, sizeof( float ) * colWidth );
+                        continue;
+                    }
+                    float const * src = plane + hPad * width + wLo * strideW + shift;
+                    std::memset( dst, 0, sizeof( float ) * wLo );
+                    if ( strideW == 1 ) {
+                        std::memcpy( dst + wLo, src, sizeof( float ) * ( wHi - wLo ) );
+                    } else {
+                        for ( int w = 0; w < wHi - wLo; ++w ) {
+                            dst[ wLo + w ] = src[ w * strideW ];
+                        }
+                    }
+                    std::memset( dst + wHi, 0, sizeof( float ) * ( colWidth - wHi ) );
+                }
+            }
+        }
+    }
+}
+
+}
+
+extern Kernels const table = {
+    BLAS_STRINGIFY( BLAS_KERNELS_ISA ),
+    BLAS_KERNELS_FEATURES,
+    packedMultiply,
+    sparseMultiply,
+    sparseMultiplyVector,
+    2 * SIMD_LANES,
+    gemmTile,
+    im2colRows,
+};
+
+}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+namespace Blas {
+
+// The inner loops of the library, built once per instruction set level
+// (Kernels.cpp, see BlasLibrary.cmake) so one binary runs the widest vectors
+// the CPU has.  The callers own the data layouts and go through kernels().
+struct Kernels {
+    char const * name;
+    unsigned features;  // CpuFeature bits the set needs
+
+    // PackedMatrix::multiply on its panels
+    void ( *packedMultiply )( float const * values, int m, int k, float const * b, int ldb, int n,
+                              float const * bias, int i0, int in, float * c, int ldc );
+
+    // BlockSparseMatrix::multiply and multiplyVector on its blocks
+    void ( *sparseMultiply )( float const * values, int const * rowStart, int const * cols, int m,
+                              int k, float const * b, int ldb, int n, float const * bias, int i0,
+                              int in, float * c, int ldc );
+    void ( *sparseMultiplyVector )( float const * values, int const * rowStart, int const * cols,
+                                    int m, int k, float const * x, float const * bias, float * y );
+
+    // BlasNaive::gemm's microkernel: C = beta * C + A * B + bias for a tile
+    // of rows <= PANEL rows and cols columns (gemmColumns at most run in
+    // registers at once).  a is a panel packed as PackedMatrix does (PANEL
+    // values per k), b has kc rows ldb apart and C is row major with rows ldc
+    // apart.  The bias, rowBias[ r ] and / or colBias[ j ] (either may be
+    // NULL), is added while the tile is stored; C is not read if beta is 0.
+    int gemmColumns;
+    void ( *gemmTile )( int kc, float const * a, float const * b, int ldb, int rows, int cols,
+                        float * c, int ldc, float beta, float const * rowBias,
+                        float const * colBias );
+
+    // Blas::im2colRows
+    void ( *im2colRows )( float const * img, int channels, int height, int width, int kernelH,
+                          int kernelW, int padH, int padW, int strideH, int strideW, int firstRow,
+                          int numRows, float * col );
+};
+
+// The set for the running CPU: the widest one it supports, unless the
+// BLAS_ISA environment variable names another supported one ("avx512",
+// "avx2" or "baseline").  Chosen on first use, safe to call from any thread.
+Kernels const & kernels();
+
+}
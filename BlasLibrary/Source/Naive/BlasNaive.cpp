@@ -1,31 +1,153 @@
 #include "BlasNaive.hpp"
+#include "Kernels/Kernels.hpp"
+#include "PackedMatrix.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// Blocking of the GEMM, in the transposed (row major) view the kernels use:
+// GEMM_MC rows of packed op(B)^T (x GEMM_KC) stay in L2 while every strip
+// of a GEMM_KC x GEMM_NC block of packed op(A)^T passes through L1
+#define GEMM_KC 256
+#define GEMM_MC 72  // A multiple of the panel height
+#define GEMM_NC 1024  // A multiple of every kernel set's gemmColumns
 
 namespace BlasNaive {
 
+namespace {
+
+const int P = Blas::PackedMatrix::PANEL;
+
+inline bool transposed(char trans) {
+    return trans != 'n' && trans != 'N';
+}
+
+// Packing buffers, kept per thread so calls neither allocate nor share them
+thread_local std::vector<float> packedA;
+thread_local std::vector<float> packedB;
+
+// Rows [j0, j0 + mc) and k range [k0, k0 + kc) of op(B)^T, scaled by alpha,
+// into panels of P rows ([panel][kc][P]; the kernel reads only the rows a
+// short last panel has)
+void packRows(char transB, const float* b, int ldb, int j0, int mc, int k0, int kc, float alpha,
+              float* dst) {
+    const bool t = transposed(transB);
+    for (int p = 0; p * P < mc; p++, dst += kc * P) {
+        for (int r = 0; r < P && p * P + r < mc; r++) {
+            const int j = j0 + p * P + r;
+            for (int kk = 0; kk < kc; kk++) {
+                const float v = t ? b[j + (long)(k0 + kk) * ldb] : b[(k0 + kk) + (long)j * ldb];
+                dst[kk * P + r] = alpha * v;
+            }
+        }
+    }
+}
+
+// Columns [i0, i0 + cols) and k range [k0, k0 + kc) of op(A)^T into a strip
+// nr wide ([kc][nr])
+void packStrip(char transA, const float* a, int lda, int i0, int cols, int k0, int kc, int nr,
+               float* dst) {
+    if (!transposed(transA)) {
+        for (int kk = 0; kk < kc; kk++) {
+            std::memcpy(dst + kk * nr, a + i0 + (long)(k0 + kk) * lda, sizeof(float) * cols);
+        }
+    } else {
+        for (int ii = 0; ii < cols; ii++) {
+            const float* src = a + (long)(i0 + ii) * lda + k0;
+            for (int kk = 0; kk < kc; kk++) {
+                dst[kk * nr + ii] = src[kk];
+            }
+        }
+    }
+}
+
+// C = alpha * op(A) * op(B) + beta * C + bias, computed as C^T = op(B)^T *
+// op(A)^T + ...: C^T is row major with rows ldc apart, so rows of op(B)^T are
+// the panels and the microkernel's vectors run along the columns of C.  beta
+// and the bias (bias[j] per column if perColumn, else bias[i] per row, or
+// NULL) are applied by the microkernel as it stores the first rank-k update
+// of every tile.
+void multiply(char transA, char transB, int m, int n, int k, float alpha, const float* a,
+              int lda, const float* b, int ldb, float beta, float* c, int ldc,
+              const float* bias, bool perColumn) {
+    const Blas::Kernels& kernels = Blas::kernels();
+    const int nr = kernels.gemmColumns;
+    // With a single panel every strip of op(A)^T is read once; when it is
+    // contiguous it is then read in place (a matrix-vector product streams
+    // A once instead of copying it first, the kernel reads no further than
+    // the last column)
+    const bool inPlace = !transposed(transA) && n <= P;
+    packedA.resize((size_t)GEMM_MC * GEMM_KC);
+    packedB.resize((size_t)GEMM_NC * GEMM_KC);
+
+    for (int i0 = 0; i0 < m; i0 += GEMM_NC) {
+        const int nc = std::min(GEMM_NC, m - i0);
+        // k == 0 still makes one (empty) update, which applies beta and the bias
+        for (int k0 = 0; k0 == 0 || k0 < k; k0 += GEMM_KC) {
+            const int kc = std::min(GEMM_KC, k - k0);
+            const bool first = k0 == 0;
+            if (!inPlace) {
+                for (int s = 0; s < nc; s += nr) {
+                    packStrip(transA, a, lda, i0 + s, std::min(nr, nc - s), k0, kc, nr,
+                              packedB.data() + (size_t)s * kc);
+                }
+            }
+            for (int j0 = 0; j0 < n; j0 += GEMM_MC) {
+                const int mc = std::min(GEMM_MC, n - j0);
+                packRows(transB, b, ldb, j0, mc, k0, kc, alpha, packedA.data());
+                for (int s = 0; s < nc; s += nr) {
+                    const int cols = std::min(nr, nc - s);
+                    const float* strip = inPlace ? a + i0 + s + (long)k0 * lda
+                                                 : packedB.data() + (size_t)s * kc;
+                    const int ldstrip = inPlace ? lda : nr;
+                    // The tile's rows are columns of C, its columns rows of C
+                    const float* tileColBias = first && bias != NULL && !perColumn ?
+                        bias + i0 + s : NULL;
+                    for (int p = 0; p * P < mc; p++) {
+                        const float* tileRowBias = first && bias != NULL && perColumn ?
+                            bias + j0 + p * P : NULL;
+                        kernels.gemmTile(kc, packedA.data() + (size_t)p * kc * P, strip, ldstrip,
+                            std::min(P, mc - p * P), cols,
+                            c + i0 + s + (long)(j0 + p * P) * ldc, ldc, first ? beta : 1,
+                            tileRowBias, tileColBias);
+                    }
+                }
+            }
+        }
+    }
+}
+
+}
+
+void gemm(char transA, char transB, int m, int n, int k, float alpha, float* a, int lda,
+            float* b, int ldb, float beta, float* c, int ldc) {
+
+    multiply(transA, transB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, NULL, false);
+}
+
+void gemmBias(char transA, char transB, int m, int n, int k, float alpha, float* a, int lda,
+            float* b, int ldb, float beta, float* c, int ldc, const float* bias,
+            bool perColumn) {
+
+    multiply(transA, transB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, bias, perColumn);
+}
+
 void im2col(float* imgData, int channels, int height, int width, int kernelH, int kernelW,
             int padH, int padW, int strideH, int strideW, float* colData) {
 
     int colHeight = (height + 2 * padH - kernelH) / strideH + 1;
-    int colWidth = (width + 2 * padW - kernelW) / strideW + 1;
-    int colChannels = channels * kernelH * kernelW;
-    for (int c = 0; c < colChannels; ++c) {
-
-        int offsetW = c % kernelW;
-        int offsetH = (c / kernelW) % kernelH;
-        int imChannel = c / kernelH / kernelW;
-        for (int h = 0; h < colHeight; ++h) {
-          for (int w = 0; w < colWidth; ++w) {
-
-            int hPad = h * strideH - padH + offsetH;
-            int wPad = w * strideW - padW + offsetW;
-            if (hPad >= 0 && hPad < height && wPad >= 0 && wPad < width)
-              colData[(c * colHeight + h) * colWidth + w] =
-                imgData[(imChannel * height + hPad) * width + wPad];
-            else
-              colData[(c * colHeight + h) * colWidth + w] = 0;
-          }
-        }
-      }
+    im2colRows(imgData, channels, height, width, kernelH, kernelW, padH, padW, strideH, strideW,
+               0, colHeight, colData);
+}
+
+void im2colRows(float* imgData, int channels, int height, int width, int kernelH, int kernelW,
+            int padH, int padW, int strideH, int strideW, int firstRow, int numRows,
+            float* colData) {
+
+    // Built per instruction set level, see Kernels/Kernels.hpp
+    Blas::kernels().im2colRows(imgData, channels, height, width, kernelH, kernelW, padH, padW,
+        strideH, strideW, firstRow, numRows, colData);
 }
 
 }
@@ -2,7 +2,22 @@
 
 namespace BlasNaive {
 
+// Register-blocked SGEMM (column major, as the BLAS): op(B)^T and op(A)^T
+// are packed into PANEL row panels and gemmColumns wide strips, per
+// GEMM_KC x GEMM_MC and GEMM_KC x GEMM_NC block, and multiplied by the
+// microkernel of the running CPU's kernel set (Kernels/Kernels.hpp).
+void gemm(char transA, char transB, int m, int n, int k, float alpha, float* a, int lda,
+            float* b, int ldb, float beta, float* c, int ldc);
+
+void gemmBias(char transA, char transB, int m, int n, int k, float alpha, float* a, int lda,
+            float* b, int ldb, float beta, float* c, int ldc, const float* bias,
+            bool perColumn);
+
 void im2col(float* imgData, int channels, int height, int width, int kernelH, int kernelW,
               int padH, int padW, int strideH, int strideW, float* colData);
 
+void im2colRows(float* imgData, int channels, int height, int width, int kernelH, int kernelW,
+              int padH, int padW, int strideH, int strideW, int firstRow, int numRows,
+              float* colData);
+
 }
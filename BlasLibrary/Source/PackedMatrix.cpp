@@ -0,0 +1,44 @@
+#include "PackedMatrix.hpp"
+#include "Kernels/Kernels.hpp"
+
+#include <cstddef>
+
+namespace Blas {
+
+namespace {
+
+int const P = PackedMatrix::PANEL;
+
+}
+
+PackedMatrix::PackedMatrix() : m_( 0 ), k_( 0 ) {
+}
+
+void PackedMatrix::pack( float const * a, int m, int k, int rowStride, int colStride ) {
+    int const panels = ( m + P - 1 ) / P;
+    m_ = m;
+    k_ = k;
+    values_.assign( (size_t)panels * k * P, 0 );
+    for ( int p = 0; p < panels; p++ ) {
+        float * dst = values_.data() + (size_t)p * k * P;
+        for ( int r = 0; r < P && p * P + r < m; r++ ) {
+            float const * row = a + (size_t)( p * P + r ) * rowStride;
+            for ( int kk = 0; kk < k; kk++ ) {
+                dst[ (size_t)kk * P + r ] = row[ (size_t)kk * colStride ];
+            }
+        }
+    }
+}
+
+void PackedMatrix::clear() {
+    m_ = 0;
+    k_ = 0;
+    std::vector< float >().swap( values_ );
+}
+
+void PackedMatrix::multiply( float const * b, int ldb, int n, float const * bias, int i0, int in,
+                             float * c, int ldc ) const {
+    kernels().packedMultiply( values_.data(), m_, k_, b, ldb, n, bias, i0, in, c, ldc );
+}
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+namespace Blas {
+
+// An m x k matrix (the weights of a layer) packed once into the layout the
+// product kernel reads: panels of PANEL rows, each stored column by column
+// ([ m / PANEL ][ k ][ PANEL ], zero filled past the last row).  A GEMM
+// re-packs its operands on every call; with the weights packed up front only
+// the other operand is read per call, in place.
+class PackedMatrix {
+public:
+    enum { PANEL = 6 };
+
+    PackedMatrix();
+
+    // Packs the m x k matrix with element ( i, j ) at a[ i * rowStride +
+    // j * colStride ].
+    void pack( float const * a, int m, int k, int rowStride, int colStride );
+    void clear();
+
+    bool empty() const { return values_.empty(); }
+    int rows() const { return m_; }
+    int cols() const { return k_; }
+
+    // C = A * B + bias for rows [ i0, i0 + in ) of A: B is k x n with rows
+    // ldb apart, row i of C is at c + ( i - i0 ) * ldc and bias is indexed
+    // by the row of A (NULL for none).
+    void multiply( float const * b, int ldb, int n, float const * bias, int i0, int in,
+                   float * c, int ldc ) const;
+
+private:
+    int m_;
+    int k_;
+    std::vector< float > values_;
+};
+
+}
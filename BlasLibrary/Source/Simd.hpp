@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstring>
+
+// Minimal portable SIMD helpers built on the GCC / Clang vector extensions.
+// The compiler lowers them to whatever the target offers (SSE, AVX, NEON,
+// WASM SIMD) or to scalar code, so kernels written with them need no
+// per-ISA intrinsics.
+
+namespace Blas {
+namespace simd {
+
+typedef float float4 __attribute__(( vector_size( 16 ) ));
+
+static inline float4 load4( float const * p ) noexcept
+{
+    float4 v;
+    std::memcpy( &v, p, sizeof( v ) );  // Unaligned load
+    return v;
+}
+
+static inline void store4( float * p, float4 v ) noexcept
+{
+    std::memcpy( p, &v, sizeof( v ) );  // Unaligned store
+}
+
+static inline float4 broadcast4( float x ) noexcept
+{
+    return float4{ x, x, x, x };
+}
+
+// The widest vector the target has (the kernels built per instruction set
+// level get 8 lanes with AVX, 16 with AVX-512)
+#if defined( __AVX512F__ )
+#define SIMD_LANES 16
+#elif defined( __AVX__ )
+#define SIMD_LANES 8
+#else
+#define SIMD_LANES 4
+#endif
+
+typedef float floatv __attribute__(( vector_size( 4 * SIMD_LANES ) ));
+
+// load4 / store4 / broadcast4 for any of the vector types
+template< typename V >
+static inline V load( float const * p ) noexcept
+{
+    V v;
+    std::memcpy( &v, p, sizeof( v ) );
+    return v;
+}
+
+template< typename V >
+static inline void store( float * p, V v ) noexcept
+{
+    std::memcpy( p, &v, sizeof( v ) );
+}
+
+template< typename V >
+static inline V broadcast( float x ) noexcept
+{
+    return V{} + x;
+}
+
+}
+}
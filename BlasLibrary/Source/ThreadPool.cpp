@@ -0,0 +1,121 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace Blas {
+
+struct ThreadPool::Job {
+    Body const * body;
+    int count;
+    std::atomic< int > next;   // Next index to hand out
+    std::atomic< int > slots;  // Next slot to hand out
+    int pending;               // Queue entries not yet finished (under mutex_)
+};
+
+ThreadPool::ThreadPool( int threads ) : stop_( false ) {
+    for ( int i = 1; i < threads; i++ ) {
+        workers_.push_back( std::thread( [ this ]{ workerLoop(); } ) );
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        stop_ = true;
+    }
+    work_.notify_all();
+    for ( size_t i = 0; i < workers_.size(); i++ ) {
+        workers_[ i ].join();
+    }
+}
+
+void ThreadPool::run( Job & job, int slot ) {
+    for ( int i = job.next.fetch_add( 1 ); i < job.count; i = job.next.fetch_add( 1 ) ) {
+        ( *job.body )( i, slot );
+    }
+}
+
+void ThreadPool::workerLoop() {
+    std::unique_lock< std::mutex > lock( mutex_ );
+    for ( ;; ) {
+        work_.wait( lock, [ this ]{ return stop_ || !queue_.empty(); } );
+        if ( stop_ ) {
+            return;
+        }
+        Job * job = queue_.front();
+        queue_.pop_front();
+        lock.unlock();
+
+        run( *job, job->slots.fetch_add( 1 ) );
+
+        lock.lock();
+        if ( --job->pending == 0 ) {
+            done_.notify_all();
+        }
+    }
+}
+
+void ThreadPool::parallelFor( int count, int maxThreads, Body const & body ) {
+    int const helpers = std::min( std::min( maxThreads, count ) - 1, (int)workers_.size() );
+    if ( helpers <= 0 ) {
+        for ( int i = 0; i < count; i++ ) {
+            body( i, 0 );
+        }
+        return;
+    }
+
+    Job job;
+    job.body = &body;
+    job.count = count;
+    job.next = 0;
+    job.slots = 1;
+    job.pending = helpers;
+    {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        for ( int i = 0; i < helpers; i++ ) {
+            queue_.push_back( &job );
+        }
+    }
+    if ( helpers == (int)workers_.size() ) {
+        work_.notify_all();
+    } else {
+        for ( int i = 0; i < helpers; i++ ) {
+            work_.notify_one();
+        }
+    }
+
+    run( job, 0 );
+
+    // Every index has been handed out; withdraw the entries no pool thread
+    // picked up and wait for the ones that did.
+    std::unique_lock< std::mutex > lock( mutex_ );
+    for ( std::deque< Job * >::iterator it = queue_.begin(); it != queue_.end(); ) {
+        if ( *it == &job ) {
+            it = queue_.erase( it );
+            job.pending--;
+        } else {
+            ++it;
+        }
+    }
+    done_.wait( lock, [ &job ]{ return job.pending == 0; } );
+}
+
+namespace {
+
+// Namespace scope and constant initialized: a function local static would
+// get no guard, as we build with -fno-threadsafe-statics
+std::once_flag sharedOnce;
+std::unique_ptr< ThreadPool > sharedPool;
+
+}
+
+ThreadPool & ThreadPool::shared() {
+    std::call_once( sharedOnce, []{
+        sharedPool.reset( new ThreadPool( (int)std::max( 1u, std::thread::hardware_concurrency() ) ) );
+    } );
+    return *sharedPool;
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Blas {
+
+// Intra-op thread pool.  parallelFor splits a loop over the calling thread
+// and up to maxThreads - 1 pool threads; indices are handed out one at a
+// time, so uneven work items balance themselves.  Every thread running a
+// loop gets a distinct slot in [0, maxThreads) (the caller is slot 0), which
+// callers use to index per-thread scratch buffers.  Several threads may run
+// loops on the same pool at once; a loop never waits for pool threads that
+// are busy elsewhere, the caller then simply does more of the work itself.
+class ThreadPool {
+public:
+    typedef std::function< void( int index, int slot ) > Body;
+
+    // threads includes the calling thread, so threads - 1 are started
+    explicit ThreadPool( int threads );
+    ~ThreadPool();
+
+    int threads() const { return (int)workers_.size() + 1; }
+
+    // Runs body( i, slot ) for every i in [0, count) and returns when all
+    // calls have finished.
+    void parallelFor( int count, int maxThreads, Body const & body );
+
+    // Process wide pool with one thread per hardware thread, started on
+    // first use.
+    static ThreadPool & shared();
+
+private:
+    struct Job;
+
+    void workerLoop();
+    static void run( Job & job, int slot );
+
+    std::vector< std::thread > workers_;
+    std::deque< Job * > queue_;  // One entry per pool thread a job asks for
+    std::mutex mutex_;
+    std::condition_variable work_;
+    std::condition_variable done_;
+    bool stop_;
+
+    // Non-copyable, non-assignable.
+    ThreadPool( ThreadPool const & );
+    ThreadPool & operator=( ThreadPool const & );
+};
+
+}
@@ -0,0 +1,78 @@
+#include "BatchEvaluator.hpp"
+#include "Tensor.hpp"
+#include "TensorArchive.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace mtorch;
+
+static void usage(const char* exe) {
+    std::cout << "Usage: " << exe << " [--workers N] [--threads N] [--prefetch N] [--results N]\n"
+                 "       [--archive inputs.mtar] model.bin output_dir [input.bin ...]\n\n"
+                 "Runs every input through the model with a pipelined reader, N inference\n"
+                 "workers and an asynchronous writer.  --threads sets the threads each\n"
+                 "worker may use inside a layer.  With --archive the inputs are the\n"
+                 "tensors of a TensorArchive (all of them when none are listed).\n";
+}
+
+int main(int argc, char** argv) {
+    BatchEvaluatorOptions options;
+    std::string archive_file;
+    std::vector<std::string> positional;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (std::strcmp(arg, "--workers") == 0 && has_value) {
+            options.num_workers = (uint32_t)std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--threads") == 0 && has_value) {
+            options.threads_per_worker = (uint32_t)std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--prefetch") == 0 && has_value) {
+            options.prefetch_depth = (uint32_t)std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--results") == 0 && has_value) {
+            options.result_depth = (uint32_t)std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--archive") == 0 && has_value) {
+            archive_file = argv[++i];
+        } else if (arg[0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() < 2 || (archive_file.empty() && positional.size() < 3)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        std::unique_ptr<BatchEvaluator> evaluator(BatchEvaluator::loadFromFile(positional[0], options));
+        std::vector<std::string> inputs(positional.begin() + 2, positional.end());
+
+        BatchEvaluator::Reader reader = BatchEvaluator::fileReader();
+        std::unique_ptr<TensorArchive> archive;
+        if (!archive_file.empty()) {
+            archive.reset(TensorArchive::open(archive_file));
+            if (inputs.empty()) {
+                inputs = archive->names();
+            }
+            // Zero-copy views on the mapping; only the header is freed downstream
+            TensorArchive* source = archive.get();
+            reader = [source](const std::string& name) { return source->get(name); };
+        }
+
+        BatchEvaluatorStats stats = evaluator->run(inputs, reader, BatchEvaluator::fileWriter(positional[1]));
+        BatchEvaluator::printStats(stats);
+    } catch (std::runtime_error & e) {
+        std::cout << "Exception caught!" << std::endl;
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,16 @@
+#include <stddef.h>       // for size_t
+
+#include "Activation.hpp"
+#include "Kernels/LayerKernels.hpp"  // for layerKernels
+
+
+namespace mtorch {
+
+  void Activation::apply(float* data, const size_t n) const {
+    if (type == ACTIVATION_NONE) {
+      return;
+    }
+    layerKernels().activate(type, a, b, data, n);
+  }
+
+};  // namespace mtorch
@@ -0,0 +1,107 @@
+//
+//  Activation.hpp
+//
+//  Pointwise activation that SpatialConvolution and Linear stages apply to
+//  their output tile as it is produced, so a following Threshold / Tanh
+//  stage does not need its own output tensor and pass over memory.
+//  Sequential::fuseActivations merges such stage pairs.
+//
+
+#pragma once
+
+#include <math.h>   // for tanhf
+#include <stddef.h> // for size_t
+
+namespace mtorch {
+
+  typedef enum {
+    ACTIVATION_NONE = 0,
+    ACTIVATION_THRESHOLD = 1,  // x > a ? x : b  (Threshold, ReLU for a = b = 0)
+    ACTIVATION_TANH = 2,
+    ACTIVATION_CLAMP = 3,      // min(max(x, a), b)
+  } ActivationType;
+
+  // The activation math, with internal linkage: Kernels/LayerKernels.cpp is
+  // built once per instruction set level and must not instantiate inline
+  // functions the whole program shares (such as the Activation members).
+  static inline float activate(const ActivationType type, const float a,
+    const float b, const float x) {
+    switch (type) {
+    case ACTIVATION_THRESHOLD:
+      return x > a ? x : b;
+    case ACTIVATION_TANH:
+      return tanhf(x);
+    case ACTIVATION_CLAMP:
+      return x < a ? a : (x > b ? b : x);
+    default:
+      return x;
+    }
+  }
+
+  // In place over n consecutive values.  The switch is hoisted so every case
+  // is a simple loop the compiler vectorizes.
+  static inline void activate(const ActivationType type, const float a,
+    const float b, float* data, const size_t n) {
+    switch (type) {
+    case ACTIVATION_THRESHOLD:
+      for (size_t i = 0; i < n; i++) {
+        data[i] = data[i] > a ? data[i] : b;
+      }
+      break;
+    case ACTIVATION_TANH:
+      for (size_t i = 0; i < n; i++) {
+        data[i] = tanhf(data[i]);
+      }
+      break;
+    case ACTIVATION_CLAMP:
+      for (size_t i = 0; i < n; i++) {
+        data[i] = data[i] < a ? a : (data[i] > b ? b : data[i]);
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  struct Activation {
+    ActivationType type;
+    float a;
+    float b;
+
+    Activation() : type(ACTIVATION_NONE), a(0), b(0) {}
+    Activation(const ActivationType type_, const float a_ = 0,
+      const float b_ = 0) : type(type_), a(a_), b(b_) {}
+
+    static Activation threshold(const float threshold, const float val) {
+      return Activation(ACTIVATION_THRESHOLD, threshold, val);
+    }
+    static Activation tanh() { return Activation(ACTIVATION_TANH); }
+    static Activation clamp(const float min_val, const float max_val) {
+      return Activation(ACTIVATION_CLAMP, min_val, max_val);
+    }
+
+    bool none() const { return type == ACTIVATION_NONE; }
+
+    // Non-decreasing activations commute with max pooling:
+    // max(f(x), f(y)) = f(max(x, y))
+    bool monotonic() const {
+      switch (type) {
+      case ACTIVATION_THRESHOLD:
+        return b <= a;
+      case ACTIVATION_CLAMP:
+        return a <= b;
+      default:
+        return true;
+      }
+    }
+
+    float operator()(const float x) const {
+      return activate(type, a, b, x);
+    }
+
+    // Applies the activation in place to n consecutive values, with the
+    // kernels built for the running CPU (see Kernels/LayerKernels.hpp).
+    void apply(float* data, const size_t n) const;
+  };
+
+};  // namespace mtorch
@@ -0,0 +1,240 @@
+#include <stddef.h>       // for NULL
+#include <atomic>         // for atomic
+#include <chrono>         // for steady_clock
+#include <exception>      // for exception_ptr
+#include <iostream>       // for cout
+#include <mutex>          // for mutex, lock_guard
+#include <stdexcept>      // for runtime_error
+#include <string>         // for string
+#include <thread>         // for thread
+#include <vector>         // for vector
+
+#include "BatchEvaluator.hpp"
+#include "FileUtils.hpp"  // for fileReadToBuffer
+#include "Tensor.hpp"     // for Tensor, TO_TENSOR_PTR
+#include "TorchData.hpp"  // for TorchData
+#include "TorchStage.hpp" // for TorchStage
+#include "Utils/BoundedQueue.hpp"
+
+#define SAFE_DELETE(x) if (x != NULL) { delete x; x = NULL; }
+
+namespace mtorch {
+
+  namespace {
+
+    struct PipelineItem {
+      std::string name;
+      TorchData* data;
+    };
+
+    typedef std::chrono::steady_clock Clock;
+
+    double secondsSince(const Clock::time_point& start) {
+      return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Records the first failure and shuts the pipeline down
+    struct PipelineError {
+      std::mutex mutex;
+      std::exception_ptr error;
+
+      void set(std::exception_ptr e) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) {
+          error = e;
+        }
+      }
+    };
+
+  }  // unnamed namespace
+
+  BatchEvaluator::BatchEvaluator(const std::vector<uint8_t>& model_buffer,
+    const BatchEvaluatorOptions& options) : options_(options) {
+    if (options_.num_workers == 0) {
+      options_.num_workers = 1;
+    }
+    for (uint32_t i = 0; i < options_.num_workers; i++) {
+      TorchStage* model = TorchStage::loadFromBuffer(model_buffer);
+      if (model == NULL) {
+        for (size_t j = 0; j < models_.size(); j++) {
+          delete models_[j];
+        }
+        throw std::runtime_error("BatchEvaluator::BatchEvaluator() - ERROR: "
+          "Could not load model!");
+      }
+      model->setNumThreads(options_.threads_per_worker);
+      models_.push_back(model);
+    }
+  }
+
+  BatchEvaluator::~BatchEvaluator() {
+    for (size_t i = 0; i < models_.size(); i++) {
+      delete models_[i];
+    }
+  }
+
+  BatchEvaluator* BatchEvaluator::loadFromFile(const std::string& model_file,
+    const BatchEvaluatorOptions& options) {
+    std::vector<uint8_t> buffer = FileUtils::fileReadToBuffer(
+      model_file.c_str());
+    if (buffer.empty()) {
+      throw std::runtime_error("BatchEvaluator::loadFromFile() - ERROR: "
+        "Could not open file " + model_file);
+    }
+    return new BatchEvaluator(buffer, options);
+  }
+
+  BatchEvaluatorStats BatchEvaluator::run(const std::vector<std::string>& names,
+    const Reader& reader, const Writer& writer) {
+    BoundedQueue<PipelineItem> inputs(options_.prefetch_depth);
+    BoundedQueue<PipelineItem> results(options_.result_depth);
+    BatchEvaluatorStats stats;
+    std::mutex stats_mutex;
+    PipelineError failure;
+    std::atomic<uint32_t> live_workers(options_.num_workers);
+
+    const Clock::time_point start = Clock::now();
+
+    std::thread reader_thread([&]() {
+      double read = 0, stall = 0;
+      try {
+        for (size_t i = 0; i < names.size(); i++) {
+          const Clock::time_point t0 = Clock::now();
+          PipelineItem item = {names[i], reader(names[i])};
+          read += secondsSince(t0);
+          if (!inputs.push(item, stall)) {
+            SAFE_DELETE(item.data);
+            break;
+          }
+        }
+      } catch (...) {
+        failure.set(std::current_exception());
+        results.close();
+      }
+      inputs.close();
+      std::lock_guard<std::mutex> lock(stats_mutex);
+      stats.read_seconds = read;
+      stats.reader_stall_seconds = stall;
+    });
+
+    std::vector<std::thread> workers;
+    for (uint32_t w = 0; w < options_.num_workers; w++) {
+      workers.push_back(std::thread([&, w]() {
+        TorchStage* model = models_[w];
+        double compute = 0, in_stall = 0, out_stall = 0;
+        PipelineItem item;
+        try {
+          while (inputs.pop(item, in_stall)) {
+            TorchData* output = NULL;
+            const Clock::time_point t0 = Clock::now();
+            model->forwardProp(*item.data, &output);
+            compute += secondsSince(t0);
+            if (!model->consumesInput()) {
+              SAFE_DELETE(item.data);
+            }
+            item.data = output;
+            if (output == NULL || TO_TENSOR_PTR(output) == NULL) {
+              SAFE_DELETE(item.data);
+              throw std::runtime_error("BatchEvaluator::run() - ERROR: "
+                "model output is not a tensor!");
+            }
+            if (!results.push(item, out_stall)) {
+              SAFE_DELETE(item.data);
+              break;
+            }
+          }
+        } catch (...) {
+          failure.set(std::current_exception());
+          inputs.close();
+        }
+        if (--live_workers == 0) {
+          results.close();
+        }
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        stats.compute_seconds += compute;
+        stats.worker_input_stall_seconds += in_stall;
+        stats.worker_output_stall_seconds += out_stall;
+      }));
+    }
+
+    // The calling thread is the writer
+    double write = 0, write_stall = 0;
+    uint64_t items = 0;
+    bool failed = false;
+    PipelineItem item;
+    while (results.pop(item, write_stall)) {
+      if (failed) {
+        SAFE_DELETE(item.data);
+        continue;
+      }
+      try {
+        const Clock::time_point t0 = Clock::now();
+        writer(item.name, *TO_TENSOR_PTR(item.data));
+        write += secondsSince(t0);
+        items++;
+      } catch (...) {
+        failure.set(std::current_exception());
+        failed = true;
+        inputs.close();
+        results.close();
+      }
+      SAFE_DELETE(item.data);
+    }
+
+    reader_thread.join();
+    for (size_t w = 0; w < workers.size(); w++) {
+      workers[w].join();
+    }
+    // Free anything left behind by an early shutdown
+    double ignored = 0;
+    while (inputs.pop(item, ignored)) {
+      SAFE_DELETE(item.data);
+    }
+    while (results.pop(item, ignored)) {
+      SAFE_DELETE(item.data);
+    }
+    if (failure.error) {
+      std::rethrow_exception(failure.error);
+    }
+
+    stats.items = items;
+    stats.write_seconds = write;
+    stats.writer_stall_seconds = write_stall;
+    stats.wall_seconds = secondsSince(start);
+    stats.items_per_second = stats.wall_seconds > 0 ?
+      (double)items / stats.wall_seconds : 0;
+    return stats;
+  }
+
+  BatchEvaluator::Reader BatchEvaluator::fileReader() {
+    return [](const std::string& name) {
+      return Tensor<float>::loadFromFile(name);
+    };
+  }
+
+  BatchEvaluator::Writer BatchEvaluator::fileWriter(
+    const std::string& output_dir) {
+    return [output_dir](const std::string& name, Tensor<float>& result) {
+      const size_t slash = name.find_last_of("/\\");
+      const std::string base = slash == std::string::npos ? name :
+        name.substr(slash + 1);
+      Tensor<float>::saveToFile(&result, output_dir + "/" + base);
+    };
+  }
+
+  void BatchEvaluator::printStats(const BatchEvaluatorStats& stats) {
+    std::cout << "Evaluated " << stats.items << " inputs in "
+      << stats.wall_seconds << " s (" << stats.items_per_second
+      << " inputs/s)" << std::endl;
+    std::cout << "  read:    " << stats.read_seconds << " s busy, "
+      << stats.reader_stall_seconds << " s blocked on full prefetch queue"
+      << std::endl;
+    std::cout << "  compute: " << stats.compute_seconds << " s busy, "
+      << stats.worker_input_stall_seconds << " s starved, "
+      << stats.worker_output_stall_seconds << " s blocked on full result queue"
+      << std::endl;
+    std::cout << "  write:   " << stats.write_seconds << " s busy, "
+      << stats.writer_stall_seconds << " s waiting for results" << std::endl;
+  }
+
+}  // namespace mtorch
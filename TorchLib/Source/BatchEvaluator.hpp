@@ -0,0 +1,89 @@
+//
+//  BatchEvaluator.hpp
+//
+//  Pipelined offline evaluation of a model over many inputs.  Three stages
+//  connected by bounded queues:
+//
+//    reader  --(prefetch queue)-->  N inference workers  --(result queue)-->
+//    writer
+//
+//  The reader loads and decodes inputs ahead of compute, so file I/O
+//  overlaps with forwardProp.  Every worker owns its own copy of the model
+//  (stages are not re-entrant).  The run statistics report throughput and
+//  how long each stage spent blocked on its neighbours.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace mtorch {
+
+  template <typename T> class Tensor;
+  class TorchStage;
+
+  struct BatchEvaluatorOptions {
+    uint32_t num_workers = 1;
+    uint32_t threads_per_worker = 1;  // Intra-op threads (TorchStage::setNumThreads)
+    uint32_t prefetch_depth = 8;  // Decoded inputs waiting for a worker
+    uint32_t result_depth = 8;  // Results waiting for the writer
+  };
+
+  struct BatchEvaluatorStats {
+    uint64_t items = 0;
+    double wall_seconds = 0;
+    double items_per_second = 0;
+
+    double read_seconds = 0;  // Time spent inside the reader callback
+    double compute_seconds = 0;  // Sum over workers of forwardProp time
+    double write_seconds = 0;  // Time spent inside the writer callback
+
+    double reader_stall_seconds = 0;  // Reader blocked on a full prefetch queue
+    double worker_input_stall_seconds = 0;  // Workers starved of inputs
+    double worker_output_stall_seconds = 0;  // Workers blocked on full results
+    double writer_stall_seconds = 0;  // Writer waiting for results
+  };
+
+  class BatchEvaluator {
+  public:
+    // The reader returns a new tensor for the named input (ownership is
+    // transferred), the writer consumes a result (ownership is kept).
+    typedef std::function<Tensor<float>*(const std::string& name)> Reader;
+    typedef std::function<void(const std::string& name,
+      Tensor<float>& result)> Writer;
+
+    // Loads one model instance per worker.  Throws std::runtime_error if the
+    // model cannot be loaded.
+    BatchEvaluator(const std::vector<uint8_t>& model_buffer,
+      const BatchEvaluatorOptions& options = BatchEvaluatorOptions());
+    ~BatchEvaluator();
+
+    static BatchEvaluator* loadFromFile(const std::string& model_file,
+      const BatchEvaluatorOptions& options = BatchEvaluatorOptions());
+
+    // Runs every named input through the pipeline.  The first exception
+    // raised by any stage stops the pipeline and is rethrown here.
+    BatchEvaluatorStats run(const std::vector<std::string>& names,
+      const Reader& reader, const Writer& writer);
+
+    // Convenience callbacks: read Tensor files, write Tensor files into a
+    // directory (named after the input).
+    static Reader fileReader();
+    static Writer fileWriter(const std::string& output_dir);
+
+    static void printStats(const BatchEvaluatorStats& stats);
+
+  protected:
+    BatchEvaluatorOptions options_;
+    std::vector<TorchStage*> models_;  // One per worker
+
+    // Non-copyable, non-assignable.
+    BatchEvaluator(BatchEvaluator&);
+    BatchEvaluator& operator=(const BatchEvaluator&);
+  };
+
+};  // namespace mtorch
@@ -0,0 +1,315 @@
+#include <stddef.h>                // for NULL
+#include <string.h>                // for memcpy
+#include <algorithm>               // for min, max
+
+#include "DepthFirst.hpp"
+#include "SpatialConvolution.hpp"  // for SpatialConvolution
+#include "SpatialMaxPooling.hpp"   // for SpatialMaxPooling
+#include "Tensor.hpp"              // for Tensor, TO_TENSOR_PTR
+#include "TorchData.hpp"           // for TorchData
+#include "TorchStage.hpp"          // for TorchStage
+
+#define SAFE_DELETE(x) if (x != NULL) { delete x; x = NULL; }
+#define SAFE_DELETE_ARR(x) if (x != NULL) { delete[] x; x = NULL; }
+
+namespace mtorch {
+
+  namespace {
+
+    bool isConvolution(const TorchStage& stage) {
+      return stage.type() == SPATIAL_CONVOLUTION_STAGE ||
+        stage.type() == SPATIAL_CONVOLUTION_GROUPED_STAGE;
+    }
+
+    // Filter size, stride, padding and pooling of a convolution along
+    // dimension d (0: width, 1: height)
+    void convGeometry(const SpatialConvolution& conv, const int d,
+      int64_t& k, int64_t& s, int64_t& pad, int64_t& pool) {
+      k = d == 0 ? conv.filtWidth() : conv.filtHeight();
+      s = d == 0 ? conv.strideW() : conv.strideH();
+      pad = d == 0 ? conv.padW() : conv.padH();
+      pool = d == 0 ? conv.poolW() : conv.poolH();
+    }
+
+    // Outputs a stage computes along dimension d from extent inputs
+    // (before pooling for convolutions)
+    uint64_t computed(const TorchStage& stage, const int d,
+      const uint32_t extent) {
+      if (isConvolution(stage)) {
+        int64_t k, s, pad, pool;
+        convGeometry((const SpatialConvolution&)stage, d, k, s, pad, pool);
+        return (uint64_t)((extent + 2 * pad - k) / s + 1);
+      }
+      if (stage.type() == SPATIAL_MAX_POOLING_STAGE) {
+        const SpatialMaxPooling& pool = (const SpatialMaxPooling&)stage;
+        return extent / (d == 0 ? pool.poolW() : pool.poolH());
+      }
+      return extent;
+    }
+
+    // Work per computed output pixel: multiply-adds for convolutions, one
+    // operation per value for the rest
+    double pixelCost(const TorchStage& stage, const uint32_t* out_size) {
+      if (isConvolution(stage)) {
+        const SpatialConvolution& conv = (const SpatialConvolution&)stage;
+        return (double)conv.featsIn() * conv.featsOut() * conv.filtWidth() *
+          conv.filtHeight();
+      }
+      return (double)out_size[2];
+    }
+
+    // dst[dx : dx + w][dy : dy + h] = src[sx : sx + w][sy : sy + h] of
+    // every plane
+    void copyRegion(const Tensor<float>& src, const uint32_t sx,
+      const uint32_t sy, Tensor<float>& dst, const uint32_t dx,
+      const uint32_t dy, const uint32_t w, const uint32_t h) {
+      const uint32_t src_width = src.size()[0];
+      const uint32_t src_height = src.size()[1];
+      const uint32_t dst_width = dst.size()[0];
+      const uint32_t dst_height = dst.size()[1];
+      const float* src_data = ((Tensor<float>&)src).getData();
+      float* dst_data = dst.getData();
+      for (uint32_t c = 0; c < src.size()[2]; c++) {
+        for (uint32_t y = 0; y < h; y++) {
+          memcpy(dst_data + ((size_t)c * dst_height + dy + y) * dst_width + dx,
+            src_data + ((size_t)c * src_height + sy + y) * src_width + sx,
+            sizeof(float) * w);
+        }
+      }
+    }
+
+    Tensor<float>* regionOf(const Tensor<float>& src, const uint32_t x0,
+      const uint32_t x1, const uint32_t y0, const uint32_t y1) {
+      const uint32_t size[3] = {x1 - x0, y1 - y0, src.size()[2]};
+      Tensor<float>* ret = new Tensor<float>(3, size);
+      copyRegion(src, x0, y0, *ret, 0, 0, x1 - x0, y1 - y0);
+      return ret;
+    }
+
+  }  // unnamed namespace
+
+  bool DepthFirst::tileable(const TorchStage& stage) {
+    switch (stage.type()) {
+    case SPATIAL_CONVOLUTION_STAGE:
+    case SPATIAL_CONVOLUTION_GROUPED_STAGE:
+    case SPATIAL_MAX_POOLING_STAGE:
+    case THRESHOLD_STAGE:
+    case TANH_STAGE:
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  void DepthFirst::inputRegion(const TorchStage& stage,
+    const uint32_t* in_size, Tile& tile) {
+    for (int d = 0; d < 2; d++) {
+      tile.skip[d] = 0;
+      if (stage.type() == SPATIAL_MAX_POOLING_STAGE) {
+        const SpatialMaxPooling& pool = (const SpatialMaxPooling&)stage;
+        const uint32_t k = d == 0 ? pool.poolW() : pool.poolH();
+        tile.lo[d] = tile.out_lo[d] * k;
+        tile.hi[d] = tile.out_hi[d] * k;
+        continue;
+      }
+      if (!isConvolution(stage)) {
+        tile.lo[d] = tile.out_lo[d];
+        tile.hi[d] = tile.out_hi[d];
+        continue;
+      }
+
+      // Outputs [out_lo, out_hi) are pooled from convolution outputs
+      // [out_lo * pool, out_hi * pool), which read the padded inputs
+      // [i * s - pad, i * s - pad + k)
+      int64_t k, s, pad, pool;
+      convGeometry((const SpatialConvolution&)stage, d, k, s, pad, pool);
+      const int64_t lo = (int64_t)tile.out_lo[d] * pool * s - pad;
+      const int64_t hi = ((int64_t)tile.out_hi[d] * pool - 1) * s - pad + k;
+      // The first convolution output of the region (lo / s) must start a
+      // pooling window, the inputs before the needed ones are only read
+      const int64_t step = s * pool;
+      tile.lo[d] = lo <= 0 ? 0 : (uint32_t)(lo / step * step);
+      tile.hi[d] = (uint32_t)std::min<int64_t>(in_size[d], hi);
+      // ... and the region must produce whole pooling windows
+      while (tile.hi[d] < in_size[d] &&
+          ((tile.hi[d] - tile.lo[d] + 2 * pad - k) / s + 1) % pool != 0) {
+        tile.hi[d]++;
+      }
+      tile.skip[d] = tile.out_lo[d] - (uint32_t)(tile.lo[d] / step);
+    }
+  }
+
+  void DepthFirst::tiles(const std::vector<TorchStage*>& stages,
+    const std::vector<std::vector<uint32_t> >& sizes, const uint32_t x0,
+    const uint32_t x1, const uint32_t y0, const uint32_t y1,
+    std::vector<Tile>& tiles) {
+    tiles.resize(stages.size());
+    uint32_t lo[2] = {x0, y0};
+    uint32_t hi[2] = {x1, y1};
+    for (size_t i = stages.size(); i-- > 0;) {
+      Tile& tile = tiles[i];
+      for (int d = 0; d < 2; d++) {
+        tile.out_lo[d] = lo[d];
+        tile.out_hi[d] = hi[d];
+      }
+      inputRegion(*stages[i], sizes[i].data(), tile);
+      for (int d = 0; d < 2; d++) {
+        lo[d] = tile.lo[d];
+        hi[d] = tile.hi[d];
+      }
+    }
+  }
+
+  uint64_t DepthFirst::tileBytes(
+    const std::vector<std::vector<uint32_t> >& sizes,
+    const std::vector<Tile>& tiles) {
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < tiles.size(); i++) {
+      const Tile& tile = tiles[i];
+      const uint64_t in = (uint64_t)sizes[i][2] * (tile.hi[0] - tile.lo[0]) *
+        (tile.hi[1] - tile.lo[1]);
+      const uint64_t out = (uint64_t)sizes[i + 1][2] *
+        (tile.out_hi[0] - tile.out_lo[0] + tile.skip[0]) *
+        (tile.out_hi[1] - tile.out_lo[1] + tile.skip[1]);
+      bytes = std::max<uint64_t>(bytes, sizeof(float) * (in + out));
+    }
+    return bytes;
+  }
+
+  double DepthFirst::tileCost(const std::vector<TorchStage*>& stages,
+    const std::vector<std::vector<uint32_t> >& sizes,
+    const std::vector<Tile>& tiles) {
+    double cost = 0;
+    for (size_t i = 0; i < stages.size(); i++) {
+      const Tile& tile = tiles[i];
+      cost += pixelCost(*stages[i], sizes[i + 1].data()) *
+        computed(*stages[i], 0, tile.hi[0] - tile.lo[0]) *
+        computed(*stages[i], 1, tile.hi[1] - tile.lo[1]);
+    }
+    return cost;
+  }
+
+  double DepthFirst::imageCost(const std::vector<TorchStage*>& stages,
+    const std::vector<std::vector<uint32_t> >& sizes) {
+    double cost = 0;
+    for (size_t i = 0; i < stages.size(); i++) {
+      cost += pixelCost(*stages[i], sizes[i + 1].data()) *
+        computed(*stages[i], 0, sizes[i][0]) *
+        computed(*stages[i], 1, sizes[i][1]);
+    }
+    return cost;
+  }
+
+  void DepthFirst::forwardProp(const std::vector<TorchStage*>& stages,
+    TorchData& input, TorchData** output, const uint64_t tile_bytes,
+    const uint32_t recompute) {
+    Tensor<float>& in = (Tensor<float>&)input;
+
+    std::vector<std::vector<uint32_t> > sizes(stages.size() + 1);
+    sizes[0].assign(in.size(), in.size() + in.dim());
+    bool valid = in.dim() == 3;
+    for (size_t i = 0; valid && i < stages.size(); i++) {
+      valid = stages[i]->outputSize(3, sizes[i].data(), sizes[i + 1]) &&
+        sizes[i + 1].size() == 3;
+    }
+
+    // Candidate tile sizes, halving the longer side each time, and the
+    // first of them that fits in tile_bytes.  The halo is recomputed for
+    // every tile, so the tile is grown back while that costs more than
+    // recompute percent.  Both are measured on a tile in
+    // the middle of the image, which has a halo on every side.
+    std::vector<Tile> tile;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint32_t> tile_w;
+    std::vector<uint32_t> tile_h;
+    size_t choice = 0;
+    if (valid) {
+      width = sizes.back()[0];
+      height = sizes.back()[1];
+      tile_w.push_back(width);
+      tile_h.push_back(height);
+      while (tile_w.back() > 1 || tile_h.back() > 1) {
+        uint32_t w = tile_w.back();
+        uint32_t h = tile_h.back();
+        if (w >= h) {
+          w = (w + 1) / 2;
+        } else {
+          h = (h + 1) / 2;
+        }
+        tile_w.push_back(w);
+        tile_h.push_back(h);
+      }
+      const double image_cost = imageCost(stages, sizes);
+      for (choice = 0; choice + 1 < tile_w.size(); choice++) {
+        const uint32_t x0 = (width - tile_w[choice]) / 2;
+        const uint32_t y0 = (height - tile_h[choice]) / 2;
+        tiles(stages, sizes, x0, x0 + tile_w[choice], y0,
+          y0 + tile_h[choice], tile);
+        if (tileBytes(sizes, tile) <= tile_bytes) {
+          break;
+        }
+      }
+      for (; choice > 0; choice--) {
+        const uint32_t x0 = (width - tile_w[choice]) / 2;
+        const uint32_t y0 = (height - tile_h[choice]) / 2;
+        tiles(stages, sizes, x0, x0 + tile_w[choice], y0,
+          y0 + tile_h[choice], tile);
+        const double tiles_per_image = (double)width * height /
+          ((double)tile_w[choice] * tile_h[choice]);
+        if (tileCost(stages, sizes, tile) * tiles_per_image <=
+            image_cost * (1.0 + recompute / 100.0)) {
+          break;
+        }
+      }
+    }
+
+    if (!valid || choice == 0) {
+      // One stage at a time (also reports unsupported sizes)
+      TorchData* cur = &input;
+      for (size_t i = 0; i < stages.size(); i++) {
+        TorchData* next = NULL;
+        stages[i]->forwardProp(*cur, &next);
+        if (cur != &input) {
+          delete cur;
+        }
+        cur = next;
+      }
+      *output = cur;
+      return;
+    }
+
+    Tensor<float>* out = new Tensor<float>(3, sizes.back().data());
+    for (uint32_t y0 = 0; y0 < height; y0 += tile_h[choice]) {
+      const uint32_t y1 = std::min(height, y0 + tile_h[choice]);
+      for (uint32_t x0 = 0; x0 < width; x0 += tile_w[choice]) {
+        const uint32_t x1 = std::min(width, x0 + tile_w[choice]);
+        tiles(stages, sizes, x0, x1, y0, y1, tile);
+        Tensor<float>* cur = regionOf(in, tile[0].lo[0], tile[0].hi[0],
+          tile[0].lo[1], tile[0].hi[1]);
+        for (size_t i = 0; i < stages.size(); i++) {
+          TorchData* next = NULL;
+          stages[i]->forwardProp(*cur, &next);
+          delete cur;
+          Tensor<float>* computed = TO_TENSOR_PTR(next);
+          const Tile& t = tile[i];
+          const uint32_t w = t.out_hi[0] - t.out_lo[0];
+          const uint32_t h = t.out_hi[1] - t.out_lo[1];
+          if (i + 1 == stages.size()) {
+            copyRegion(*computed, t.skip[0], t.skip[1], *out, x0, y0, w, h);
+            delete computed;
+          } else if (t.skip[0] == 0 && t.skip[1] == 0 &&
+              computed->size()[0] == w && computed->size()[1] == h) {
+            cur = computed;
+          } else {
+            cur = regionOf(*computed, t.skip[0], t.skip[0] + w, t.skip[1],
+              t.skip[1] + h);
+            delete computed;
+          }
+        }
+      }
+    }
+    *output = out;
+  }
+
+}  // namespace mtorch
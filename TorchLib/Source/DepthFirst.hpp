@@ -0,0 +1,81 @@
+//
+//  DepthFirst.hpp
+//
+//  Depth-first execution of a chain of spatial stages.  Layer at a time, a
+//  chain of convolutions on a large image writes every intermediate
+//  feature map out to memory and reads it back for the next stage.  Here
+//  the chain's output is split into tiles instead, and each tile is
+//  computed through the whole chain from the region of the input it
+//  depends on (its receptive field, including the halo shared with the
+//  neighbouring tiles, which is recomputed), so the intermediates of a tile
+//  stay in cache.
+//
+//  Every stage runs its usual implementation on a smaller image.  The zero
+//  padding of a convolution is only right at the image border: a tile
+//  inside the image reads the real pixels around it, and the outputs next
+//  to an interior tile edge are dropped.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Default bytes of the intermediates of a tile (one stage's input and
+// output region), sized for a per-core L2
+#define DEPTH_FIRST_TILE_BYTES (1 << 19)
+// Default for the work the halo recomputation may add to the chain (in
+// percent): tiles are grown past the byte budget until it is met
+#define DEPTH_FIRST_MAX_RECOMPUTE 20
+
+namespace mtorch {
+
+  class TorchData;
+  class TorchStage;
+
+  class DepthFirst {
+  public:
+    // Stages that can run on a region of the image: convolutions (also
+    // grouped and pooled), SpatialMaxPooling, Threshold and Tanh
+    static bool tileable(const TorchStage& stage);
+
+    // Runs the chain of tileable stages on a 3D input one tile of the
+    // output at a time, with tiles as large as fit in tile_bytes, or as
+    // recompute (percent) requires.  Falls back to running the stages one
+    // at a time if a single tile would cover the output.  input is not
+    // consumed.
+    static void forwardProp(const std::vector<TorchStage*>& stages,
+      TorchData& input, TorchData** output, const uint64_t tile_bytes,
+      const uint32_t recompute = DEPTH_FIRST_MAX_RECOMPUTE);
+
+  protected:
+    // Per dimension (width, height): input pixels [lo, hi) of a stage
+    // produce its output pixels [out_lo, out_hi), which start skip pixels
+    // into what the stage computes from them
+    struct Tile {
+      uint32_t lo[2];
+      uint32_t hi[2];
+      uint32_t out_lo[2];
+      uint32_t out_hi[2];
+      uint32_t skip[2];
+    };
+
+    static void inputRegion(const TorchStage& stage, const uint32_t* in_size,
+      Tile& tile);
+    // Tiles of every stage for the chain output region [x0, x1) x [y0, y1)
+    static void tiles(const std::vector<TorchStage*>& stages,
+      const std::vector<std::vector<uint32_t> >& sizes, const uint32_t x0,
+      const uint32_t x1, const uint32_t y0, const uint32_t y1,
+      std::vector<Tile>& tiles);
+    // Largest intermediates (one stage's input and output) of a tile
+    static uint64_t tileBytes(const std::vector<std::vector<uint32_t> >& sizes,
+      const std::vector<Tile>& tiles);
+    // Work of the stages on a tile, and on the whole image
+    static double tileCost(const std::vector<TorchStage*>& stages,
+      const std::vector<std::vector<uint32_t> >& sizes,
+      const std::vector<Tile>& tiles);
+    static double imageCost(const std::vector<TorchStage*>& stages,
+      const std::vector<std::vector<uint32_t> >& sizes);
+  };
+
+};  // namespace mtorch
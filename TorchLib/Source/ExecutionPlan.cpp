@@ -0,0 +1,73 @@
+#include <algorithm>      // for max
+#include <sstream>        // for stringstream
+#include <stdexcept>      // for runtime_error
+
+#include "ExecutionPlan.hpp"
+#include "Sequential.hpp" // for Sequential
+#include "TorchStage.hpp" // for TorchStage
+
+namespace mtorch {
+
+  void ExecutionPlanner::flatten(TorchStage& model,
+    std::vector<TorchStage*>& stages) {
+    if (model.type() == SEQUENTIAL_STAGE) {
+      Sequential& seq = (Sequential&)model;
+      for (uint32_t i = 0; i < seq.size(); i++) {
+        flatten(*seq.get(i), stages);
+      }
+    } else {
+      stages.push_back(&model);
+    }
+  }
+
+  ExecutionPlan ExecutionPlanner::build(TorchStage& model,
+    const uint32_t in_dim, const uint32_t* in_size) {
+    std::vector<TorchStage*> stages;
+    flatten(model, stages);
+
+    ExecutionPlan plan;
+    std::vector<uint32_t> cur(in_size, in_size + in_dim);
+    for (size_t i = 0; i < stages.size(); i++) {
+      TorchStage* stage = stages[i];
+      StagePlan sp;
+      sp.type = (uint32_t)stage->type();
+      sp.in_size = cur;
+      if (!stage->outputSize((uint32_t)cur.size(), cur.data(), sp.out_size)) {
+        std::stringstream ss;
+        ss << "ExecutionPlanner::build() - ERROR: stage " << i << " ("
+           << stage->name() << ") does not support its input size!";
+        throw std::runtime_error(ss.str());
+      }
+      sp.algorithm = stage->planAlgorithm((uint32_t)cur.size(), cur.data());
+      sp.workspace_bytes = stage->workspaceBytes((uint32_t)cur.size(),
+        cur.data());
+      plan.workspace_bytes = std::max(plan.workspace_bytes,
+        sp.workspace_bytes);
+      cur = sp.out_size;
+      plan.stages.push_back(sp);
+    }
+    return plan;
+  }
+
+  bool ExecutionPlanner::apply(TorchStage& model, const ExecutionPlan& plan) {
+    std::vector<TorchStage*> stages;
+    flatten(model, stages);
+    if (stages.size() != plan.stages.size()) {
+      return false;
+    }
+    // Every stage is checked before any is changed
+    for (size_t i = 0; i < stages.size(); i++) {
+      if ((uint32_t)stages[i]->type() != plan.stages[i].type ||
+          !stages[i]->canUseAlgorithm(plan.stages[i].algorithm)) {
+        return false;
+      }
+    }
+    for (size_t i = 0; i < stages.size(); i++) {
+      const StagePlan& sp = plan.stages[i];
+      stages[i]->useAlgorithm((uint32_t)sp.in_size.size(), sp.in_size.data(),
+        sp.algorithm);
+    }
+    return true;
+  }
+
+}  // namespace mtorch
@@ -0,0 +1,50 @@
+//
+//  ExecutionPlan.hpp
+//
+//  The result of planning a model for one input size: shape inference over
+//  the (flattened) stage list, the algorithm each stage runs and the
+//  workspace each stage needs.
+//
+//  Building a plan may benchmark candidate algorithms, so plans are meant to
+//  be persisted with PlanCache and re-applied on the next process start.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace mtorch {
+
+  class TorchStage;
+
+  struct StagePlan {
+    uint32_t type;  // TorchStageType, used to validate the plan on apply
+    uint32_t algorithm;
+    std::vector<uint32_t> in_size;
+    std::vector<uint32_t> out_size;
+    uint64_t workspace_bytes;
+  };
+
+  struct ExecutionPlan {
+    std::vector<StagePlan> stages;
+    uint64_t workspace_bytes = 0;  // The largest stage workspace
+  };
+
+  class ExecutionPlanner {
+  public:
+    // Runs shape inference and algorithm selection for model.  Throws
+    // std::runtime_error if a stage does not support its input size.
+    static ExecutionPlan build(TorchStage& model, const uint32_t in_dim,
+      const uint32_t* in_size);
+
+    // Re-applies a plan's algorithm choices.  Returns false (and changes
+    // nothing) if the plan does not match the model.
+    static bool apply(TorchStage& model, const ExecutionPlan& plan);
+
+    // The leaf stages of model in execution order (Sequential containers
+    // are expanded recursively).
+    static void flatten(TorchStage& model, std::vector<TorchStage*>& stages);
+  };
+
+};  // namespace mtorch
@@ -0,0 +1,40 @@
+#include <stddef.h>       // for size_t
+#include <string.h>       // for strcmp
+
+#include "Kernels/Kernels.hpp" // for Blas::kernels
+#include "LayerKernels.hpp"
+
+namespace mtorch {
+
+// The copies of LayerKernels.cpp built into the library (TorchLib.cmake)
+namespace baseline { extern LayerKernels const table; }
+#ifdef TORCH_KERNELS_X86
+namespace avx2 { extern LayerKernels const table; }
+namespace avx512 { extern LayerKernels const table; }
+#endif
+
+namespace {
+
+LayerKernels const * const sets[] = {
+#ifdef TORCH_KERNELS_X86
+    &avx512::table,
+    &avx2::table,
+#endif
+    &baseline::table,
+};
+
+}  // unnamed namespace
+
+// Blas::kernels() has already checked its set against the CPU, the layer
+// kernels follow its choice (nothing to cache, it is a few compares)
+LayerKernels const & layerKernels() {
+    const char* name = Blas::kernels().name;
+    for (size_t i = 0; i < sizeof(sets) / sizeof(sets[0]); i++) {
+        if (strcmp(sets[i]->name, name) == 0) {
+            return *sets[i];
+        }
+    }
+    return baseline::table;
+}
+
+}  // namespace mtorch
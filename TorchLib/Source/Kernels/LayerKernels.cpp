@@ -0,0 +1,461 @@
+#include "LayerKernels.hpp"
+#include "CpuFeatures.hpp"  // for CpuFeature
+#include "Simd.hpp"         // for float4, load, store, broadcast
+#include "SpatialConvolutionDirect.hpp"   // for DIRECT_CONV_*_BLOCK
+#include "SpatialConvolutionGrouped.hpp"  // for DEPTHWISE_CONV_WIDTH_BLOCK
+
+// Compiled once per instruction set level, TORCH_KERNELS_ISA naming the
+// namespace of the copy (TorchLib.cmake).  As in BlasLibrary's Kernels.cpp,
+// nothing here may instantiate an inline function or template with external
+// linkage (std::min, the Activation members, ...): the linker keeps one copy
+// of those for the whole program, which could then be one built for an
+// instruction set the CPU does not have.
+#ifndef TORCH_KERNELS_ISA
+#define TORCH_KERNELS_ISA baseline
+#endif
+
+#define TORCH_STRINGIFY(x) TORCH_STRINGIFY_(x)
+#define TORCH_STRINGIFY_(x) #x
+
+#if defined( __AVX512F__ )
+#define TORCH_KERNELS_FEATURES ( Blas::CPU_AVX512F | Blas::CPU_AVX2 | Blas::CPU_FMA )
+#elif defined( __AVX2__ )
+#define TORCH_KERNELS_FEATURES ( Blas::CPU_AVX2 | Blas::CPU_FMA )
+#else
+#define TORCH_KERNELS_FEATURES 0
+#endif
+
+namespace mtorch {
+namespace TORCH_KERNELS_ISA {
+
+namespace {
+
+// The blocks of output columns are 8 wide, one vector with AVX (AVX-512
+// would leave half of a 16 lane vector idle on narrow layers), two without
+#if SIMD_LANES >= 8
+typedef float vec __attribute__(( vector_size( 32 ) ));
+#else
+typedef Blas::simd::float4 vec;
+#endif
+const int VL = (int)(sizeof(vec) / sizeof(float));
+
+inline int minInt(int a, int b) { return a < b ? a : b; }
+
+// Loads VL input columns that are SW apart
+template <int SW>
+inline vec loadColumns(const float* p) {
+    if (SW == 1) {
+        return Blas::simd::load<vec>(p);
+    }
+    vec v;
+    for (int i = 0; i < VL; i++) {
+        v[i] = p[i * SW];
+    }
+    return v;
+}
+
+void activateArray(const ActivationType type, const float a, const float b,
+    float* data, const size_t n) {
+    activate(type, a, b, data, n);
+}
+
+// Computes NO consecutive output planes for output row oy.  weights points
+// at the [NO][nInputPlane][KH][KW] slice of the Torch ordered filter bank,
+// output at the first of the NO planes.  The inner loops have compile time
+// trip counts, so the NO x DIRECT_CONV_WIDTH_BLOCK accumulator tile stays in
+// vector registers across the whole reduction.  The activation is applied to
+// the tile right after it is stored, while it is still in L1.
+template <int KH, int KW, int SH, int SW, int NO>
+inline void convRow(const float* input, const int inputHeight,
+    const int inputWidth, const int nInputPlane, const float* weights,
+    const float* biases, float* output, const int outputHeight,
+    const int outputWidth, const int oy, const Activation& activation) {
+    const int WB = DIRECT_CONV_WIDTH_BLOCK;
+    const int NV = WB / VL;
+    const int filt = KH * KW;
+    const int wstride = nInputPlane * filt;
+    const int plane = inputHeight * inputWidth;
+    const int out_plane = outputHeight * outputWidth;
+    float* out_row = output + oy * outputWidth;
+
+    int ox0 = 0;
+    for (; ox0 + WB <= outputWidth; ox0 += WB) {
+        vec acc[NO][NV];
+        for (int o = 0; o < NO; o++) {
+            for (int v = 0; v < NV; v++) {
+                acc[o][v] = Blas::simd::broadcast<vec>(biases[o]);
+            }
+        }
+        for (int ci = 0; ci < nInputPlane; ci++) {
+            const float* w = weights + ci * filt;
+            const float* in = input + ci * plane + (oy * SH) * inputWidth + ox0 * SW;
+            for (int ky = 0; ky < KH; ky++) {
+                for (int kx = 0; kx < KW; kx++) {
+                    vec x[NV];
+                    for (int v = 0; v < NV; v++) {
+                        x[v] = loadColumns<SW>(in + ky * inputWidth + kx + VL * v * SW);
+                    }
+                    for (int o = 0; o < NO; o++) {
+                        const vec wv = Blas::simd::broadcast<vec>(w[o * wstride + ky * KW + kx]);
+                        for (int v = 0; v < NV; v++) {
+                            acc[o][v] += wv * x[v];
+                        }
+                    }
+                }
+            }
+        }
+        for (int o = 0; o < NO; o++) {
+            for (int v = 0; v < NV; v++) {
+                Blas::simd::store(out_row + o * out_plane + ox0 + VL * v, acc[o][v]);
+            }
+            activate(activation.type, activation.a, activation.b,
+                out_row + o * out_plane + ox0, WB);
+        }
+    }
+
+    // Right edge (fewer than WB columns left)
+    for (; ox0 < outputWidth; ox0++) {
+        float acc[NO];
+        for (int o = 0; o < NO; o++) {
+            acc[o] = biases[o];
+        }
+        for (int ci = 0; ci < nInputPlane; ci++) {
+            const float* w = weights + ci * filt;
+            const float* in = input + ci * plane + (oy * SH) * inputWidth + ox0 * SW;
+            for (int ky = 0; ky < KH; ky++) {
+                for (int kx = 0; kx < KW; kx++) {
+                    const float x = in[ky * inputWidth + kx];
+                    for (int o = 0; o < NO; o++) {
+                        acc[o] += w[o * wstride + ky * KW + kx] * x;
+                    }
+                }
+            }
+        }
+        for (int o = 0; o < NO; o++) {
+            out_row[o * out_plane + ox0] = activate(activation.type,
+                activation.a, activation.b, acc[o]);
+        }
+    }
+}
+
+template <int KH, int KW, int SH, int SW>
+void directConv(const float* input, const int inputHeight,
+    const int inputWidth, const int nInputPlane, const float* weights,
+    const float* biases, const int nOutputPlane, float* output,
+    const int outputHeight, const int outputWidth,
+    const Activation& activation) {
+    const int OB = DIRECT_CONV_OUT_BLOCK;
+    const int wstride = nInputPlane * KH * KW;
+    const int out_plane = outputHeight * outputWidth;
+
+    int o0 = 0;
+    for (; o0 + OB <= nOutputPlane; o0 += OB) {
+        for (int oy = 0; oy < outputHeight; oy++) {
+            convRow<KH, KW, SH, SW, OB>(input, inputHeight, inputWidth,
+                nInputPlane, weights + o0 * wstride, biases + o0,
+                output + o0 * out_plane, outputHeight, outputWidth, oy, activation);
+        }
+    }
+    for (; o0 < nOutputPlane; o0++) {
+        for (int oy = 0; oy < outputHeight; oy++) {
+            convRow<KH, KW, SH, SW, 1>(input, inputHeight, inputWidth,
+                nInputPlane, weights + o0 * wstride, biases + o0,
+                output + o0 * out_plane, outputHeight, outputWidth, oy, activation);
+        }
+    }
+}
+
+// Depthwise convolution of a padded input.  Output plane o filters input
+// plane o / multiplier with its own KH x KW filter, which is held in
+// registers for the whole plane while DEPTHWISE_CONV_WIDTH_BLOCK output
+// columns are computed at a time.
+template <int KH, int KW, int SH, int SW>
+void depthwiseConv(const float* input, const int inputHeight,
+    const int inputWidth, const float* weights, const float* biases,
+    const int nOutputPlane, const int multiplier, float* output,
+    const int outputHeight, const int outputWidth,
+    const Activation& activation) {
+    const int WB = DEPTHWISE_CONV_WIDTH_BLOCK;
+    const int NV = WB / VL;
+
+    for (int o = 0; o < nOutputPlane; o++) {
+        const float* in = input + (o / multiplier) * inputHeight * inputWidth;
+        float* out = output + o * outputHeight * outputWidth;
+        float w[KH * KW];
+        for (int i = 0; i < KH * KW; i++) {
+            w[i] = weights[o * KH * KW + i];
+        }
+        const float bias = biases[o];
+
+        for (int oy = 0; oy < outputHeight; oy++) {
+            const float* in_row = in + oy * SH * inputWidth;
+            float* out_row = out + oy * outputWidth;
+            int ox0 = 0;
+            for (; ox0 + WB <= outputWidth; ox0 += WB) {
+                vec acc[NV];
+                for (int v = 0; v < NV; v++) {
+                    acc[v] = Blas::simd::broadcast<vec>(bias);
+                }
+                for (int ky = 0; ky < KH; ky++) {
+                    for (int kx = 0; kx < KW; kx++) {
+                        const vec wv = Blas::simd::broadcast<vec>(w[ky * KW + kx]);
+                        for (int v = 0; v < NV; v++) {
+                            acc[v] += wv * loadColumns<SW>(in_row + ky * inputWidth +
+                                (ox0 + VL * v) * SW + kx);
+                        }
+                    }
+                }
+                for (int v = 0; v < NV; v++) {
+                    Blas::simd::store(out_row + ox0 + VL * v, acc[v]);
+                }
+                activate(activation.type, activation.a, activation.b,
+                    out_row + ox0, WB);
+            }
+            // Right edge (fewer than WB columns left)
+            for (; ox0 < outputWidth; ox0++) {
+                float acc = bias;
+                for (int ky = 0; ky < KH; ky++) {
+                    for (int kx = 0; kx < KW; kx++) {
+                        acc += w[ky * KW + kx] * in_row[ky * inputWidth + ox0 * SW + kx];
+                    }
+                }
+                out_row[ox0] = activate(activation.type, activation.a,
+                    activation.b, acc);
+            }
+        }
+    }
+}
+
+// Input transform of every (channel, tile): V[xi][c][t] = (B^T d B)[xi]
+template <int M, int A>
+void transformInput(const float* in, const int paddedHeight,
+    const int paddedWidth, const int channels, const int tilesH,
+    const int tilesW, const float* BT, float* V) {
+    const int tiles = tilesH * tilesW;
+    const int vstride = channels * tiles;
+    for (int c = 0; c < channels; c++) {
+        const float* plane = in + c * paddedHeight * paddedWidth;
+        for (int ty = 0; ty < tilesH; ty++) {
+            for (int tx = 0; tx < tilesW; tx++) {
+                const float* d = plane + (ty * M) * paddedWidth + tx * M;
+                float tmp[A][A];
+                for (int a = 0; a < A; a++) {
+                    for (int x = 0; x < A; x++) {
+                        float s = 0;
+                        for (int y = 0; y < A; y++) {
+                            s += BT[a * A + y] * d[y * paddedWidth + x];
+                        }
+                        tmp[a][x] = s;
+                    }
+                }
+                float* v = V + c * tiles + ty * tilesW + tx;
+                for (int a = 0; a < A; a++) {
+                    for (int b = 0; b < A; b++) {
+                        float s = 0;
+                        for (int x = 0; x < A; x++) {
+                            s += tmp[a][x] * BT[b * A + x];
+                        }
+                        v[(a * A + b) * vstride] = s;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Output transform: Y = act(A^T M A + bias) for every (plane, tile),
+// clipped at the bottom / right edge
+template <int M, int A>
+void transformOutput(const float* Mbuf, const int planes, const int tilesH,
+    const int tilesW, const float* AT, const float* biases, float* out,
+    const int outputHeight, const int outputWidth,
+    const Activation& activation) {
+    const int tiles = tilesH * tilesW;
+    const int mstride = planes * tiles;
+    for (int o = 0; o < planes; o++) {
+        float* plane = out + o * outputHeight * outputWidth;
+        for (int ty = 0; ty < tilesH; ty++) {
+            for (int tx = 0; tx < tilesW; tx++) {
+                const float* mp = Mbuf + o * tiles + ty * tilesW + tx;
+                float tmp[M][A];
+                for (int i = 0; i < M; i++) {
+                    for (int b = 0; b < A; b++) {
+                        float s = 0;
+                        for (int a = 0; a < A; a++) {
+                            s += AT[i * A + a] * mp[(a * A + b) * mstride];
+                        }
+                        tmp[i][b] = s;
+                    }
+                }
+                const int rows = minInt(M, outputHeight - ty * M);
+                const int cols = minInt(M, outputWidth - tx * M);
+                for (int i = 0; i < rows; i++) {
+                    float* dst = plane + (ty * M + i) * outputWidth + tx * M;
+                    for (int j = 0; j < cols; j++) {
+                        float s = biases[o];
+                        for (int b = 0; b < A; b++) {
+                            s += tmp[i][b] * AT[j * A + b];
+                        }
+                        dst[j] = activate(activation.type, activation.a,
+                            activation.b, s);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Columns of A, four at a time so y is loaded and stored once for every
+// four inputs.  Nothing here is blocked, so the vectors are the widest the
+// target has.
+void linear(const float* A, const size_t M, const float* x,
+    const uint32_t* nonzero, const size_t n, const float* biases,
+    const size_t i0, const size_t i1, float* y) {
+    using Blas::simd::floatv;
+    const uint32_t* j = nonzero;
+    for (size_t i = i0; i < i1; i++) {
+        y[i] = biases[i];
+    }
+    size_t c = 0;
+    for (; c + 4 <= n; c += 4) {
+        const float* a0 = A + j[c] * M;
+        const float* a1 = A + j[c + 1] * M;
+        const float* a2 = A + j[c + 2] * M;
+        const float* a3 = A + j[c + 3] * M;
+        const float x0 = x[j[c]];
+        const float x1 = x[j[c + 1]];
+        const float x2 = x[j[c + 2]];
+        const float x3 = x[j[c + 3]];
+        const floatv v0 = Blas::simd::broadcast<floatv>(x0);
+        const floatv v1 = Blas::simd::broadcast<floatv>(x1);
+        const floatv v2 = Blas::simd::broadcast<floatv>(x2);
+        const floatv v3 = Blas::simd::broadcast<floatv>(x3);
+        size_t i = i0;
+        for (; i + SIMD_LANES <= i1; i += SIMD_LANES) {
+            floatv acc = Blas::simd::load<floatv>(y + i);
+            acc += v0 * Blas::simd::load<floatv>(a0 + i);
+            acc += v1 * Blas::simd::load<floatv>(a1 + i);
+            acc += v2 * Blas::simd::load<floatv>(a2 + i);
+            acc += v3 * Blas::simd::load<floatv>(a3 + i);
+            Blas::simd::store(y + i, acc);
+        }
+        for (; i < i1; i++) {
+            y[i] += x0 * a0[i] + x1 * a1[i] + x2 * a2[i] + x3 * a3[i];
+        }
+    }
+    for (; c < n; c++) {
+        const float* a = A + j[c] * M;
+        const float xc = x[j[c]];
+        for (size_t i = i0; i < i1; i++) {
+            y[i] += xc * a[i];
+        }
+    }
+}
+
+DirectConvKernel directConvKernel(const uint32_t filt_height,
+    const uint32_t filt_width, const uint32_t dh, const uint32_t dw) {
+    if (filt_height != filt_width || dh != dw) {
+        return NULL;
+    }
+    if (dw == 1) {
+        switch (filt_width) {
+        case 3:
+            return &directConv<3, 3, 1, 1>;
+        case 5:
+            return &directConv<5, 5, 1, 1>;
+        case 7:
+            return &directConv<7, 7, 1, 1>;
+        default:
+            return NULL;
+        }
+    }
+    if (dw == 2) {
+        switch (filt_width) {
+        case 3:
+            return &directConv<3, 3, 2, 2>;
+        case 5:
+            return &directConv<5, 5, 2, 2>;
+        case 7:
+            return &directConv<7, 7, 2, 2>;
+        default:
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+DepthwiseConvKernel depthwiseConvKernel(const uint32_t filt_height,
+    const uint32_t filt_width, const uint32_t dh, const uint32_t dw) {
+    if (filt_height != filt_width || dh != dw) {
+        return NULL;
+    }
+    if (dw == 1) {
+        switch (filt_width) {
+        case 3:
+            return &depthwiseConv<3, 3, 1, 1>;
+        case 5:
+            return &depthwiseConv<5, 5, 1, 1>;
+        case 7:
+            return &depthwiseConv<7, 7, 1, 1>;
+        default:
+            return NULL;
+        }
+    }
+    if (dw == 2) {
+        switch (filt_width) {
+        case 3:
+            return &depthwiseConv<3, 3, 2, 2>;
+        case 5:
+            return &depthwiseConv<5, 5, 2, 2>;
+        case 7:
+            return &depthwiseConv<7, 7, 2, 2>;
+        default:
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+// F(2x2,3x3) (alpha 4), F(4x4,3x3) and F(2x2,5x5) (both alpha 6)
+WinogradInputKernel winogradInputKernel(const int m, const int alpha) {
+    if (m == 2 && alpha == 4) {
+        return &transformInput<2, 4>;
+    }
+    if (m == 4 && alpha == 6) {
+        return &transformInput<4, 6>;
+    }
+    if (m == 2 && alpha == 6) {
+        return &transformInput<2, 6>;
+    }
+    return NULL;
+}
+
+WinogradOutputKernel winogradOutputKernel(const int m, const int alpha) {
+    if (m == 2 && alpha == 4) {
+        return &transformOutput<2, 4>;
+    }
+    if (m == 4 && alpha == 6) {
+        return &transformOutput<4, 6>;
+    }
+    if (m == 2 && alpha == 6) {
+        return &transformOutput<2, 6>;
+    }
+    return NULL;
+}
+
+}  // unnamed namespace
+
+extern LayerKernels const table;
+LayerKernels const table = {
+    TORCH_STRINGIFY(TORCH_KERNELS_ISA),
+    TORCH_KERNELS_FEATURES,
+    activateArray,
+    directConvKernel,
+    depthwiseConvKernel,
+    winogradInputKernel,
+    winogradOutputKernel,
+    linear,
+};
+
+}  // namespace TORCH_KERNELS_ISA
+}  // namespace mtorch
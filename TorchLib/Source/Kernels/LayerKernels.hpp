@@ -0,0 +1,73 @@
+//
+//  LayerKernels.hpp
+//
+//  The inner loops of TorchLib's own layers (activations, direct and
+//  depthwise convolution, Winograd transforms, Linear), built once per instruction
+//  set level like BlasLibrary's Blas::Kernels (LayerKernels.cpp, see
+//  TorchLib.cmake).  The set in use is the one named like Blas::kernels(),
+//  so BLAS_ISA forces both libraries alike.
+//
+
+#pragma once
+
+#include <stddef.h>       // for size_t
+#include <cstdint>        // for uint32_t
+
+#include "Activation.hpp" // for Activation, ActivationType
+
+namespace mtorch {
+
+  // SpatialConvolutionDirect::Kernel
+  typedef void (*DirectConvKernel)(const float* input, const int inputHeight,
+    const int inputWidth, const int nInputPlane, const float* weights,
+    const float* biases, const int nOutputPlane, float* output,
+    const int outputHeight, const int outputWidth,
+    const Activation& activation);
+
+  // SpatialConvolutionGrouped::DepthwiseKernel
+  typedef void (*DepthwiseConvKernel)(const float* input, const int inputHeight,
+    const int inputWidth, const float* weights, const float* biases,
+    const int nOutputPlane, const int multiplier, float* output,
+    const int outputHeight, const int outputWidth,
+    const Activation& activation);
+
+  // SpatialConvolutionWinograd's input (V = B^T d B) and output
+  // (Y = act(A^T M A + bias)) transforms
+  typedef void (*WinogradInputKernel)(const float* in, const int paddedHeight,
+    const int paddedWidth, const int channels, const int tilesH,
+    const int tilesW, const float* BT, float* V);
+  typedef void (*WinogradOutputKernel)(const float* Mbuf, const int planes,
+    const int tilesH, const int tilesW, const float* AT, const float* biases,
+    float* out, const int outputHeight, const int outputWidth,
+    const Activation& activation);
+
+  // Linear::multiply: y[i] = biases[i] + sum over c < n of
+  // A[nonzero[c] * M + i] * x[nonzero[c]] for the rows i in [i0, i1), A being
+  // M x N column major
+  typedef void (*LinearKernel)(const float* A, const size_t M, const float* x,
+    const uint32_t* nonzero, const size_t n, const float* biases,
+    const size_t i0, const size_t i1, float* y);
+
+  struct LayerKernels {
+    char const * name;  // as Blas::Kernels::name
+    unsigned features;  // Blas::CpuFeature bits the set needs
+
+    // Activation::apply
+    void (*activate)(const ActivationType type, const float a, const float b,
+      float* data, const size_t n);
+
+    // The kernels specialized on filter size and stride (or Winograd tile m
+    // and transformed tile size alpha), NULL if there is none
+    DirectConvKernel (*directConv)(const uint32_t filt_height,
+      const uint32_t filt_width, const uint32_t dh, const uint32_t dw);
+    DepthwiseConvKernel (*depthwiseConv)(const uint32_t filt_height,
+      const uint32_t filt_width, const uint32_t dh, const uint32_t dw);
+    WinogradInputKernel (*winogradInput)(const int m, const int alpha);
+    WinogradOutputKernel (*winogradOutput)(const int m, const int alpha);
+
+    LinearKernel linear;
+  };
+
+  LayerKernels const & layerKernels();
+
+};  // namespace mtorch
@@ -1,9 +1,13 @@
 #include <math.h>         // for fabsf, floor, log10, pow
 #include <stddef.h>       // for NULL
+#include <algorithm>      // for min
 #include <stdexcept>      // for runtime_error
 
+#include "BlockSparse.hpp"  // for BlockSparseMatrix
+#include "Kernels/LayerKernels.hpp"  // for layerKernels
 #include "Linear.hpp"
 #include "Tensor.hpp"     // for Tensor, TO_TENSOR_PTR
+#include "ThreadPool.hpp" // for ThreadPool
 #include "TorchData.hpp"  // for TorchData, TorchDataType
 
 
@@ -23,11 +27,34 @@ namespace mtorch {
     uint32_t size_[2] = {n_outputs_, n_inputs_};
     weights_ = new Tensor<float>(2, size_);
     biases_ = new Tensor<float>(1, &n_outputs_);
+    nonzero_.reserve(n_inputs_);
+    threads_ = 1;
+    sparse_ = NULL;
+    packed_generation_ = 0;
   }
 
   Linear::~Linear() {
     SAFE_DELETE(weights_);
     SAFE_DELETE(biases_);
+    SAFE_DELETE(sparse_);
+  }
+
+  void Linear::parameters(std::vector<Tensor<float>*>& params) {
+    params.push_back(weights_);
+    params.push_back(biases_);
+  }
+
+  bool Linear::outputSize(const uint32_t in_dim, const uint32_t* in_size,
+    std::vector<uint32_t>& out_size) const {
+    if (in_dim != 1 || in_size[0] != n_inputs_) {
+      return false;
+    }
+    out_size.assign(1, n_outputs_);
+    return true;
+  }
+
+  void Linear::setNumThreads(const uint32_t threads) {
+    threads_ = threads == 0 ? 1 : threads;
   }
 
   void Linear::setWeights(const float* weights) {
@@ -62,21 +89,69 @@ namespace mtorch {
 
   void Linear::forwardProp(TorchData& input, TorchData** output) {
     init(input, output);
-	float* A = weights_->getData();
     float* X = ((Tensor<float>&)input).getData();
     Tensor<float>* Y = TO_TENSOR_PTR(*output);
-	uint32_t M = (uint32_t)n_outputs_;
-	uint32_t N = (uint32_t)n_inputs_;
-	// Perform the linear accumulation
-	for (uint32_t i = 0; i < M; i++) {
-		float sum = 0;
-		for (uint32_t k = 0; k < N; k++) {
-			sum += A[i + M * k] * X[k];
-		}
-		Y->setDataAt(sum, i);
-	}
-    // Now add in the bias
-	Tensor<float>::accumulate(*Y, *biases_);
+
+    if (packed_generation_ != weights_->generation()) {
+      packWeights();
+    }
+    if (sparse_ != NULL) {
+      sparse_->multiplyVector(X, biases_->getData(), Y->getData());
+      activation_.apply(Y->getData(), (size_t)n_outputs_);
+      return;
+    }
+
+    // Inputs behind a ReLU are mostly zero, and a zero input's column of A
+    // need not be read, so the work follows the measured density.  (A GEMM
+    // with a single column would also pack all of A on every call.)
+    nonzero_.clear();
+    for (uint32_t j = 0; j < n_inputs_; j++) {
+      if (X[j] != 0) {
+        nonzero_.push_back(j);
+      }
+    }
+    multiply(X, Y->getData());
+    activation_.apply(Y->getData(), (size_t)n_outputs_);
+  }
+
+  void Linear::multiply(const float* x, float* y) {
+    // Y = A * X + b, A is M x N column major.  Threads take blocks of rows
+    // (of whole cache lines of y) and all read the same nonzero columns.
+    const LinearKernel kernel = layerKernels().linear;
+    const float* A = weights_->getData();
+    const float* b = biases_->getData();
+    const size_t M = n_outputs_;
+    const size_t n = nonzero_.size();
+    const uint32_t* j = nonzero_.data();
+
+    Blas::ThreadPool& pool = Blas::ThreadPool::shared();
+    const size_t work = M * n;
+    const size_t threads = std::min<size_t>(std::min<size_t>(threads_,
+      pool.threads()), work / LINEAR_PARALLEL_MIN_WORK);
+    if (threads <= 1) {
+      kernel(A, M, x, j, n, b, 0, M, y);
+      return;
+    }
+    size_t block = (M + threads - 1) / threads;
+    block = (block + LINEAR_PARALLEL_ALIGN - 1) / LINEAR_PARALLEL_ALIGN *
+      LINEAR_PARALLEL_ALIGN;
+    pool.parallelFor((int)((M + block - 1) / block), (int)threads,
+      [&](const int task, const int) {
+      const size_t i0 = task * block;
+      kernel(A, M, x, j, n, b, i0, std::min(M, i0 + block), y);
+    });
+  }
+
+  void Linear::packWeights() {
+    // A is stored column major: element (i, j) is at A[j * M + i]
+    SAFE_DELETE(sparse_);
+    sparse_ = new Blas::BlockSparseMatrix();
+    sparse_->pack(weights_->getData(), (int)n_outputs_, (int)n_inputs_, 1,
+      (int)n_outputs_);
+    if (sparse_->density() * 100 > LINEAR_SPARSE_MAX_DENSITY) {
+      SAFE_DELETE(sparse_);
+    }
+    packed_generation_ = weights_->generation();
   }
 
   TorchStage * Linear::loadFromStream( InputStream & stream ) noexcept
@@ -6,11 +6,24 @@
 
 #pragma once
 
+#include "Activation.hpp"
 #include "TorchStage.hpp"
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
+// Weights with at most this percentage of nonzero 4x4 blocks (pruned
+// layers) are multiplied in block-sparse form
+#define LINEAR_SPARSE_MAX_DENSITY 50
+// Multiply-adds a dense product must have before its rows are split over
+// threads (setNumThreads), and the rows every thread starts at a multiple of
+#define LINEAR_PARALLEL_MIN_WORK (1 << 16)
+#define LINEAR_PARALLEL_ALIGN 16
+
+namespace Blas {
+class BlockSparseMatrix;
+}
 
 namespace mtorch {
 
@@ -26,6 +39,10 @@ class TorchData;
     virtual TorchStageType type() const { return LINEAR_STAGE; }
     virtual std::string name() const { return "Linear"; }
     virtual void forwardProp(TorchData& input, TorchData **output);
+    virtual void parameters(std::vector<Tensor<float>*>& params);
+    virtual bool outputSize(const uint32_t in_dim, const uint32_t* in_size,
+      std::vector<uint32_t>& out_size) const;
+    virtual void setNumThreads(const uint32_t threads);
 
     void setWeights(const float* weights);
     void setWeightsFromStream( InputStream & stream );
@@ -34,6 +51,10 @@ class TorchData;
     Tensor<float>* weights() { return weights_; }
     Tensor<float>* biases() { return biases_; }
 
+    // Activation applied to the output as it is written (none by default)
+    void setActivation(const Activation& activation) { activation_ = activation; }
+    const Activation& activation() const { return activation_; }
+
     static TorchStage* loadFromStream( InputStream & stream ) noexcept;
 
   protected:
@@ -42,8 +63,22 @@ class TorchData;
 
     Tensor<float>* weights_;  // n_outputs (rows) * n_inputs (columns), stored row major
     Tensor<float>* biases_;  // n_outputs
+    Activation activation_;
+    uint32_t threads_;  // Intra-op threads of the dense product
+    std::vector<uint32_t> nonzero_;  // Indices of the nonzero inputs
+    // Block-sparse weights, NULL if the weights are too dense.  Repacked
+    // on the next forwardProp whenever the generation of the weights tensor
+    // changes (setWeights, Tensor::setData / copy, ...); in-place writes
+    // through weights()->getData() must be followed by
+    // weights()->markModified().
+    Blas::BlockSparseMatrix* sparse_;
+    uint64_t packed_generation_;  // weights_ generation sparse_ was built from
 
     void init(TorchData& input, TorchData **output);
+    // y = A * x + b as a sum of the columns of A of the inputs in nonzero_
+    void multiply(const float* x, float* y);
+    // Builds sparse_ if the weights are sparse enough
+    void packWeights();
 
     // Non-copyable, non-assignable.
     Linear(Linear&);
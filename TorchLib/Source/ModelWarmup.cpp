@@ -0,0 +1,107 @@
+#include <stddef.h>       // for NULL
+#include <chrono>         // for steady_clock
+
+#if !defined(_WIN32) && !defined(__EMSCRIPTEN__)
+#include <sys/mman.h>     // for mlock
+#define MTORCH_HAS_MLOCK
+#endif
+
+#include "ModelWarmup.hpp"
+#include "Tensor.hpp"     // for Tensor
+#include "TorchData.hpp"  // for TorchData
+#include "TorchStage.hpp" // for TorchStage
+
+#define SAFE_DELETE(x) if (x != NULL) { delete x; x = NULL; }
+
+namespace mtorch {
+
+  namespace {
+
+    const size_t kPageSize = 4096;
+
+    // Reads one float per page so every page of the buffer is resident.
+    float touchPages(const float* data, size_t nelems) {
+      const volatile float* p = data;
+      const size_t step = kPageSize / sizeof(float);
+      float sink = 0;
+      for (size_t i = 0; i < nelems; i += step) {
+        sink += p[i];
+      }
+      if (nelems > 0) {
+        sink += p[nelems - 1];
+      }
+      return sink;
+    }
+
+  }  // unnamed namespace
+
+  ModelWarmup::ModelWarmup(TorchStage& model, const uint32_t input_dim,
+    const uint32_t* input_size, const WarmupOptions& options)
+    : ready_(false) {
+    std::vector<uint32_t> size(input_size, input_size + input_dim);
+    thread_ = std::thread([this, &model, size, options]() {
+      try {
+        report_ = ModelWarmup::run(model, (uint32_t)size.size(), size.data(),
+          options);
+      } catch (...) {
+        error_ = std::current_exception();
+      }
+      ready_.store(true, std::memory_order_release);
+    });
+  }
+
+  ModelWarmup::~ModelWarmup() {
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  WarmupReport ModelWarmup::wait() {
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+    return report_;
+  }
+
+  WarmupReport ModelWarmup::run(TorchStage& model, const uint32_t input_dim,
+    const uint32_t* input_size, const WarmupOptions& options) {
+    const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+    WarmupReport report;
+
+    // Pre-fault (and pin) the weights
+    std::vector<Tensor<float>*> params;
+    model.parameters(params);
+    volatile float sink = 0;
+    for (size_t i = 0; i < params.size(); i++) {
+      const size_t bytes = sizeof(float) * params[i]->nelems();
+      sink = sink + touchPages(params[i]->getData(), params[i]->nelems());
+      report.weight_bytes += bytes;
+#ifdef MTORCH_HAS_MLOCK
+      if (options.lock_memory && bytes > 0 &&
+          mlock(params[i]->getData(), bytes) == 0) {
+        report.locked_bytes += bytes;
+      }
+#endif
+    }
+
+    // Dummy passes: lazy static init, workspace allocation, cache warmup
+    for (uint32_t pass = 0; pass < options.passes; pass++) {
+      TorchData* input = new Tensor<float>(input_dim, input_size);
+      TorchData* output = NULL;
+      model.forwardProp(*input, &output);
+      if (!model.consumesInput()) {
+        SAFE_DELETE(input);
+      }
+      SAFE_DELETE(output);
+    }
+
+    report.seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+    return report;
+  }
+
+}  // namespace mtorch
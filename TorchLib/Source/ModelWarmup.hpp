@@ -0,0 +1,67 @@
+//
+//  ModelWarmup.hpp
+//
+//  Brings a freshly loaded model to steady state before the first real
+//  request: pre-faults (and optionally locks) the weight pages, then runs
+//  dummy passes at the expected input size.  The passes initialize the lazy
+//  GEMM dispatch tables, allocate the per-stage workspaces and warm the
+//  caches, so the first real forwardProp runs at steady-state latency.
+//
+//  Warmup can run synchronously (ModelWarmup::run) or on a background
+//  thread while the service reports not-ready (ModelWarmup instance +
+//  ready()).  The model must not be used by anyone else until ready().
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace mtorch {
+
+  class TorchStage;
+
+  struct WarmupOptions {
+    uint32_t passes = 2;  // Dummy forward passes after pre-faulting
+    bool lock_memory = false;  // mlock the weights (needs RLIMIT_MEMLOCK)
+  };
+
+  struct WarmupReport {
+    uint64_t weight_bytes = 0;
+    uint64_t locked_bytes = 0;  // < weight_bytes if mlock was refused
+    double seconds = 0;
+  };
+
+  class ModelWarmup {
+  public:
+    // Starts warming model on a background thread.  input_size has
+    // input_dim entries, with input_size[0] the contiguous dimension.
+    ModelWarmup(TorchStage& model, const uint32_t input_dim,
+      const uint32_t* input_size,
+      const WarmupOptions& options = WarmupOptions());
+    ~ModelWarmup();  // Joins the background thread
+
+    bool ready() const { return ready_.load(std::memory_order_acquire); }
+    // Blocks until warmup finished.  Rethrows any error it raised.
+    WarmupReport wait();
+
+    // Synchronous warmup on the calling thread.
+    static WarmupReport run(TorchStage& model, const uint32_t input_dim,
+      const uint32_t* input_size,
+      const WarmupOptions& options = WarmupOptions());
+
+  protected:
+    std::thread thread_;
+    std::atomic<bool> ready_;
+    WarmupReport report_;
+    std::exception_ptr error_;
+
+    // Non-copyable, non-assignable.
+    ModelWarmup(ModelWarmup&);
+    ModelWarmup& operator=(const ModelWarmup&);
+  };
+
+};  // namespace mtorch
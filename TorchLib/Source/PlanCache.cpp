@@ -0,0 +1,227 @@
+#include <stdio.h>        // for rename, remove, snprintf
+#include <cstring>        // for memcpy
+#include <fstream>        // for ofstream
+
+#include "CpuFeatures.hpp"  // for cpuFeatures
+#include "FileUtils.hpp"  // for fileReadToBuffer
+#include "PlanCache.hpp"
+#include "TorchStage.hpp" // for TorchStage
+
+namespace mtorch {
+
+  namespace {
+
+    const char kMagic[4] = {'M', 'P', 'L', 'N'};
+    // Bump whenever the plan contents or a stage's algorithm ids change
+    const uint32_t kVersion = 4;
+
+    uint64_t fnv1a(const uint8_t* data, size_t length,
+      uint64_t hash = 14695981039346656037ULL) {
+      for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+      }
+      return hash;
+    }
+
+    class Writer {
+    public:
+      std::vector<uint8_t> bytes;
+
+      template <typename V>
+      void put(const V& value) {
+        const uint8_t* p = (const uint8_t*)&value;
+        bytes.insert(bytes.end(), p, p + sizeof(V));
+      }
+
+      template <typename V>
+      void putArray(const std::vector<V>& values) {
+        put((uint64_t)values.size());
+        const uint8_t* p = (const uint8_t*)values.data();
+        bytes.insert(bytes.end(), p, p + sizeof(V) * values.size());
+      }
+    };
+
+    // Bounds checked reader: any overrun just marks the entry invalid
+    class Reader {
+    public:
+      Reader(const uint8_t* data, size_t length) :
+        data_(data), length_(length), pos_(0), ok_(true) {}
+
+      bool ok() const { return ok_; }
+      size_t pos() const { return pos_; }
+
+      template <typename V>
+      V get() {
+        V value = V();
+        if (ok_ && pos_ + sizeof(V) <= length_) {
+          memcpy(&value, data_ + pos_, sizeof(V));
+          pos_ += sizeof(V);
+        } else {
+          ok_ = false;
+        }
+        return value;
+      }
+
+      template <typename V>
+      void getArray(std::vector<V>& values) {
+        const uint64_t count = get<uint64_t>();
+        if (!ok_ || count > (length_ - pos_) / sizeof(V)) {
+          ok_ = false;
+          return;
+        }
+        values.resize((size_t)count);
+        memcpy(values.data(), data_ + pos_, sizeof(V) * values.size());
+        pos_ += sizeof(V) * values.size();
+      }
+
+    private:
+      const uint8_t* data_;
+      size_t length_;
+      size_t pos_;
+      bool ok_;
+    };
+
+    void putKey(Writer& w, const PlanKey& key) {
+      w.put(key.model_hash);
+      w.put(key.cpu_features);
+      w.putArray(key.in_size);
+    }
+
+  }  // unnamed namespace
+
+  PlanCache::PlanCache(const std::string& directory) : directory_(directory) {
+  }
+
+  PlanCache::~PlanCache() {
+  }
+
+  uint64_t PlanCache::fingerprint(const std::vector<uint8_t>& model_bytes) {
+    return fnv1a(model_bytes.data(), model_bytes.size());
+  }
+
+  PlanKey PlanCache::makeKey(const std::vector<uint8_t>& model_bytes,
+    const uint32_t in_dim, const uint32_t* in_size) {
+    PlanKey key;
+    key.model_hash = fingerprint(model_bytes);
+    key.cpu_features = Blas::cpuFeatures();
+    key.in_size.assign(in_size, in_size + in_dim);
+    return key;
+  }
+
+  std::string PlanCache::entryPath(const PlanKey& key) const {
+    Writer w;
+    putKey(w, key);
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.plan",
+      (unsigned long long)fnv1a(w.bytes.data(), w.bytes.size()));
+    return directory_ + "/" + name;
+  }
+
+  bool PlanCache::load(const PlanKey& key, ExecutionPlan& plan) const {
+    const std::string path = entryPath(key);
+    std::vector<uint8_t> buffer = FileUtils::fileReadToBuffer(path.c_str());
+    if (buffer.empty()) {
+      return false;
+    }
+    const size_t length = buffer.size() - 1;  // fileReadToBuffer adds a '\0'
+
+    bool valid = length > sizeof(kMagic) + sizeof(uint64_t) &&
+      memcmp(buffer.data(), kMagic, sizeof(kMagic)) == 0;
+    if (valid) {
+      uint64_t checksum;
+      memcpy(&checksum, buffer.data() + length - sizeof(checksum),
+        sizeof(checksum));
+      valid = checksum == fnv1a(buffer.data(), length - sizeof(checksum));
+    }
+
+    ExecutionPlan loaded;
+    if (valid) {
+      Reader r(buffer.data() + sizeof(kMagic),
+        length - sizeof(kMagic) - sizeof(uint64_t));
+      PlanKey stored;
+      const uint32_t version = r.get<uint32_t>();
+      stored.model_hash = r.get<uint64_t>();
+      stored.cpu_features = r.get<uint32_t>();
+      r.getArray(stored.in_size);
+      loaded.workspace_bytes = r.get<uint64_t>();
+      const uint32_t num_stages = r.get<uint32_t>();
+      valid = r.ok() && version == kVersion && stored == key;
+      for (uint32_t i = 0; valid && i < num_stages; i++) {
+        StagePlan sp;
+        sp.type = r.get<uint32_t>();
+        sp.algorithm = r.get<uint32_t>();
+        r.getArray(sp.in_size);
+        r.getArray(sp.out_size);
+        sp.workspace_bytes = r.get<uint64_t>();
+        valid = r.ok();
+        loaded.stages.push_back(sp);
+      }
+    }
+
+    if (!valid) {
+      remove(path.c_str());
+      return false;
+    }
+    plan = loaded;
+    return true;
+  }
+
+  bool PlanCache::store(const PlanKey& key, const ExecutionPlan& plan) const {
+    Writer w;
+    w.bytes.insert(w.bytes.end(), kMagic, kMagic + sizeof(kMagic));
+    w.put(kVersion);
+    putKey(w, key);
+    w.put(plan.workspace_bytes);
+    w.put((uint32_t)plan.stages.size());
+    for (size_t i = 0; i < plan.stages.size(); i++) {
+      const StagePlan& sp = plan.stages[i];
+      w.put(sp.type);
+      w.put(sp.algorithm);
+      w.putArray(sp.in_size);
+      w.putArray(sp.out_size);
+      w.put(sp.workspace_bytes);
+    }
+    w.put(fnv1a(w.bytes.data(), w.bytes.size()));
+
+    const std::string path = entryPath(key);
+    const std::string tmp = path + ".tmp";
+    {
+      std::ofstream ofile(tmp.c_str(), std::ios::out | std::ios::binary);
+      if (!ofile.is_open()) {
+        return false;
+      }
+      ofile.write((const char*)w.bytes.data(), (std::streamsize)w.bytes.size());
+      if (!ofile.good()) {
+        ofile.close();
+        remove(tmp.c_str());
+        return false;
+      }
+    }
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+      remove(tmp.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  ExecutionPlan PlanCache::prepare(const std::vector<uint8_t>& model_bytes,
+    TorchStage& model, const uint32_t in_dim, const uint32_t* in_size,
+    bool* hit) const {
+    const PlanKey key = makeKey(model_bytes, in_dim, in_size);
+    ExecutionPlan plan;
+    if (load(key, plan) && ExecutionPlanner::apply(model, plan)) {
+      if (hit != nullptr) {
+        *hit = true;
+      }
+      return plan;
+    }
+    if (hit != nullptr) {
+      *hit = false;
+    }
+    plan = ExecutionPlanner::build(model, in_dim, in_size);
+    store(key, plan);
+    return plan;
+  }
+
+}  // namespace mtorch
@@ -0,0 +1,67 @@
+//
+//  PlanCache.hpp
+//
+//  On-disk cache of ExecutionPlans.  Entries are keyed by a fingerprint of
+//  the model bytes, the input size and the detected CPU features, so a
+//  restart on the same host skips planning (and autotuning) entirely.
+//
+//  The full key is stored inside every entry together with a checksum of
+//  the payload.  A truncated, corrupt, stale or colliding entry is never
+//  applied: it is deleted and the plan is rebuilt.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ExecutionPlan.hpp"
+
+namespace mtorch {
+
+  class TorchStage;
+
+  struct PlanKey {
+    uint64_t model_hash;
+    uint32_t cpu_features;
+    std::vector<uint32_t> in_size;
+
+    bool operator==(const PlanKey& other) const {
+      return model_hash == other.model_hash &&
+        cpu_features == other.cpu_features && in_size == other.in_size;
+    }
+  };
+
+  class PlanCache {
+  public:
+    explicit PlanCache(const std::string& directory);
+    ~PlanCache();
+
+    static uint64_t fingerprint(const std::vector<uint8_t>& model_bytes);
+    static PlanKey makeKey(const std::vector<uint8_t>& model_bytes,
+      const uint32_t in_dim, const uint32_t* in_size);
+
+    // Returns false if there is no valid entry for key.
+    bool load(const PlanKey& key, ExecutionPlan& plan) const;
+    // Writes atomically (temporary file + rename).  Returns false on I/O
+    // errors; the cache is an optimization, so failures are not fatal.
+    bool store(const PlanKey& key, const ExecutionPlan& plan) const;
+
+    // Loads and applies the cached plan for model, or builds, applies and
+    // stores a new one.  Sets *hit (if not NULL) when the cache was used.
+    ExecutionPlan prepare(const std::vector<uint8_t>& model_bytes,
+      TorchStage& model, const uint32_t in_dim, const uint32_t* in_size,
+      bool* hit = nullptr) const;
+
+    std::string entryPath(const PlanKey& key) const;
+
+  protected:
+    std::string directory_;
+
+    // Non-copyable, non-assignable.
+    PlanCache(PlanCache&);
+    PlanCache& operator=(const PlanCache&);
+  };
+
+};  // namespace mtorch
@@ -45,6 +45,12 @@ namespace mtorch {
 	}
   }
 
+  bool Threshold::outputSize(const uint32_t in_dim, const uint32_t* in_size,
+    std::vector<uint32_t>& out_size) const {
+    out_size.assign(in_size, in_size + in_dim);
+    return true;
+  }
+
   TorchStage* Threshold::loadFromStream( InputStream & stream ) noexcept
   {
     Threshold* ret = new Threshold();
@@ -22,6 +22,8 @@ class TorchData;
     virtual TorchStageType type() const { return THRESHOLD_STAGE; }
     virtual std::string name() const { return "Threshold"; }
     virtual void forwardProp(TorchData& input, TorchData **output);
+    virtual bool outputSize(const uint32_t in_dim, const uint32_t* in_size,
+      std::vector<uint32_t>& out_size) const;
 
     float threshold;  // Single threshold value
     float val;  // Single output value (when input < threshold)
@@ -56,6 +56,19 @@ namespace mtorch {
     // same storage as the input.
   }
 
+  bool Reshape::outputSize(const uint32_t in_dim, const uint32_t* in_size,
+    std::vector<uint32_t>& out_size) const {
+    uint32_t nelems = 1;
+    for (uint32_t i = 0; i < in_dim; i++) {
+      nelems *= in_size[i];
+    }
+    if (nelems != outNElem()) {
+      return false;
+    }
+    out_size.assign(osize_, osize_ + odim_);
+    return true;
+  }
+
   TorchStage* Reshape::loadFromStream( InputStream & stream ) noexcept
   {
     uint32_t dim = stream.read< uint32_t >();
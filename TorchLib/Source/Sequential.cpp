@@ -3,6 +3,12 @@
 #include <ostream>                  // for istream, stringstream, operator<<, basic_ostream
 #include <stdexcept>                // for runtime_error
 
+#include "DepthFirst.hpp"           // for DepthFirst
+#include "Linear.hpp"               // for Linear
+#include "ReLU.hpp"                 // for Threshold
+#include "SpatialConvolution.hpp"   // for SpatialConvolution
+#include "SpatialConvolutionSeparable.hpp"  // for SpatialConvolutionSeparable
+#include "SpatialMaxPooling.hpp"    // for SpatialMaxPooling
 #include "Tensor.hpp"               // for Tensor
 #include "TorchData.hpp"            // for TorchData
 #include "Utils/VectorManaged.hpp"  // for VectorManaged
@@ -20,6 +26,8 @@ namespace mtorch {
     // Create an empty container
     network_ = new data_str::VectorManaged<TorchStage*>(1);
     network_type_ = UNDEFINED;
+    tile_bytes_ = 0;
+    recompute_ = DEPTH_FIRST_MAX_RECOMPUTE;
   }
 
   Sequential::~Sequential() {
@@ -46,6 +54,130 @@ namespace mtorch {
       return labels_;
   }
 
+  void Sequential::parameters(std::vector<Tensor<float>*>& params) {
+    for (uint32_t i = 0; i < network_->size(); i++) {
+      (*network_)[i]->parameters(params);
+    }
+  }
+
+  bool Sequential::outputSize(const uint32_t in_dim, const uint32_t* in_size,
+    std::vector<uint32_t>& out_size) const {
+    out_size.assign(in_size, in_size + in_dim);
+    for (uint32_t i = 0; i < network_->size(); i++) {
+      std::vector<uint32_t> cur(out_size);
+      if (!(*network_)[i]->outputSize((uint32_t)cur.size(), cur.data(),
+          out_size)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void Sequential::setNumThreads(const uint32_t threads) {
+    for (uint32_t i = 0; i < network_->size(); i++) {
+      (*network_)[i]->setNumThreads(threads);
+    }
+  }
+
+  void Sequential::setDepthFirst(const uint64_t tile_bytes,
+    const uint32_t recompute) {
+    tile_bytes_ = tile_bytes;
+    recompute_ = recompute;
+    for (uint32_t i = 0; i < network_->size(); i++) {
+      if ((*network_)[i]->type() == SEQUENTIAL_STAGE) {
+        ((Sequential*)(*network_)[i])->setDepthFirst(tile_bytes, recompute);
+      }
+    }
+  }
+
+  uint32_t Sequential::fuseActivations() {
+    uint32_t fused = 0;
+    for (uint32_t i = 0; i < network_->size(); i++) {
+      TorchStage* stage = (*network_)[i];
+      if (stage->type() == SEQUENTIAL_STAGE) {
+        fused += ((Sequential*)stage)->fuseActivations();
+        continue;
+      }
+      if (i + 1 >= network_->size()) {
+        break;
+      }
+      TorchStage* next = (*network_)[i + 1];
+      Activation activation;
+      if (next->type() == THRESHOLD_STAGE) {
+        activation = Activation::threshold(((Threshold*)next)->threshold,
+          ((Threshold*)next)->val);
+      } else if (next->type() == TANH_STAGE) {
+        activation = Activation::tanh();
+      } else {
+        continue;
+      }
+      if ((stage->type() == SPATIAL_CONVOLUTION_STAGE ||
+           stage->type() == SPATIAL_CONVOLUTION_GROUPED_STAGE) &&
+          ((SpatialConvolution*)stage)->activation().none() &&
+          (!((SpatialConvolution*)stage)->pooled() || activation.monotonic())) {
+        ((SpatialConvolution*)stage)->setActivation(activation);
+      } else if (stage->type() == LINEAR_STAGE &&
+          ((Linear*)stage)->activation().none()) {
+        ((Linear*)stage)->setActivation(activation);
+      } else {
+        continue;
+      }
+      network_->deleteAtAndShift(i + 1);
+      fused++;
+    }
+    return fused;
+  }
+
+  uint32_t Sequential::fusePooling() {
+    uint32_t fused = 0;
+    for (uint32_t i = 0; i < network_->size(); i++) {
+      TorchStage* stage = (*network_)[i];
+      if (stage->type() == SEQUENTIAL_STAGE) {
+        fused += ((Sequential*)stage)->fusePooling();
+        continue;
+      }
+      if (i + 1 >= network_->size()) {
+        break;
+      }
+      TorchStage* next = (*network_)[i + 1];
+      if (next->type() != SPATIAL_MAX_POOLING_STAGE ||
+          (stage->type() != SPATIAL_CONVOLUTION_STAGE &&
+           stage->type() != SPATIAL_CONVOLUTION_GROUPED_STAGE) ||
+          ((SpatialConvolution*)stage)->pooled()) {
+        continue;
+      }
+      ((SpatialConvolution*)stage)->setPooling(
+        ((SpatialMaxPooling*)next)->poolW(), ((SpatialMaxPooling*)next)->poolH());
+      network_->deleteAtAndShift(i + 1);
+      fused++;
+    }
+    return fused;
+  }
+
+  uint32_t Sequential::separateFilters(const float tolerance) {
+    uint32_t separated = 0;
+    for (uint32_t i = 0; i < network_->size(); i++) {
+      TorchStage* stage = (*network_)[i];
+      if (stage->type() == SEQUENTIAL_STAGE) {
+        separated += ((Sequential*)stage)->separateFilters(tolerance);
+        continue;
+      }
+      if (stage->type() != SPATIAL_CONVOLUTION_STAGE ||
+          stage->name() == "SpatialConvolutionSeparable") {
+        continue;
+      }
+      SpatialConvolutionSeparable* separable =
+        SpatialConvolutionSeparable::decompose(*(SpatialConvolution*)stage,
+        tolerance);
+      if (separable != NULL) {
+        network_->deleteAt(i);
+        network_->set(i, separable);
+        separated++;
+      }
+    }
+    return separated;
+  }
+
   Sequential* Sequential::loadFromStream( InputStream & stream ) noexcept
   {
 
@@ -73,6 +205,9 @@ namespace mtorch {
     for (int32_t i = 0; i < n_nodes; i++) {
       ret->network_->pushBack(TorchStage::loadFromStream(stream));
     }
+    ret->fuseActivations();
+    ret->fusePooling();
+    ret->fuseActivations();
     return ret;
   }
 
@@ -84,16 +219,28 @@ namespace mtorch {
     }
     TorchData* data1 = &input;
     TorchData* data2 = NULL;
-    (*network_)[0]->forwardProp(*data1, &data2);
-    for (uint32_t i = 1; i < network_->size(); i++) {
+    std::vector<TorchStage*> chain;
+    for (uint32_t i = 0; i < network_->size(); i++) {
+      // Depth-first: gather the run of tileable stages starting here
+      chain.clear();
+      if (tile_bytes_ != 0 && data1->type() == TorchDataType::TENSOR_DATA &&
+          ((Tensor<float>*)data1)->dim() == 3) {
+        for (uint32_t j = i; j < network_->size() &&
+            DepthFirst::tileable(*(*network_)[j]); j++) {
+          chain.push_back((*network_)[j]);
+        }
+      }
+      if (chain.size() >= 2) {
+        DepthFirst::forwardProp(chain, *data1, &data2, tile_bytes_,
+          recompute_);
+        i += (uint32_t)chain.size() - 1;
+      } else {
+        (*network_)[i]->forwardProp(*data1, &data2);
+      }
       SAFE_DELETE(data1);
       data1 = data2;
-      (*network_)[i]->forwardProp(*data1, &data2);
     }
-    SAFE_DELETE(data1);
-    *output = data2;
-
-
+    *output = data1;
   }
 
   void Sequential::forwardProp(std::vector<float> &image_data, int image_dim, TorchData** output)
@@ -9,6 +9,7 @@
 #include <string>          // for string, istream
 #include <vector>          // for vector
 
+#include "DepthFirst.hpp"  // for DEPTH_FIRST_MAX_RECOMPUTE
 #include "TorchStage.hpp"  // for ::SEQUENTIAL_STAGE, TorchStage, TorchStageType
 
 namespace data_str {
@@ -18,6 +19,7 @@ template <typename T> class VectorManaged;
 namespace mtorch {
 
 class TorchData;
+  template <typename T> class Tensor;
 
   typedef enum {
      UNDEFINED = -1,
@@ -35,13 +37,52 @@ class TorchData;
     virtual NetworkType network_type() const;
     virtual std::string name() const { return "Sequential"; }
     virtual void forwardProp(TorchData& input, TorchData **output);
+    virtual bool consumesInput() const { return true; }
     void forwardProp(std::vector<float> &image_data, int image_dim, TorchData **output);
+    virtual void parameters(std::vector<Tensor<float>*>& params);
+    virtual bool outputSize(const uint32_t in_dim, const uint32_t* in_size,
+      std::vector<uint32_t>& out_size) const;
+    virtual void setNumThreads(const uint32_t threads);
     std::vector<int> labels();
 
+    // Depth-first execution: runs of consecutive convolution, pooling and
+    // pointwise stages are computed one output tile at a time (see
+    // DepthFirst.hpp), with tiles whose intermediates take at most
+    // tile_bytes, unless the recomputed halos would add more than
+    // recompute percent of work.  tile_bytes 0 (the default) runs one stage
+    // at a time.  Also sets nested Sequential stages.
+    void setDepthFirst(const uint64_t tile_bytes,
+      const uint32_t recompute = DEPTH_FIRST_MAX_RECOMPUTE);
+
     void add(TorchStage* stage);
     TorchStage* get(const uint32_t i);
     uint32_t size() const;
 
+    // Graph pass: folds every Threshold / Tanh stage that directly follows a
+    // SpatialConvolution or Linear stage into that stage's fused activation
+    // and removes it (also in nested Sequential stages).  Returns the number
+    // of stages removed.  loadFromStream runs it on every loaded model.
+    // Activations that commute with max pooling are also folded into
+    // convolutions that already pool.
+    uint32_t fuseActivations();
+
+    // Graph pass: folds every SpatialMaxPooling stage that directly follows
+    // a SpatialConvolution into that stage (see
+    // SpatialConvolution::setPooling), so the full resolution convolution
+    // output is never written out, and removes it (also in nested
+    // Sequential stages).  Returns the number of stages removed.
+    // loadFromStream runs it on every loaded model, between two
+    // fuseActivations passes so conv -> pool -> ReLU chains fuse as well.
+    uint32_t fusePooling();
+
+    // Optional graph pass: replaces every SpatialConvolution whose filter
+    // slices all have a low-rank approximation within tolerance (relative
+    // Frobenius error) by a SpatialConvolutionSeparable, if that saves
+    // enough work (also in nested Sequential stages).  The outputs change by
+    // up to the approximation error, so it is not run on load.  Returns the
+    // number of stages replaced.
+    uint32_t separateFilters(const float tolerance);
+
 
     static Sequential* loadFromStream( InputStream & stream ) noexcept;
 
@@ -49,6 +90,8 @@ class TorchData;
     data_str::VectorManaged<TorchStage*>* network_;
     NetworkType network_type_;
     std::vector<int> labels_;
+    uint64_t tile_bytes_;  // Depth-first tile size, 0 if disabled
+    uint32_t recompute_;
     // Non-copyable, non-assignable.
     Sequential(Sequential&);
     Sequential& operator=(const Sequential&);
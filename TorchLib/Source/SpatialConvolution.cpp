@@ -1,9 +1,104 @@
+#include <math.h>         // for INFINITY
+#include <algorithm>      // for max
+#include <stdexcept>      // for runtime_error
+
 #include "SpatialConvolution.hpp"
+#include "Tensor.hpp"     // for Tensor, TO_TENSOR_PTR
 
 namespace mtorch {
 
-SpatialConvolution::SpatialConvolution() {}
+SpatialConvolution::SpatialConvolution() : dw_(1), dh_(1), threads_(1),
+  poolw_(1), poolh_(1) {}
 
 SpatialConvolution::~SpatialConvolution() {}
 
+void SpatialConvolution::parameters(std::vector<Tensor<float>*>& params) {
+    params.push_back(weights());
+    params.push_back(biases());
+}
+
+void SpatialConvolution::setNumThreads(const uint32_t threads) {
+    threads_ = threads == 0 ? 1 : threads;
+}
+
+void SpatialConvolution::setPooling(const uint32_t pool_w,
+    const uint32_t pool_h) {
+    if (pool_w == 0 || pool_h == 0) {
+      throw std::runtime_error("SpatialConvolution::setPooling() - ERROR: "
+        "empty pooling window!");
+    }
+    poolw_ = pool_w;
+    poolh_ = pool_h;
+}
+
+bool SpatialConvolution::convOutputSize(const uint32_t in_dim,
+    const uint32_t* in_size, std::vector<uint32_t>& out_size) const {
+    if (in_dim != 3 || in_size[2] != feats_in_ ||
+        in_size[0] + 2 * padw_ < filt_width_ ||
+        in_size[1] + 2 * padh_ < filt_height_) {
+        return false;
+    }
+    out_size.resize(3);
+    out_size[0] = (in_size[0] + 2 * padw_ - filt_width_) / dw_ + 1;
+    out_size[1] = (in_size[1] + 2 * padh_ - filt_height_) / dh_ + 1;
+    out_size[2] = feats_out_;
+    return true;
+}
+
+bool SpatialConvolution::outputSize(const uint32_t in_dim,
+    const uint32_t* in_size, std::vector<uint32_t>& out_size) const {
+    if (!convOutputSize(in_dim, in_size, out_size) ||
+        out_size[0] % poolw_ != 0 || out_size[1] % poolh_ != 0) {
+        return false;
+    }
+    out_size[0] /= poolw_;
+    out_size[1] /= poolh_;
+    return true;
+}
+
+void SpatialConvolution::maxPool(const float* in, const int planes,
+    const int height, const int width, const size_t in_plane, float* out,
+    const size_t out_plane) const {
+    const int pw = (int) poolw_;
+    const int ph = (int) poolh_;
+    const int pooledWidth = width / pw;
+    for (int p = 0; p < planes; p++) {
+      for (int py = 0; py < height / ph; py++) {
+        const float* window = in + p * in_plane + (size_t) py * ph * width;
+        float* out_row = out + p * out_plane + (size_t) py * pooledWidth;
+        for (int px = 0; px < pooledWidth; px++) {
+          float val = -INFINITY;
+          for (int y = 0; y < ph; y++) {
+            for (int x = 0; x < pw; x++) {
+              val = std::max(val, window[y * width + px * pw + x]);
+            }
+          }
+          out_row[px] = val;
+        }
+      }
+    }
+}
+
+void SpatialConvolution::poolOutput(TorchData** output) const {
+    Tensor<float>* full = TO_TENSOR_PTR(*output);
+    const uint32_t width = full->size()[0];
+    const uint32_t height = full->size()[1];
+    if (width % poolw_ != 0 || height % poolh_ != 0) {
+      delete full;
+      *output = NULL;
+      throw std::runtime_error("SpatialConvolution::poolOutput() - ERROR: "
+        "width or height is not a multiple of the poolsize!");
+    }
+    uint32_t out_dim[3];
+    out_dim[0] = width / poolw_;
+    out_dim[1] = height / poolh_;
+    out_dim[2] = full->size()[2];
+    Tensor<float>* pooled = new Tensor<float>(3, out_dim);
+    maxPool(full->getData(), (int) out_dim[2], (int) height, (int) width,
+      (size_t) width * height, pooled->getData(),
+      (size_t) out_dim[0] * out_dim[1]);
+    delete full;
+    *output = pooled;
+}
+
 }
@@ -6,10 +6,12 @@
 
 #pragma once
 
+#include "Activation.hpp"
 #include "TorchStage.hpp"
 #include "TorchData.hpp"
 
 #include <string>
+#include <cstddef>
 #include <cstdint>
 
 namespace mtorch {
@@ -31,6 +33,32 @@ namespace mtorch {
     virtual void setBiasesFromStream( InputStream & ) = 0;
     virtual Tensor<float>* weights() = 0;
     virtual Tensor<float>* biases() = 0;
+    virtual void parameters(std::vector<Tensor<float>*>& params);
+    virtual bool outputSize(const uint32_t in_dim, const uint32_t* in_size,
+      std::vector<uint32_t>& out_size) const;
+    virtual void setNumThreads(const uint32_t threads);
+
+    // Activation applied to the output as it is written (none by default)
+    void setActivation(const Activation& activation) { activation_ = activation; }
+    const Activation& activation() const { return activation_; }
+
+    // Max pooling over non-overlapping pool_w x pool_h windows (as
+    // SpatialMaxPooling) applied to the activated output before it is
+    // stored.  The output size shrinks accordingly; 1 x 1 disables it.
+    void setPooling(const uint32_t pool_w, const uint32_t pool_h);
+    bool pooled() const { return poolw_ != 1 || poolh_ != 1; }
+    uint32_t poolW() const { return poolw_; }
+    uint32_t poolH() const { return poolh_; }
+
+    uint32_t featsIn() const { return feats_in_; }
+    uint32_t featsOut() const { return feats_out_; }
+    uint32_t filtWidth() const { return filt_width_; }
+    uint32_t filtHeight() const { return filt_height_; }
+    uint32_t padW() const { return padw_; }
+    uint32_t padH() const { return padh_; }
+    uint32_t strideW() const { return dw_; }
+    uint32_t strideH() const { return dh_; }
+    uint32_t numThreads() const { return threads_; }
 
   protected:
     uint32_t filt_width_;
@@ -39,10 +67,28 @@ namespace mtorch {
     uint32_t feats_out_;
     uint32_t padw_;
     uint32_t padh_;
+    uint32_t dw_;  // Stride
+    uint32_t dh_;
+    uint32_t threads_;  // Intra-op threads, only used by some implementations
+    Activation activation_;
+    uint32_t poolw_;
+    uint32_t poolh_;
 
     Tensor<float>* weights_;
     Tensor<float>* biases_;
 
+    // Output size before pooling
+    bool convOutputSize(const uint32_t in_dim, const uint32_t* in_size,
+      std::vector<uint32_t>& out_size) const;
+    // out[p][y][x] = max of the pooling window of in[p] (height x width
+    // values, planes in_plane resp. out_plane apart)
+    void maxPool(const float* in, const int planes, const int height,
+      const int width, const size_t in_plane, float* out,
+      const size_t out_plane) const;
+    // Replaces *output by its pooled version, for implementations that
+    // compute the full resolution output first
+    void poolOutput(TorchData** output) const;
+
     // Non-copyable, non-assignable.
     SpatialConvolution(SpatialConvolution&);
     SpatialConvolution& operator=(const SpatialConvolution&);
@@ -0,0 +1,288 @@
+#include <stddef.h>       // for NULL
+#include <algorithm>      // for equal, min
+#include <chrono>         // for steady_clock
+#include <limits>         // for numeric_limits
+#include <stdexcept>      // for runtime_error
+
+#include "SpatialConvolutionAuto.hpp"
+#include "SpatialConvolutionFactory.hpp"
+#include "Tensor.hpp"     // for Tensor
+#include "TorchData.hpp"  // for TorchData, TorchDataType
+
+#define SAFE_DELETE(x) if (x != NULL) { delete x; x = NULL; }
+#define SAFE_DELETE_ARR(x) if (x != NULL) { delete[] x; x = NULL; }
+
+
+namespace mtorch {
+
+SpatialConvolutionAuto::SpatialConvolutionAuto(const uint32_t feats_in,
+    const uint32_t feats_out, const uint32_t filt_height,
+    const uint32_t filt_width, const uint32_t padw, const uint32_t padh,
+    const uint32_t dw, const uint32_t dh) :
+    impls_(CONV_ALGORITHM_COUNT, NULL), autotune_(false) {
+
+    filt_width_ = filt_width;
+    filt_height_ = filt_height;
+    feats_in_ = feats_in;
+    feats_out_ = feats_out;
+    padw_ = padw;
+    padh_ = padh;
+    dw_ = dw;
+    dh_ = dh;
+
+    // The parameters live in the candidates
+    weights_ = NULL;
+    biases_ = NULL;
+
+    impl(SpatialConvolutionFactory::heuristic(feats_in_, feats_out_,
+      filt_height_, filt_width_, dw_, dh_));
+}
+
+SpatialConvolutionAuto::~SpatialConvolutionAuto() {
+    for (size_t i = 0; i < impls_.size(); i++) {
+      SAFE_DELETE(impls_[i]);
+    }
+}
+
+SpatialConvolution* SpatialConvolutionAuto::anyImpl() const {
+    for (size_t i = 0; i < impls_.size(); i++) {
+      if (impls_[i] != NULL) {
+        return impls_[i];
+      }
+    }
+    return NULL;
+}
+
+SpatialConvolution* SpatialConvolutionAuto::impl(const uint32_t algorithm) {
+    if (impls_[algorithm] != NULL) {
+      return impls_[algorithm];
+    }
+    SpatialConvolution* conv = SpatialConvolutionFactory::createAlgorithm(
+      algorithm, feats_in_, feats_out_, filt_height_, filt_width_, padw_,
+      padh_, dw_, dh_);
+    if (conv == NULL) {
+      throw std::runtime_error("SpatialConvolutionAuto::impl() - ERROR: "
+        "algorithm not supported!");
+    }
+    // Copy the parameters of an existing candidate
+    SpatialConvolution* from = anyImpl();
+    if (from != NULL) {
+      conv->setWeights(from->weights()->getData());
+      conv->setBiases(from->biases()->getData());
+    }
+    conv->setNumThreads(threads_);
+    conv->setPooling(poolw_, poolh_);
+    impls_[algorithm] = conv;
+    return conv;
+}
+
+void SpatialConvolutionAuto::setWeights(const float* weights) {
+    for (size_t i = 0; i < impls_.size(); i++) {
+      if (impls_[i] != NULL) {
+        impls_[i]->setWeights(weights);
+      }
+    }
+}
+
+void SpatialConvolutionAuto::setBiases(const float* biases) {
+    for (size_t i = 0; i < impls_.size(); i++) {
+      if (impls_[i] != NULL) {
+        impls_[i]->setBiases(biases);
+      }
+    }
+}
+
+void SpatialConvolutionAuto::setWeightsFromStream( InputStream & stream )
+{
+    SpatialConvolution* conv = anyImpl();
+    conv->setWeightsFromStream( stream );
+    for (size_t i = 0; i < impls_.size(); i++) {
+      if (impls_[i] != NULL && impls_[i] != conv) {
+        impls_[i]->setWeights(conv->weights()->getData());
+      }
+    }
+}
+
+void SpatialConvolutionAuto::setBiasesFromStream( InputStream & stream )
+{
+    SpatialConvolution* conv = anyImpl();
+    conv->setBiasesFromStream( stream );
+    for (size_t i = 0; i < impls_.size(); i++) {
+      if (impls_[i] != NULL && impls_[i] != conv) {
+        impls_[i]->setBiases(conv->biases()->getData());
+      }
+    }
+}
+
+Tensor<float>* SpatialConvolutionAuto::weights() {
+    return anyImpl()->weights();
+}
+
+Tensor<float>* SpatialConvolutionAuto::biases() {
+    return anyImpl()->biases();
+}
+
+void SpatialConvolutionAuto::setNumThreads(const uint32_t threads) {
+    SpatialConvolution::setNumThreads(threads);
+    for (size_t i = 0; i < impls_.size(); i++) {
+      if (impls_[i] != NULL) {
+        impls_[i]->setNumThreads(threads_);
+      }
+    }
+}
+
+const SpatialConvolutionAuto::Choice* SpatialConvolutionAuto::find(
+    const uint32_t in_dim, const uint32_t* in_size) const {
+    for (size_t i = 0; i < choices_.size(); i++) {
+      const std::vector<uint32_t>& size = choices_[i].in_size;
+      if (size.size() == in_dim &&
+          std::equal(size.begin(), size.end(), in_size)) {
+        return &choices_[i];
+      }
+    }
+    return NULL;
+}
+
+uint32_t SpatialConvolutionAuto::algorithm(const uint32_t in_dim,
+    const uint32_t* in_size) const {
+    const Choice* choice = find(in_dim, in_size);
+    if (choice != NULL) {
+      return choice->algorithm;
+    }
+    return SpatialConvolutionFactory::heuristic(feats_in_, feats_out_,
+      filt_height_, filt_width_, dw_, dh_);
+}
+
+void SpatialConvolutionAuto::choose(const uint32_t in_dim,
+    const uint32_t* in_size, const uint32_t algorithm) {
+    impl(algorithm);
+    Choice* choice = (Choice*)find(in_dim, in_size);
+    if (choice != NULL) {
+      choice->algorithm = algorithm;
+    } else {
+      Choice c;
+      c.in_size.assign(in_size, in_size + in_dim);
+      c.algorithm = algorithm;
+      choices_.push_back(c);
+    }
+    release();
+}
+
+void SpatialConvolutionAuto::release() {
+    if (choices_.empty()) {
+      return;
+    }
+    for (uint32_t a = 0; a < impls_.size(); a++) {
+      bool used = false;
+      for (size_t i = 0; i < choices_.size() && !used; i++) {
+        used = choices_[i].algorithm == a;
+      }
+      if (!used) {
+        SAFE_DELETE(impls_[a]);
+      }
+    }
+}
+
+uint32_t SpatialConvolutionAuto::tune(Tensor<float>& input) {
+    uint32_t best = algorithm(input.dim(), input.size());
+    double best_seconds = std::numeric_limits<double>::max();
+    for (uint32_t a = 0; a < CONV_ALGORITHM_COUNT; a++) {
+      if (!SpatialConvolutionFactory::supports(a, filt_height_, filt_width_,
+          dw_, dh_)) {
+        continue;
+      }
+      SpatialConvolution* conv = impl(a);
+      conv->setActivation(activation_);
+      conv->setPooling(poolw_, poolh_);
+
+      // The first pass allocates the workspaces (and transforms the
+      // filters), it is not timed
+      TorchData* output = NULL;
+      conv->forwardProp(input, &output);
+      SAFE_DELETE(output);
+      double seconds = std::numeric_limits<double>::max();
+      for (uint32_t i = 0; i < AUTO_CONV_TIMED_PASSES; i++) {
+        const std::chrono::steady_clock::time_point start =
+          std::chrono::steady_clock::now();
+        conv->forwardProp(input, &output);
+        seconds = std::min(seconds, std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - start).count());
+        SAFE_DELETE(output);
+      }
+      if (seconds < best_seconds) {
+        best = a;
+        best_seconds = seconds;
+      }
+    }
+    return best;
+}
+
+void SpatialConvolutionAuto::forwardProp(TorchData& input,
+    TorchData **output) {
+    if (input.type() != TorchDataType::TENSOR_DATA) {
+      throw std::runtime_error("SpatialConvolution::init() - "
+        "FloatTensor expected!");
+    }
+    Tensor<float>& in = (Tensor<float>&)input;
+    const Choice* choice = find(in.dim(), in.size());
+    uint32_t algorithm;
+    if (choice != NULL) {
+      algorithm = choice->algorithm;
+    } else {
+      std::vector<uint32_t> out_size;
+      if (autotune_ && outputSize(in.dim(), in.size(), out_size)) {
+        algorithm = tune(in);
+      } else {
+        algorithm = this->algorithm(in.dim(), in.size());
+      }
+      choose(in.dim(), in.size(), algorithm);
+    }
+
+    SpatialConvolution* conv = impls_[algorithm];
+    conv->setActivation(activation_);
+    conv->setPooling(poolw_, poolh_);
+    conv->forwardProp(input, output);
+}
+
+uint64_t SpatialConvolutionAuto::workspaceBytes(const uint32_t in_dim,
+    const uint32_t* in_size) const {
+    const Choice* choice = find(in_dim, in_size);
+    const SpatialConvolution* conv = choice != NULL ?
+      impls_[choice->algorithm] : anyImpl();
+    return conv->workspaceBytes(in_dim, in_size);
+}
+
+uint32_t SpatialConvolutionAuto::planAlgorithm(const uint32_t in_dim,
+    const uint32_t* in_size) {
+    std::vector<uint32_t> out_size;
+    if (!outputSize(in_dim, in_size, out_size)) {
+      return algorithm(in_dim, in_size);
+    }
+    // Time on a fixed non-zero fill: zero planes are skipped (see
+    // SpatialConvolutionGemm::compactPlanes), so an all-zero input would
+    // time an empty product and bias the choice
+    Tensor<float> input(in_dim, in_size);
+    float* data = input.getData();
+    for (uint32_t i = 0; i < input.nelems(); i++) {
+      data[i] = (float)((i * 7919) % 101 + 1) / 101.0f;
+    }
+    const uint32_t algorithm = tune(input);
+    choose(in_dim, in_size, algorithm);
+    return algorithm;
+}
+
+bool SpatialConvolutionAuto::useAlgorithm(const uint32_t in_dim,
+    const uint32_t* in_size, const uint32_t algorithm) {
+    if (!canUseAlgorithm(algorithm)) {
+      return false;
+    }
+    choose(in_dim, in_size, algorithm);
+    return true;
+}
+
+bool SpatialConvolutionAuto::canUseAlgorithm(const uint32_t algorithm) const {
+    return SpatialConvolutionFactory::supports(algorithm, filt_height_,
+      filt_width_, dw_, dh_);
+}
+
+}  // namespace mtorch
@@ -0,0 +1,95 @@
+//
+//  SpatialConvolutionAuto.hpp
+//
+//  SpatialConvolution that picks its implementation per input size.  The
+//  candidates are the SpatialConvolutionFactory algorithms (im2col + GEMM,
+//  which also covers 1x1 layers, direct, Winograd and FFT).  For an input
+//  size seen for the first time the algorithm comes from the factory's
+//  heuristic table, or, with setAutotune(true), from timing every supported
+//  candidate on that size.  planAlgorithm always times the candidates, so
+//  ExecutionPlanner / PlanCache record the choice and useAlgorithm restores
+//  it on the next start without benchmarking again.
+//
+//  Only the candidates a recorded choice refers to are kept; each of them
+//  holds its own (possibly transformed) copy of the parameters.  As with
+//  the Winograd and FFT implementations, in-place writes through
+//  weights()->getData() must be followed by setWeights.
+//
+
+#pragma once
+#include <cstdint>                 // for uint32_t
+#include <string>                  // for istream
+#include <vector>                  // for vector
+
+#include "SpatialConvolution.hpp"  // for SpatialConvolution
+
+// Timed forward passes per candidate when autotuning (after one untimed
+// pass that allocates the workspaces); the fastest pass counts.
+#define AUTO_CONV_TIMED_PASSES 3
+
+namespace mtorch {
+
+class TorchData;
+
+  class SpatialConvolutionAuto final : public SpatialConvolution {
+  public:
+    // Constructor / Destructor
+    SpatialConvolutionAuto(const uint32_t feats_in, const uint32_t feats_out,
+      const uint32_t filt_height, const uint32_t filt_width,
+      const uint32_t padw = 0, const uint32_t padh = 0,
+      const uint32_t dw = 1, const uint32_t dh = 1);
+    virtual ~SpatialConvolutionAuto() override;
+
+    virtual std::string name() const override { return "SpatialConvolutionAuto"; }
+    virtual void forwardProp(TorchData& input, TorchData **output) override;
+
+    virtual void setWeights(const float* weights) override;
+    virtual void setBiases(const float* biases) override;
+
+    virtual void setWeightsFromStream( InputStream & ) override;
+    virtual void setBiasesFromStream( InputStream & ) override;
+
+    virtual Tensor<float>* weights() override;
+    virtual Tensor<float>* biases() override;
+
+    virtual void setNumThreads(const uint32_t threads) override;
+    virtual uint64_t workspaceBytes(const uint32_t in_dim,
+      const uint32_t* in_size) const override;
+    virtual uint32_t planAlgorithm(const uint32_t in_dim,
+      const uint32_t* in_size) override;
+    virtual bool useAlgorithm(const uint32_t in_dim, const uint32_t* in_size,
+      const uint32_t algorithm) override;
+    virtual bool canUseAlgorithm(const uint32_t algorithm) const override;
+
+    // Benchmark unseen input sizes in forwardProp instead of using the
+    // heuristic table (off by default).
+    void setAutotune(const bool autotune) { autotune_ = autotune; }
+    // Algorithm (ConvAlgorithm) used for an input size
+    uint32_t algorithm(const uint32_t in_dim, const uint32_t* in_size) const;
+
+  protected:
+    struct Choice {
+      std::vector<uint32_t> in_size;
+      uint32_t algorithm;
+    };
+
+    std::vector<SpatialConvolution*> impls_;  // Indexed by ConvAlgorithm
+    std::vector<Choice> choices_;
+    bool autotune_;
+
+    SpatialConvolution* impl(const uint32_t algorithm);
+    SpatialConvolution* anyImpl() const;
+    const Choice* find(const uint32_t in_dim, const uint32_t* in_size) const;
+    void choose(const uint32_t in_dim, const uint32_t* in_size,
+      const uint32_t algorithm);
+    // Times every supported candidate on input, returns the fastest
+    uint32_t tune(Tensor<float>& input);
+    // Deletes the candidates no choice refers to (keeps at least one)
+    void release();
+
+    // Non-copyable, non-assignable.
+    SpatialConvolutionAuto(SpatialConvolutionAuto&);
+    SpatialConvolutionAuto& operator=(const SpatialConvolutionAuto&);
+  };
+
+};  // namespace mtorch
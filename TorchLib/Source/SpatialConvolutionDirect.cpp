@@ -0,0 +1,230 @@
+#include <stddef.h>       // for NULL
+#include <string.h>       // for memcpy, memset
+#include <algorithm>      // for min
+#include <stdexcept>      // for runtime_error
+
+#include "Kernels/LayerKernels.hpp"  // for layerKernels
+#include "SpatialConvolutionDirect.hpp"
+#include "Tensor.hpp"     // for Tensor, TO_TENSOR_PTR
+#include "ThreadPool.hpp" // for ThreadPool
+#include "TorchData.hpp"  // for TorchData, TorchDataType
+
+namespace mtorch {
+class TorchStage;
+}  // namespace mtorch
+
+#define SAFE_DELETE(x) if (x != NULL) { delete x; x = NULL; }
+#define SAFE_DELETE_ARR(x) if (x != NULL) { delete[] x; x = NULL; }
+
+
+namespace mtorch {
+
+SpatialConvolutionDirect::Kernel SpatialConvolutionDirect::kernel(
+    const uint32_t filt_height, const uint32_t filt_width, const uint32_t dh,
+    const uint32_t dw) {
+    return layerKernels().directConv(filt_height, filt_width, dh, dw);
+}
+
+SpatialConvolutionDirect::SpatialConvolutionDirect(const uint32_t feats_in,
+    const uint32_t feats_out, const uint32_t filt_height,
+    const uint32_t filt_width, const uint32_t padw, const uint32_t padh,
+    const uint32_t dw, const uint32_t dh) {
+
+    filt_width_ = filt_width;
+    filt_height_ = filt_height;
+    feats_in_ = feats_in;
+    feats_out_ = feats_out;
+    padw_ = padw;
+    padh_ = padh;
+    dw_ = dw;
+    dh_ = dh;
+
+    kernel_ = kernel(filt_height, filt_width, dh, dw);
+    if (kernel_ == NULL) {
+      throw std::runtime_error("SpatialConvolutionDirect::"
+        "SpatialConvolutionDirect() - ERROR: unsupported filter size or stride!");
+    }
+
+    uint32_t dim = 4;
+    uint32_t size[4] = {filt_width_, filt_height_, feats_in_, feats_out_};
+
+    weights_ = new Tensor<float>(dim, size);
+    biases_ = new Tensor<float>(1, &feats_out_);
+    padded_ = NULL;
+}
+
+SpatialConvolutionDirect::~SpatialConvolutionDirect() {
+    SAFE_DELETE(weights_);
+    SAFE_DELETE(biases_);
+    SAFE_DELETE(padded_);
+}
+
+void SpatialConvolutionDirect::setWeights(const float* weights) {
+    weights_->setData(weights);
+}
+
+void SpatialConvolutionDirect::setBiases(const float* biases) {
+    biases_->setData(biases);
+}
+
+void SpatialConvolutionDirect::setWeightsFromStream( InputStream & stream )
+{
+    weights_->setDataFromStream( stream );
+}
+
+void SpatialConvolutionDirect::setBiasesFromStream( InputStream & stream )
+{
+    biases_->setDataFromStream( stream );
+}
+
+uint64_t SpatialConvolutionDirect::workspaceBytes(const uint32_t in_dim,
+    const uint32_t* in_size) const {
+    std::vector<uint32_t> out_size;
+    if (!convOutputSize(in_dim, in_size, out_size)) {
+      return 0;
+    }
+    uint64_t bytes = 0;
+    if (padw_ != 0 || padh_ != 0) {
+      bytes += sizeof(float) * (uint64_t)(in_size[0] + 2 * padw_) *
+        (in_size[1] + 2 * padh_) * in_size[2];
+    }
+    if (pooled()) {
+      bytes += sizeof(float) * (uint64_t)slots() * poolh_ * out_size[0] *
+        feats_out_;
+    }
+    return bytes;
+}
+
+uint32_t SpatialConvolutionDirect::slots() const {
+    return std::min<uint32_t>(threads_, Blas::ThreadPool::shared().threads());
+}
+
+void SpatialConvolutionDirect::init(TorchData& input, TorchData **output)  {
+    if (input.type() != TorchDataType::TENSOR_DATA) {
+      throw std::runtime_error("SpatialConvolution::init() - "
+        "FloatTensor expected!");
+    }
+    Tensor<float>& in = (Tensor<float>&)input;
+    if (in.dim() != 3) {
+      throw std::runtime_error("SpatialConvolution::init() - Input not 3D!");
+    }
+    if (in.size()[2] != feats_in_) {
+      throw std::runtime_error("SpatialConvolution::init() - ERROR: "
+        "incorrect number of input features!");
+    }
+
+    const uint32_t inputWidth = in.size()[0];
+    const uint32_t inputHeight = in.size()[1];
+    const uint32_t outputWidth = (inputWidth + 2 * padw_ - filt_width_) / dw_ + 1;
+    const uint32_t outputHeight = (inputHeight + 2 * padh_ - filt_height_) / dh_ + 1;
+    if (outputWidth % poolw_ != 0 || outputHeight % poolh_ != 0) {
+      throw std::runtime_error("SpatialConvolution::init() - ERROR: "
+        "width or height is not a multiple of the poolsize!");
+    }
+
+    // Resize output
+    uint32_t out_dim[3];
+    out_dim[0] = outputWidth / poolw_;
+    out_dim[1] = outputHeight / poolh_;
+    out_dim[2] = feats_out_;
+    *output = new Tensor<float>(3, out_dim);
+
+    // Resize the pooling bands (poolh_ output rows of every plane per thread)
+    if (pooled()) {
+      band_.resize((size_t)slots() * poolh_ * outputWidth * feats_out_);
+    } else {
+      std::vector<float>().swap(band_);
+    }
+
+    // Resize the padded input (the zero border is written once)
+    if (padw_ != 0 || padh_ != 0) {
+      uint32_t padded_dim[3];
+      padded_dim[0] = inputWidth + 2 * padw_;
+      padded_dim[1] = inputHeight + 2 * padh_;
+      padded_dim[2] = feats_in_;
+      if (padded_ == NULL || padded_->size()[0] != padded_dim[0] ||
+          padded_->size()[1] != padded_dim[1]) {
+        SAFE_DELETE(padded_);
+        padded_ = new Tensor<float>(3, padded_dim);
+      }
+    }
+}
+
+void SpatialConvolutionDirect::forwardProp(TorchData& input, TorchData **output) {
+
+    init(input, output);
+
+    Tensor<float>& in = (Tensor<float>&)input;
+    Tensor<float>* out = (Tensor<float>*)(*output);
+
+    int inputWidth = (int) in.size()[0];
+    int inputHeight = (int) in.size()[1];
+    const uint32_t* out_size = TO_TENSOR_PTR(*output)->size();
+    int outputWidth = (int) (out_size[0] * poolw_);
+    int outputHeight = (int) (out_size[1] * poolh_);
+    int nInputPlane = (int) feats_in_;
+    int nOutputPlane = (int) feats_out_;
+    int padw = (int) padw_;
+    int padh = (int) padh_;
+
+    const float* src = in.getData();
+    if (padded_ != NULL) {
+      // Copy the interior; the border stays zero from the allocation
+      const int paddedWidth = inputWidth + 2 * padw;
+      const int paddedHeight = inputHeight + 2 * padh;
+      float* dst = padded_->getData();
+      for (int c = 0; c < nInputPlane; c++) {
+        for (int h = 0; h < inputHeight; h++) {
+          memcpy(dst + (c * paddedHeight + h + padh) * paddedWidth + padw,
+            src + (c * inputHeight + h) * inputWidth,
+            sizeof(float) * inputWidth);
+        }
+      }
+      src = dst;
+      inputWidth = paddedWidth;
+      inputHeight = paddedHeight;
+    }
+
+    // Threads split the output planes in multiples of the kernel's block
+    Blas::ThreadPool& pool = Blas::ThreadPool::shared();
+    const int threads = (int) slots();
+    const int OB = DIRECT_CONV_OUT_BLOCK;
+    int block = nOutputPlane;
+    if (threads > 1) {
+      block = (nOutputPlane + 2 * threads - 1) / (2 * threads);
+      block = (block + OB - 1) / OB * OB;
+    }
+    const int wstride = nInputPlane * (int) (filt_width_ * filt_height_);
+    const int out_plane = outputHeight * outputWidth;
+    const int pool_h = (int) poolh_;
+    const size_t band_size = (size_t) pool_h * outputWidth * nOutputPlane;
+    const size_t pooled_plane = (size_t) out_size[0] * out_size[1];
+    pool.parallelFor((nOutputPlane + block - 1) / block, threads,
+      [&](const int task, const int slot) {
+      const int o0 = task * block;
+      const int on = std::min(block, nOutputPlane - o0);
+      const float* weights = weights_->getData() + o0 * wstride;
+      const float* biases = biases_->getData() + o0;
+      if (!pooled()) {
+        kernel_(src, inputHeight, inputWidth, nInputPlane, weights, biases,
+          on, out->getData() + o0 * out_plane, outputHeight, outputWidth,
+          activation_);
+        return;
+      }
+      // Pooling: one row of pooling windows at a time is computed into the
+      // thread's band and pooled while it is in cache.  The input is
+      // shifted to the band's first row, the kernel only uses inputHeight
+      // as the plane stride.
+      float* band = band_.data() + slot * band_size;
+      for (int row0 = 0; row0 < outputHeight; row0 += pool_h) {
+        kernel_(src + (size_t)row0 * dh_ * inputWidth, inputHeight,
+          inputWidth, nInputPlane, weights, biases, on, band, pool_h,
+          outputWidth, activation_);
+        maxPool(band, on, pool_h, outputWidth, (size_t)pool_h * outputWidth,
+          out->getData() + o0 * pooled_plane + (row0 / pool_h) * out_size[0],
+          pooled_plane);
+      }
+    });
+}
+
+}  // namespace mtorch
@@ -0,0 +1,77 @@
+//
+//  SpatialConvolutionDirect.hpp
+//
+//  Direct (no im2col) convolution for small kernels.  The kernels are
+//  specialized at compile time on kernel size and stride, compute register
+//  blocked tiles of DIRECT_CONV_OUT_BLOCK output planes x
+//  DIRECT_CONV_WIDTH_BLOCK output columns and vectorize across the output
+//  width.  For layers with few input planes this avoids building a columns
+//  buffer that costs more than the convolution itself.
+//
+
+#pragma once
+#include <cstdint>                 // for uint32_t
+#include <string>                  // for istream
+#include <vector>                  // for vector
+
+#include "Kernels/LayerKernels.hpp"  // for DirectConvKernel
+#include "SpatialConvolution.hpp"  // for SpatialConvolution
+#include "Tensor.hpp"              // for Tensor
+
+#define DIRECT_CONV_OUT_BLOCK 4
+#define DIRECT_CONV_WIDTH_BLOCK 8
+
+namespace mtorch {
+
+class TorchData;
+class TorchStage;
+
+  class SpatialConvolutionDirect final : public SpatialConvolution {
+  public:
+    typedef DirectConvKernel Kernel;
+
+    // Constructor / Destructor
+    SpatialConvolutionDirect(const uint32_t feats_in, const uint32_t feats_out,
+      const uint32_t filt_height, const uint32_t filt_width,
+      const uint32_t padw = 0, const uint32_t padh = 0,
+      const uint32_t dw = 1, const uint32_t dh = 1);
+    virtual ~SpatialConvolutionDirect() override;
+
+    virtual std::string name() const override { return "SpatialConvolutionDirect"; }
+    virtual void forwardProp(TorchData& input, TorchData **output) override;
+
+    virtual void setWeights(const float* weights) override;
+    virtual void setBiases(const float* biases) override;
+
+    virtual void setWeightsFromStream( InputStream & ) override;
+    virtual void setBiasesFromStream( InputStream & ) override;
+
+    virtual uint64_t workspaceBytes(const uint32_t in_dim,
+      const uint32_t* in_size) const override;
+
+    virtual Tensor<float>* weights() override { return weights_; }
+    virtual Tensor<float>* biases() override { return biases_; }
+
+    // Returns the specialized kernel for a filter size and stride, NULL if
+    // there is none.
+    static Kernel kernel(const uint32_t filt_height, const uint32_t filt_width,
+      const uint32_t dh = 1, const uint32_t dw = 1);
+    static bool supports(const uint32_t filt_height, const uint32_t filt_width,
+      const uint32_t dh = 1, const uint32_t dw = 1) {
+      return kernel(filt_height, filt_width, dh, dw) != NULL;
+    }
+
+  protected:
+    Kernel kernel_;
+    Tensor<float>* padded_;  // Zero padded copy of the input (if padding)
+    std::vector<float> band_;  // One row of pooling windows per thread
+
+    void init(TorchData& input, TorchData **output);
+    uint32_t slots() const;
+
+    // Non-copyable, non-assignable.
+    SpatialConvolutionDirect(SpatialConvolutionDirect&);
+    SpatialConvolutionDirect& operator=(const SpatialConvolutionDirect&);
+  };
+
+};  // namespace mtorch
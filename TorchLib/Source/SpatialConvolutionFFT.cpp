@@ -0,0 +1,263 @@
+#include <stddef.h>       // for NULL
+#include <algorithm>      // for max, min
+#include <stdexcept>      // for runtime_error
+
+#include "Blas.hpp"       // for gemm
+#include "FFT.hpp"        // for RealFFT2D
+#include "SpatialConvolutionFFT.hpp"
+#include "Tensor.hpp"     // for Tensor, TO_TENSOR_PTR
+#include "TorchData.hpp"  // for TorchData, TorchDataType
+
+namespace mtorch {
+class TorchStage;
+}  // namespace mtorch
+
+#define SAFE_DELETE(x) if (x != NULL) { delete x; x = NULL; }
+#define SAFE_DELETE_ARR(x) if (x != NULL) { delete[] x; x = NULL; }
+
+
+namespace mtorch {
+
+namespace {
+
+uint32_t nextPowerOfTwo(const uint32_t x) {
+    uint32_t n = 2;
+    while (n < x) {
+        n <<= 1;
+    }
+    return n;
+}
+
+}  // unnamed namespace
+
+SpatialConvolutionFFT::SpatialConvolutionFFT(const uint32_t feats_in,
+    const uint32_t feats_out, const uint32_t filt_height,
+    const uint32_t filt_width, const uint32_t padw, const uint32_t padh) {
+
+    filt_width_ = filt_width;
+    filt_height_ = filt_height;
+    feats_in_ = feats_in;
+    feats_out_ = feats_out;
+    padw_ = padw;
+    padh_ = padh;
+
+    uint32_t dim = 4;
+    uint32_t size[4] = {filt_width_, filt_height_, feats_in_, feats_out_};
+
+    weights_ = new Tensor<float>(dim, size);
+    biases_ = new Tensor<float>(1, &feats_out_);
+    fft_ = NULL;
+    transformed_generation_ = 0;
+}
+
+SpatialConvolutionFFT::~SpatialConvolutionFFT() {
+    SAFE_DELETE(weights_);
+    SAFE_DELETE(biases_);
+    SAFE_DELETE(fft_);
+}
+
+void SpatialConvolutionFFT::setWeights(const float* weights) {
+    weights_->setData(weights);
+}
+
+void SpatialConvolutionFFT::setBiases(const float* biases) {
+    biases_->setData(biases);
+}
+
+void SpatialConvolutionFFT::setWeightsFromStream( InputStream & stream )
+{
+    weights_->setDataFromStream( stream );
+}
+
+void SpatialConvolutionFFT::setBiasesFromStream( InputStream & stream )
+{
+    biases_->setDataFromStream( stream );
+}
+
+uint32_t SpatialConvolutionFFT::tileSize(const uint32_t width,
+    const uint32_t height) const {
+    // One block for the whole input if it fits, otherwise the largest tile
+    // allowed (but always at least twice the filter, so blocks stay useful)
+    const uint32_t whole = nextPowerOfTwo(std::max(width + filt_width_ - 1,
+      height + filt_height_ - 1));
+    const uint32_t limit = std::max<uint32_t>(FFT_CONV_MAX_TILE,
+      nextPowerOfTwo(2 * std::max(filt_width_, filt_height_)));
+    return std::min(whole, limit);
+}
+
+void SpatialConvolutionFFT::transformFilters() {
+    const int nIn = (int)feats_in_;
+    const int nOut = (int)feats_out_;
+    const int filt = (int)(filt_width_ * filt_height_);
+    const int stride = nOut * nIn;
+    const int bins = fft_->bins();
+    const float* w = weights_->getData();
+
+    filt_re_.resize((size_t)bins * stride);
+    filt_im_.resize((size_t)bins * stride);
+    for (int i = 0; i < stride; i++) {
+      // Torch filter layout is [feats_out][feats_in][kh][kw], i is o * nIn + c
+      fft_->forward(w + i * filt, (int)filt_height_, (int)filt_width_,
+        (int)filt_width_, filt_re_.data() + i, filt_im_.data() + i, stride);
+    }
+    // Correlation multiplies with the conjugate
+    for (size_t i = 0; i < filt_im_.size(); i++) {
+      filt_im_[i] = -filt_im_[i];
+    }
+    transformed_generation_ = weights_->generation();
+}
+
+uint64_t SpatialConvolutionFFT::workspaceBytes(const uint32_t in_dim,
+    const uint32_t* in_size) const {
+    if (in_dim != 3) {
+      return 0;
+    }
+    const uint64_t n = tileSize(in_size[0], in_size[1]);
+    const uint64_t bins = n * (n / 2 + 1);
+    return sizeof(float) * (2 * bins * FFT_CONV_BLOCK_BATCH *
+      (feats_in_ + feats_out_) + n * n);
+}
+
+void SpatialConvolutionFFT::init(TorchData& input, TorchData **output)  {
+    if (input.type() != TorchDataType::TENSOR_DATA) {
+      throw std::runtime_error("SpatialConvolution::init() - "
+        "FloatTensor expected!");
+    }
+    Tensor<float>& in = (Tensor<float>&)input;
+    if (in.dim() != 3) {
+      throw std::runtime_error("SpatialConvolution::init() - Input not 3D!");
+    }
+    if (in.size()[2] != feats_in_) {
+      throw std::runtime_error("SpatialConvolution::init() - ERROR: "
+        "incorrect number of input features!");
+    }
+
+    const uint32_t inputWidth = in.size()[0];
+    const uint32_t inputHeight = in.size()[1];
+    const uint32_t outputWidth = inputWidth - filt_width_ + 1 + 2 * padw_;
+    const uint32_t outputHeight = inputHeight - filt_height_ + 1 + 2 * padh_;
+
+    // Resize output
+    uint32_t out_dim[3];
+    out_dim[0] = outputWidth;
+    out_dim[1] = outputHeight;
+    out_dim[2] = feats_out_;
+    *output = new Tensor<float>(3, out_dim);
+
+    // A new tile size invalidates the filter spectra
+    const uint32_t n = tileSize(inputWidth, inputHeight);
+    if (fft_ == NULL || (uint32_t)fft_->size() != n) {
+      SAFE_DELETE(fft_);
+      fft_ = new Blas::RealFFT2D((int)n);
+      transformed_generation_ = 0;
+    }
+    if (transformed_generation_ != weights_->generation()) {
+      transformFilters();
+    }
+
+    const size_t bins = (size_t)fft_->bins();
+    in_re_.resize(bins * feats_in_ * FFT_CONV_BLOCK_BATCH);
+    in_im_.resize(in_re_.size());
+    out_re_.resize(bins * feats_out_ * FFT_CONV_BLOCK_BATCH);
+    out_im_.resize(out_re_.size());
+    tile_.resize((size_t)n * n);
+}
+
+void SpatialConvolutionFFT::forwardProp(TorchData& input, TorchData **output) {
+
+    init(input, output);
+
+    Tensor<float>& in = (Tensor<float>&)input;
+    Tensor<float>* out = (Tensor<float>*)(*output);
+
+    const int inputWidth = (int) in.size()[0];
+    const int inputHeight = (int) in.size()[1];
+    const uint32_t* out_size = TO_TENSOR_PTR(*output)->size();
+    const int outputWidth = (int) out_size[0];
+    const int outputHeight = (int) out_size[1];
+    const int nInputPlane = (int) feats_in_;
+    const int nOutputPlane = (int) feats_out_;
+    const int kw = (int) filt_width_;
+    const int kh = (int) filt_height_;
+    const int n = fft_->size();
+    const int bins = fft_->bins();
+    const int blockW = n - kw + 1;
+    const int blockH = n - kh + 1;
+    const int blocksX = (inputWidth + blockW - 1) / blockW;
+    const int blocksY = (inputHeight + blockH - 1) / blockH;
+    const int B = FFT_CONV_BLOCK_BATCH;
+
+    const float* src = in.getData();
+    float* dst = out->getData();
+    const float* biases = biases_->getData();
+    for (int o = 0; o < nOutputPlane; o++) {
+      std::fill(dst + o * outputHeight * outputWidth,
+        dst + (o + 1) * outputHeight * outputWidth, biases[o]);
+    }
+
+    for (int first = 0; first < blocksX * blocksY; first += B) {
+      const int count = std::min(B, blocksX * blocksY - first);
+
+      // Block spectra, [bin][plane][block]
+      for (int b = 0; b < count; b++) {
+        const int x0 = ((first + b) % blocksX) * blockW;
+        const int y0 = ((first + b) / blocksX) * blockH;
+        for (int c = 0; c < nInputPlane; c++) {
+          fft_->forward(src + (c * inputHeight + y0) * inputWidth + x0,
+            std::min(blockH, inputHeight - y0), std::min(blockW, inputWidth - x0),
+            inputWidth, in_re_.data() + c * B + b, in_im_.data() + c * B + b,
+            nInputPlane * B);
+        }
+      }
+
+      // Per bin (column major): Y (B x out) = X (B x in) * conj(W) (in x out)
+      //   Re Y = Re X Re W - Im X Im W,  Im Y = Im X Re W + Re X Im W
+      for (int k = 0; k < bins; k++) {
+        float* xr = in_re_.data() + (size_t)k * nInputPlane * B;
+        float* xi = in_im_.data() + (size_t)k * nInputPlane * B;
+        float* wr = filt_re_.data() + (size_t)k * nOutputPlane * nInputPlane;
+        float* wi = filt_im_.data() + (size_t)k * nOutputPlane * nInputPlane;
+        float* yr = out_re_.data() + (size_t)k * nOutputPlane * B;
+        float* yi = out_im_.data() + (size_t)k * nOutputPlane * B;
+        Blas::gemm('n', 'n', count, nOutputPlane, nInputPlane, 1, xr, B, wr, nInputPlane, 0, yr, B);
+        Blas::gemm('n', 'n', count, nOutputPlane, nInputPlane, -1, xi, B, wi, nInputPlane, 1, yr, B);
+        Blas::gemm('n', 'n', count, nOutputPlane, nInputPlane, 1, xi, B, wr, nInputPlane, 0, yi, B);
+        Blas::gemm('n', 'n', count, nOutputPlane, nInputPlane, 1, xr, B, wi, nInputPlane, 1, yi, B);
+      }
+
+      // Back to the spatial domain and overlap-add.  Tile entry d (mod n),
+      // d in [-(k - 1), L - 1], lands at output position block + pad + d.
+      for (int b = 0; b < count; b++) {
+        const int x0 = ((first + b) % blocksX) * blockW + (int)padw_;
+        const int y0 = ((first + b) / blocksX) * blockH + (int)padh_;
+        const int dx0 = std::max(-(kw - 1), -x0);
+        const int dx1 = std::min(blockW - 1, outputWidth - 1 - x0);
+        const int dy0 = std::max(-(kh - 1), -y0);
+        const int dy1 = std::min(blockH - 1, outputHeight - 1 - y0);
+        for (int o = 0; o < nOutputPlane; o++) {
+          fft_->inverse(out_re_.data() + o * B + b, out_im_.data() + o * B + b,
+            nOutputPlane * B, tile_.data());
+          float* plane = dst + o * outputHeight * outputWidth;
+          for (int dy = dy0; dy <= dy1; dy++) {
+            const float* row = tile_.data() + ((dy + n) % n) * n;
+            float* out_row = plane + (y0 + dy) * outputWidth + x0;
+            for (int dx = dx0; dx <= dx1; dx++) {
+              out_row[dx] += row[(dx + n) % n];
+            }
+          }
+        }
+      }
+    }
+
+    // Overlap-add means no output is final before the last block, so the
+    // activation is a separate pass here
+    if (!activation_.none()) {
+      activation_.apply(dst, (size_t)nOutputPlane * outputHeight * outputWidth);
+    }
+
+    if (pooled()) {
+      poolOutput(output);
+    }
+}
+
+}  // namespace mtorch
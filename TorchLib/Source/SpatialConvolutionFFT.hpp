@@ -0,0 +1,91 @@
+//
+//  SpatialConvolutionFFT.hpp
+//
+//  FFT convolution for large filters.  The input is cut into L x L blocks
+//  (L = n - filter + 1 for an n x n FFT tile), every block is transformed
+//  once per input plane, multiplied with the conjugated filter spectra
+//  (summed over the input planes as one complex GEMM per frequency bin),
+//  transformed back once per output plane and overlap-added into the output.
+//  The cost no longer grows with the filter area, only the tile size does.
+//
+//  The filter spectra depend on the tile size, which is chosen from the
+//  input size (the smallest power of two covering the whole input, at most
+//  FFT_CONV_MAX_TILE), so they are computed on the first forward pass for an
+//  input size and reused until the input size or the weights change.  They
+//  take n * (n / 2 + 1) * 2 / (kh * kw) times the memory of the weights.
+//  Blocks are processed FFT_CONV_BLOCK_BATCH at a time, which bounds the
+//  workspace independent of the input size.
+//
+//  As with SpatialConvolutionWinograd, the spectra follow the generation of
+//  the weights tensor; in-place writes through weights()->getData() must be
+//  followed by weights()->markModified().
+//
+
+#pragma once
+#include <cstdint>                 // for uint32_t
+#include <string>                  // for istream
+#include <vector>                  // for vector
+
+#include "SpatialConvolution.hpp"  // for SpatialConvolution
+#include "Tensor.hpp"              // for Tensor
+
+#define FFT_CONV_MAX_TILE 32
+#define FFT_CONV_BLOCK_BATCH 8
+
+namespace Blas {
+class RealFFT2D;
+}
+
+namespace mtorch {
+
+class TorchData;
+class TorchStage;
+
+  class SpatialConvolutionFFT final : public SpatialConvolution {
+  public:
+    // Constructor / Destructor
+    SpatialConvolutionFFT(const uint32_t feats_in, const uint32_t feats_out,
+      const uint32_t filt_height, const uint32_t filt_width,
+      const uint32_t padw = 0, const uint32_t padh = 0);
+    virtual ~SpatialConvolutionFFT() override;
+
+    virtual std::string name() const override { return "SpatialConvolutionFFT"; }
+    virtual void forwardProp(TorchData& input, TorchData **output) override;
+
+    virtual void setWeights(const float* weights) override;
+    virtual void setBiases(const float* biases) override;
+
+    virtual void setWeightsFromStream( InputStream & ) override;
+    virtual void setBiasesFromStream( InputStream & ) override;
+
+    virtual uint64_t workspaceBytes(const uint32_t in_dim,
+      const uint32_t* in_size) const override;
+
+    virtual Tensor<float>* weights() override { return weights_; }
+    virtual Tensor<float>* biases() override { return biases_; }
+
+    // FFT tile size used for an input of the given width and height.
+    uint32_t tileSize(const uint32_t width, const uint32_t height) const;
+
+  protected:
+    Blas::RealFFT2D* fft_;  // For the current tile size
+
+    std::vector<float> filt_re_;  // Conjugated filter spectra [bin][feats_out][feats_in]
+    std::vector<float> filt_im_;
+    uint64_t transformed_generation_;  // weights_ generation of the spectra (0: none)
+
+    std::vector<float> in_re_;  // Block spectra [bin][feats_in][FFT_CONV_BLOCK_BATCH]
+    std::vector<float> in_im_;
+    std::vector<float> out_re_;  // Product spectra [bin][feats_out][FFT_CONV_BLOCK_BATCH]
+    std::vector<float> out_im_;
+    std::vector<float> tile_;  // One n x n inverse transformed tile
+
+    void init(TorchData& input, TorchData **output);
+    void transformFilters();
+
+    // Non-copyable, non-assignable.
+    SpatialConvolutionFFT(SpatialConvolutionFFT&);
+    SpatialConvolutionFFT& operator=(const SpatialConvolutionFFT&);
+  };
+
+};  // namespace mtorch
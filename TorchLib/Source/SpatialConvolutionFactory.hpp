@@ -1,26 +1,151 @@
 
 #pragma once
 
+#include <algorithm>
 
 #include "SpatialConvolution.hpp"
+#include "SpatialConvolutionAuto.hpp"
+#include "SpatialConvolutionDirect.hpp"
+#include "SpatialConvolutionFFT.hpp"
 #include "SpatialConvolutionGemm.hpp"
+#include "SpatialConvolutionWinograd.hpp"
 
+// Largest reduction size (feats_in * filt_height * filt_width) for which the
+// direct kernels are preferred over im2col + GEMM.
+#define DIRECT_CONV_MAX_REDUCTION 1024
+// Smallest number of input and output planes for which Winograd is used for
+// 3x3 (F(4x4,3x3)) and 5x5 (F(2x2,5x5)) filters.  Below it the tile
+// transforms cost more than the multiplications they save.
+#define WINOGRAD_MIN_FEATURES 32
+// Smallest filter size and number of input planes for which the FFT
+// convolution is used; from there on it beats im2col + GEMM by 2-9x.
+#define FFT_CONV_MIN_FILTER 7
+#define FFT_CONV_MIN_FEATURES 8
 
 namespace mtorch {
 
+// Implementations the factory can create.  The ids are recorded in
+// ExecutionPlans (see SpatialConvolutionAuto), keep them stable.
+typedef enum {
+    CONV_ALGORITHM_GEMM = 0,        // im2col + GEMM, 1x1 layers skip im2col
+    CONV_ALGORITHM_DIRECT = 1,
+    CONV_ALGORITHM_WINOGRAD_2 = 2,  // F(2x2,3x3), F(2x2,5x5)
+    CONV_ALGORITHM_WINOGRAD_4 = 3,  // F(4x4,3x3)
+    CONV_ALGORITHM_FFT = 4,
+    CONV_ALGORITHM_COUNT = 5,
+} ConvAlgorithm;
+
 class SpatialConvolutionFactory {
 
 public:
-    static TorchStage* loadFromStream( InputStream & stream ) noexcept
+    // SPATIAL_CONVOLUTION_STAGE / SPATIAL_CONVOLUTION_MM_STAGE records have
+    // no stride (it is 1), SPATIAL_CONVOLUTION_STRIDED_STAGE records append
+    // dW and dH.  Loaded convolutions choose their algorithm per input size.
+    static TorchStage* loadFromStream( InputStream & stream, const bool strided = false ) noexcept
     {
-        return SpatialConvolutionGemm::loadFromStream(stream);
+        int32_t filt_width, filt_height, n_input_features, n_output_features,
+          padw, padh, dw = 1, dh = 1;
+
+        filt_width = stream.read< int32_t >();
+        filt_height = stream.read< int32_t >();
+        n_input_features = stream.read< int32_t >();
+        n_output_features = stream.read< int32_t >();
+        padw = stream.read< int32_t >();
+        padh = stream.read< int32_t >();
+        if (strided) {
+          dw = stream.read< int32_t >();
+          dh = stream.read< int32_t >();
+        }
+
+        SpatialConvolution* ret = new SpatialConvolutionAuto(n_input_features,
+          n_output_features, filt_height, filt_width, padw, padh, dw, dh);
+
+        ret->setWeightsFromStream( stream );
+        ret->setBiasesFromStream( stream );
+
+        return ret;
     }
 
+    // Implementation chosen by the heuristic table
     static SpatialConvolution* create(const uint32_t feats_in, const uint32_t feats_out,
                               const uint32_t filt_height, const uint32_t filt_width,
-                              const uint32_t padw = 0, const uint32_t padh = 0) {
+                              const uint32_t padw = 0, const uint32_t padh = 0,
+                              const uint32_t dw = 1, const uint32_t dh = 1) {
+        return createAlgorithm(heuristic(feats_in, feats_out, filt_height, filt_width, dw, dh),
+          feats_in, feats_out, filt_height, filt_width, padw, padh, dw, dh);
+    }
+
+    // Returns NULL if algorithm does not support the filter size or stride
+    static SpatialConvolution* createAlgorithm(const uint32_t algorithm,
+                              const uint32_t feats_in, const uint32_t feats_out,
+                              const uint32_t filt_height, const uint32_t filt_width,
+                              const uint32_t padw = 0, const uint32_t padh = 0,
+                              const uint32_t dw = 1, const uint32_t dh = 1) {
+        if (!supports(algorithm, filt_height, filt_width, dw, dh)) {
+            return NULL;
+        }
+        switch (algorithm) {
+        case CONV_ALGORITHM_DIRECT:
+            return new SpatialConvolutionDirect(feats_in, feats_out, filt_height, filt_width, padw, padh, dw, dh);
+        case CONV_ALGORITHM_WINOGRAD_2:
+            return new SpatialConvolutionWinograd(feats_in, feats_out, filt_height, filt_width, padw, padh, 2);
+        case CONV_ALGORITHM_WINOGRAD_4:
+            return new SpatialConvolutionWinograd(feats_in, feats_out, filt_height, filt_width, padw, padh, 4);
+        case CONV_ALGORITHM_FFT:
+            return new SpatialConvolutionFFT(feats_in, feats_out, filt_height, filt_width, padw, padh);
+        default:
+            return new SpatialConvolutionGemm(feats_in, feats_out, filt_height, filt_width, padw, padh, dw, dh);
+        }
+    }
+
+    static bool supports(const uint32_t algorithm,
+                         const uint32_t filt_height, const uint32_t filt_width,
+                         const uint32_t dw = 1, const uint32_t dh = 1) {
+        const bool unit_stride = dw == 1 && dh == 1;
+        switch (algorithm) {
+        case CONV_ALGORITHM_GEMM:
+            return true;
+        case CONV_ALGORITHM_DIRECT:
+            return SpatialConvolutionDirect::supports(filt_height, filt_width, dh, dw);
+        case CONV_ALGORITHM_WINOGRAD_2:
+            return unit_stride && SpatialConvolutionWinograd::supports(filt_height, filt_width, 2);
+        case CONV_ALGORITHM_WINOGRAD_4:
+            return unit_stride && SpatialConvolutionWinograd::supports(filt_height, filt_width, 4);
+        case CONV_ALGORITHM_FFT:
+            return unit_stride;
+        default:
+            return false;
+        }
+    }
+
+    // The heuristic table: the algorithm used when none was benchmarked
+    static uint32_t heuristic(const uint32_t feats_in, const uint32_t feats_out,
+                              const uint32_t filt_height, const uint32_t filt_width,
+                              const uint32_t dw = 1, const uint32_t dh = 1) {
 
-        return new SpatialConvolutionGemm(feats_in, feats_out, filt_height, filt_width, padw, padh);
+        // Winograd and FFT only compute stride 1 outputs
+        if (dw == 1 && dh == 1) {
+            if (feats_in >= WINOGRAD_MIN_FEATURES && feats_out >= WINOGRAD_MIN_FEATURES) {
+                const uint32_t algorithm = filt_width == 3 ?
+                    CONV_ALGORITHM_WINOGRAD_4 : CONV_ALGORITHM_WINOGRAD_2;
+                if (supports(algorithm, filt_height, filt_width)) {
+                    return algorithm;
+                }
+            }
+            if (std::max(filt_height, filt_width) >= FFT_CONV_MIN_FILTER &&
+                feats_in >= FFT_CONV_MIN_FEATURES) {
+                return CONV_ALGORITHM_FFT;
+            }
+        }
+        // Small kernels over few input planes: building the columns buffer
+        // costs more than the convolution, run them directly.  Strided
+        // columns buffers shrink with the stride while the direct kernels
+        // fall back to gathers, hence the lower limit.
+        if (SpatialConvolutionDirect::supports(filt_height, filt_width, dh, dw) &&
+            feats_in * filt_height * filt_width <= DIRECT_CONV_MAX_REDUCTION / (dw * dh)) {
+            return CONV_ALGORITHM_DIRECT;
+        }
+        return CONV_ALGORITHM_GEMM;
     }
 
 };
@@ -1,9 +1,14 @@
 #include <math.h>         // for fabsf, floor, log10, pow
 #include <stddef.h>       // for NULL
+#include <string.h>       // for memcpy
+#include <algorithm>      // for min
 #include <stdexcept>      // for runtime_error
 
-#include "Blas.hpp"       // for gemm, im2col
+#include "Blas.hpp"       // for im2colRows
+#include "BlockSparse.hpp" // for BlockSparseMatrix
+#include "PackedMatrix.hpp" // for PackedMatrix
 #include "SpatialConvolutionGemm.hpp"
+#include "ThreadPool.hpp" // for ThreadPool
 #include "Tensor.hpp"     // for Tensor, TO_TENSOR_PTR
 #include "TorchData.hpp"  // for TorchData, TorchDataType
 
@@ -19,7 +24,8 @@ namespace mtorch {
 
 SpatialConvolutionGemm::SpatialConvolutionGemm(const uint32_t feats_in,
     const uint32_t feats_out, const uint32_t filt_height,
-    const uint32_t filt_width, const uint32_t padw, const uint32_t padh) {
+    const uint32_t filt_width, const uint32_t padw, const uint32_t padh,
+    const uint32_t dw, const uint32_t dh) {
 
     filt_width_ = filt_width;
     filt_height_ = filt_height;
@@ -27,17 +33,27 @@ SpatialConvolutionGemm::SpatialConvolutionGemm(const uint32_t feats_in,
     feats_out_ = feats_out;
     padw_ = padw;
     padh_ = padh;
+    dw_ = dw;
+    dh_ = dh;
 
     uint32_t dim = 4;
     uint32_t size[4] = {filt_width_, filt_height_, feats_in_, feats_out_};
 
     weights_ = new Tensor<float>(dim, size);
     biases_ = new Tensor<float>(1, &feats_out_);
+    sparse_ = NULL;
+    packed_ = new Blas::PackedMatrix();
+    live_packed_ = new Blas::PackedMatrix();
+    live_packed_generation_ = 0;
+    packed_generation_ = 0;
 }
 
 SpatialConvolutionGemm::~SpatialConvolutionGemm() {
     SAFE_DELETE(weights_);
     SAFE_DELETE(biases_);
+    SAFE_DELETE(sparse_);
+    SAFE_DELETE(packed_);
+    SAFE_DELETE(live_packed_);
 }
 
 void SpatialConvolutionGemm::setWeights(const float* weights) {
@@ -58,7 +74,49 @@ void SpatialConvolutionGemm::setBiasesFromStream( InputStream & stream )
     biases_->setDataFromStream( stream );
 }
 
-void SpatialConvolutionGemm::init(TorchData& input, TorchData **output, Tensor<float>** ones, Tensor<float>** columns)  {
+uint64_t SpatialConvolutionGemm::workspaceBytes(const uint32_t in_dim,
+    const uint32_t* in_size) const {
+    std::vector<uint32_t> out_size;
+    if (!convOutputSize(in_dim, in_size, out_size)) {
+      return 0;
+    }
+    // columns (and pooling band), one panel of output rows per thread
+    const uint64_t rows = panelRows(out_size[0], out_size[1]);
+    uint64_t bytes = 0;
+    if (!pointwise()) {
+      bytes += sizeof(float) * slots() * rows * out_size[0] * feats_in_ *
+        filt_width_ * filt_height_;
+    }
+    if (pooled()) {
+      bytes += sizeof(float) * slots() * rows * out_size[0] * feats_out_;
+    }
+    return bytes;
+}
+
+uint32_t SpatialConvolutionGemm::slots() const {
+    return std::min<uint32_t>(threads_, Blas::ThreadPool::shared().threads());
+}
+
+uint32_t SpatialConvolutionGemm::panelRows(const uint32_t outputWidth,
+    const uint32_t outputHeight) const {
+    const uint64_t row_bytes = sizeof(float) * (uint64_t)outputWidth *
+      feats_in_ * filt_width_ * filt_height_;
+    uint64_t rows = std::max<uint64_t>(1, GEMM_CONV_PANEL_BYTES / row_bytes);
+    // Enough panels to keep every thread busy
+    const uint32_t threads = slots();
+    if (threads > 1) {
+      rows = std::min<uint64_t>(rows, std::max<uint64_t>(1,
+        (outputHeight + GEMM_CONV_TASKS_PER_THREAD * threads - 1) /
+        (GEMM_CONV_TASKS_PER_THREAD * threads)));
+    }
+    // Panels hold whole rows of pooling windows
+    if (pooled()) {
+      rows = std::max<uint64_t>(poolh_, rows / poolh_ * poolh_);
+    }
+    return (uint32_t)std::min<uint64_t>(rows, outputHeight);
+}
+
+void SpatialConvolutionGemm::init(TorchData& input, TorchData **output)  {
     if (input.type() != TorchDataType::TENSOR_DATA) {
       throw std::runtime_error("SpatialConvolution::init() - "
         "FloatTensor expected!");
@@ -74,98 +132,217 @@ void SpatialConvolutionGemm::init(TorchData& input, TorchData **output, Tensor<f
 
     const uint32_t inputWidth = in.size()[0];
     const uint32_t inputHeight = in.size()[1];
-    const uint32_t outputWidth = inputWidth - filt_width_ + 1 + 2 * padw_;
-    const uint32_t outputHeight = inputHeight - filt_height_ + 1 + 2 * padh_;
+    const uint32_t outputWidth = (inputWidth + 2 * padw_ - filt_width_) / dw_ + 1;
+    const uint32_t outputHeight = (inputHeight + 2 * padh_ - filt_height_) / dh_ + 1;
+
+    if (outputWidth % poolw_ != 0 || outputHeight % poolh_ != 0) {
+      throw std::runtime_error("SpatialConvolution::init() - ERROR: "
+        "width or height is not a multiple of the poolsize!");
+    }
 
     // Resize output
     uint32_t out_dim[3];
-    out_dim[0] = outputWidth;
-    out_dim[1] = outputHeight;
+    out_dim[0] = outputWidth / poolw_;
+    out_dim[1] = outputHeight / poolh_;
     out_dim[2] = feats_out_;
     *output = new Tensor<float>(3, out_dim);
 
-    // Resize temporary columns
-    uint32_t columns_dim[2];
-    columns_dim[0] = outputHeight * outputWidth;
-    columns_dim[1] = feats_in_ * filt_width_ * filt_height_;
-    *columns = new Tensor<float>(2, columns_dim);
-
-    // Define a buffer of ones, for bias accumulation
-    uint32_t ones_dim[2];
-    ones_dim[0] = outputWidth;
-    ones_dim[1] = outputHeight;
-    *ones = new Tensor<float>(2, ones_dim);
-
+    // Resize temporary columns (one panel of output rows per thread)
+    const uint32_t rows = panelRows(outputWidth, outputHeight);
+    if (pointwise()) {
+      std::vector<float>().swap(columns_);
+    } else {
+      columns_.resize((size_t)slots() * rows * outputWidth * feats_in_ *
+        filt_width_ * filt_height_);
+    }
+    // The panel output is pooled before it is stored
+    if (pooled()) {
+      band_.resize((size_t)slots() * rows * outputWidth * feats_out_);
+    } else {
+      std::vector<float>().swap(band_);
+    }
 }
 
 void SpatialConvolutionGemm::forwardProp(TorchData& input, TorchData **output) {
 
-    Tensor<float>* ones = NULL;
-    Tensor<float>* columns = NULL;
-
-    init(input, output, &ones, &columns);
+    init(input, output);
 
     Tensor<float>& in = (Tensor<float>&)input;
     Tensor<float>* out = (Tensor<float>*)(*output);
 
-    int inputWidth = (int) in.size()[0];
-    int inputHeight = (int) in.size()[1];
+    const int inputWidth = (int) in.size()[0];
+    const int inputHeight = (int) in.size()[1];
     const uint32_t* out_size = TO_TENSOR_PTR(*output)->size();
-    int outputWidth = (int) out_size[0];
-    int outputHeight = (int) out_size[1];
+    const int outputWidth = (int) (out_size[0] * poolw_);
+    const int outputHeight = (int) (out_size[1] * poolh_);
+    const int nOutputPlane = (int) feats_out_;
+    const int kH = (int) filt_height_;
+    const int kW = (int) filt_width_;
+    const int n = outputHeight * outputWidth;
+    const int threads = (int) slots();
+
+    if (packed_generation_ != weights_->generation()) {
+      packWeights();
+    }
+
+    // Zero input planes add nothing to the output, the GEMM (and im2col)
+    // skip them if there are enough.  Block-sparse weights are packed for
+    // all the input planes, and already skip the zero weights instead.
+    float* src = in.getData();
+    const Blas::PackedMatrix* weights = packed_;
     int nInputPlane = (int) feats_in_;
-    int nOutputPlane = (int) feats_out_;
-    int kH = (int) filt_height_;
-    int kW = (int) filt_width_;
-    int padw = (int) padw_;
-    int padh = (int) padh_;
-    int dH = 1;
-    int dW = 1;
-
-    // Do Bias first:
-    int m = nOutputPlane;
-    int n = outputHeight * outputWidth;
-    int k = 1;
-    Tensor<float>::fill(*ones, 1);
-
-    Blas::gemm('t', 'n', n, m, k, 1, ones->getData(), k,
-                biases_->getData(), k, 0, out->getData(), n);
-
-    // Extract columns:
-    Blas::im2col((&in)->getData(), nInputPlane, inputHeight, inputWidth, kH, kW, padh,
-                padw, dH, dW, columns->getData());
-
-    m = nOutputPlane;
-    n = outputHeight * outputWidth;
-    k = nInputPlane * kH * kW;
-
-    Blas::gemm('n', 'n', n, m, k, 1, columns->getData(), n,
-                weights_->getData(), k, 1, out->getData(), n);
-
-    SAFE_DELETE(ones);
-    SAFE_DELETE(columns);
-}
+    if (sparse_ == NULL && compactPlanes(in)) {
+      src = sparse_input_.data();
+      weights = live_packed_;
+      nInputPlane = (int) live_.size();
+    }
 
-TorchStage* SpatialConvolutionGemm::loadFromStream(InputStream & stream) noexcept
-{
-      int32_t filt_width, filt_height, n_input_features, n_output_features,
-        padw, padh;
+    // Implicit GEMM: the columns are built for a panel of output rows at a
+    // time, so the workspace stays within GEMM_CONV_PANEL_BYTES (per thread)
+    // however large the image is, and every panel is consumed while it is in
+    // cache.  With several threads the work is split into (panel, block of
+    // output planes) tasks; blocks of output planes are only used when there
+    // are too few panels to go round.  Each thread builds the columns of the
+    // panels it works on itself.
+    const int rows = (int) panelRows(outputWidth, outputHeight);
+    const int panels = (outputHeight + rows - 1) / rows;
+    int block = nOutputPlane;
+    if (panels < GEMM_CONV_TASKS_PER_THREAD * threads) {
+      const int blocks = (GEMM_CONV_TASKS_PER_THREAD * threads + panels - 1) / panels;
+      block = std::max(GEMM_CONV_MIN_OUT_BLOCK, (nOutputPlane + blocks - 1) / blocks);
+      // Whole panels (blocks) of the packed weights
+      const int align = sparse_ != NULL ? (int) Blas::BlockSparseMatrix::BLOCK :
+        (int) Blas::PackedMatrix::PANEL;
+      block = (block + align - 1) / align * align;
+    }
+    const int blocks = (nOutputPlane + block - 1) / block;
+    const size_t panel_size = (size_t) rows * outputWidth * nInputPlane * kH * kW;
+    const size_t band_size = (size_t) rows * outputWidth * nOutputPlane;
+    const size_t pooled_n = (size_t) out_size[0] * out_size[1];
+
+    std::vector<int> built(threads, -1);  // Panel in each thread's columns
+    Blas::ThreadPool::shared().parallelFor(panels * blocks, threads,
+      [&](const int task, const int slot) {
+      const int panel = task / blocks;
+      const int o0 = (task % blocks) * block;
+      const int row0 = panel * rows;
+      const int pn = std::min(rows, outputHeight - row0) * outputWidth;
+
+      // 1x1 layers: the input already is the columns matrix, [feats_in][pixels]
+      float* columns = src + row0 * outputWidth;
+      int ldcolumns = n;
+      if (!pointwise()) {
+        columns = columns_.data() + slot * panel_size;
+        ldcolumns = pn;
+        if (built[slot] != panel) {
+          Blas::im2colRows(src, nInputPlane, inputHeight, inputWidth, kH, kW,
+            (int) padh_, (int) padw_, (int) dh_, (int) dw_, row0, pn / outputWidth, columns);
+          built[slot] = panel;
+        }
+      }
+      const int on = std::min(block, nOutputPlane - o0);
+      if (!pooled()) {
+        multiply(columns, ldcolumns, pn, *weights, o0, on,
+          out->getData() + (size_t)o0 * n + row0 * outputWidth, n);
+        return;
+      }
+      // Pooling: the panel is computed into the thread's band and pooled
+      // while it is in cache, the full resolution output is never stored
+      float* band = band_.data() + slot * band_size;
+      multiply(columns, ldcolumns, pn, *weights, o0, on, band, pn);
+      maxPool(band, on, pn / outputWidth, outputWidth, (size_t)pn,
+        out->getData() + o0 * pooled_n + (row0 / poolh_) * out_size[0],
+        pooled_n);
+    });
+}
 
-      filt_width = stream.read< int32_t >();
-      filt_height = stream.read< int32_t >();
-      n_input_features = stream.read< int32_t >();
-      n_output_features = stream.read< int32_t >();
-      padw = stream.read< int32_t >();
-      padh = stream.read< int32_t >();
+bool SpatialConvolutionGemm::compactPlanes(Tensor<float>& in) {
+    const size_t plane = (size_t) in.size()[0] * in.size()[1];
+    const float* data = in.getData();
+    // A plane with any nonzero value usually has one near its start, so
+    // dense inputs cost a few reads per plane
+    live_.clear();
+    for (uint32_t c = 0; c < feats_in_; c++) {
+      const float* p = data + c * plane;
+      size_t i = 0;
+      while (i < plane && p[i] == 0) {
+        i++;
+      }
+      if (i < plane) {
+        live_.push_back(c);
+      }
+    }
+    if (live_.size() * 100 > (size_t)feats_in_ * GEMM_CONV_SPARSE_MAX_PLANES) {
+      return false;
+    }
+    if (live_.empty()) {
+      live_.push_back(0);  // Keeps the GEMM non-empty, the output is the bias
+    }
 
+    const size_t live = live_.size();
+    sparse_input_.resize(live * plane);
+    for (size_t l = 0; l < live; l++) {
+      memcpy(sparse_input_.data() + l * plane, data + live_[l] * plane,
+        sizeof(float) * plane);
+    }
 
-    SpatialConvolutionGemm* ret = new SpatialConvolutionGemm(n_input_features,
-      n_output_features, filt_height, filt_width, padw, padh);
+    // Consecutive inputs of a layer mostly switch off the same planes, the
+    // weights are only gathered and packed again when that changes
+    if (live_ == live_packed_planes_ &&
+        live_packed_generation_ == weights_->generation()) {
+      return true;
+    }
+    const size_t filt = (size_t) filt_width_ * filt_height_;
+    const float* weights = weights_->getData();
+    std::vector<float> live_weights(feats_out_ * live * filt);
+    for (size_t o = 0; o < feats_out_; o++) {
+      for (size_t l = 0; l < live; l++) {
+        memcpy(live_weights.data() + (o * live + l) * filt,
+          weights + (o * feats_in_ + live_[l]) * filt, sizeof(float) * filt);
+      }
+    }
+    live_packed_->pack(live_weights.data(), (int) feats_out_, (int) (live * filt),
+      (int) (live * filt), 1);
+    live_packed_planes_ = live_;
+    live_packed_generation_ = weights_->generation();
+    return true;
+}
 
-    ret->setWeightsFromStream( stream );
-    ret->setBiasesFromStream( stream );
+void SpatialConvolutionGemm::packWeights() {
+    // [feats_out][feats_in * kh * kw], row major
+    const int k = (int) (feats_in_ * filt_height_ * filt_width_);
+    SAFE_DELETE(sparse_);
+    sparse_ = new Blas::BlockSparseMatrix();
+    sparse_->pack(weights_->getData(), (int) feats_out_, k, k, 1);
+    if (sparse_->density() * 100 > GEMM_CONV_SPARSE_MAX_DENSITY) {
+      SAFE_DELETE(sparse_);
+      packed_->pack(weights_->getData(), (int) feats_out_, k, k, 1);
+    } else {
+      packed_->clear();
+    }
+    packed_generation_ = weights_->generation();
+}
 
-    return ret;
+void SpatialConvolutionGemm::multiply(float* columns, const int ldcolumns,
+    const int pn, const Blas::PackedMatrix& weights, const int o0, const int on,
+    float* out, const int ldout) {
+    // The weights are packed once for the kernel, which reads the columns in
+    // place, so nothing is packed per call.  With an activation the product
+    // is computed GEMM_CONV_PANEL_PIXELS output pixels at a time and each
+    // panel is activated while it is still in cache.
+    const float* biases = biases_->getData();
+    const int step = activation_.none() ? pn : GEMM_CONV_PANEL_PIXELS;
+    for (int q0 = 0; q0 < pn; q0 += step) {
+      const int qn = std::min(step, pn - q0);
+      if (sparse_ != NULL) {
+        sparse_->multiply(columns + q0, ldcolumns, qn, biases, o0, on, out + q0, ldout);
+      } else {
+        weights.multiply(columns + q0, ldcolumns, qn, biases, o0, on, out + q0, ldout);
+      }
+      for (int o = 0; o < on && !activation_.none(); o++) {
+        activation_.apply(out + (size_t)o * ldout + q0, (size_t)qn);
+      }
+    }
 }
 
 }  // namespace mtorch
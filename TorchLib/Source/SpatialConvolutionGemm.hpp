@@ -7,10 +7,34 @@
 #pragma once
 #include <cstdint>                 // for uint32_t
 #include <string>                  // for istream
+#include <vector>                  // for vector
 
 #include "SpatialConvolution.hpp"  // for SpatialConvolution
 #include "Tensor.hpp"              // for Tensor
 
+// Output pixels per product when an activation is fused into the
+// convolution (see multiply)
+#define GEMM_CONV_PANEL_PIXELS 256
+// Upper bound for the columns workspace: im2col is run for as many output
+// rows at a time as fit (at least one), and each panel is multiplied before
+// the next one is built.
+#define GEMM_CONV_PANEL_BYTES (1 << 20)
+// With several threads: tasks per thread the work is split into (for load
+// balance), and the smallest block of output planes a task may be cut to.
+#define GEMM_CONV_TASKS_PER_THREAD 2
+#define GEMM_CONV_MIN_OUT_BLOCK 16
+// Input planes that are entirely zero (channels a ReLU switched off for the
+// input) are dropped from the GEMM when at most this percentage of the
+// planes is left
+#define GEMM_CONV_SPARSE_MAX_PLANES 75
+// Weights with at most this percentage of nonzero 4x4 blocks (pruned
+// layers) are multiplied in block-sparse form
+#define GEMM_CONV_SPARSE_MAX_DENSITY 50
+
+namespace Blas {
+class BlockSparseMatrix;
+class PackedMatrix;
+}
 
 namespace mtorch {
 
@@ -22,7 +46,8 @@ class TorchStage;
     // Constructor / Destructor
     SpatialConvolutionGemm(const uint32_t feats_in, const uint32_t feats_out,
       const uint32_t filt_height, const uint32_t filt_width,
-      const uint32_t padw = 0, const uint32_t padh = 0);
+      const uint32_t padw = 0, const uint32_t padh = 0,
+      const uint32_t dw = 1, const uint32_t dh = 1);
     virtual ~SpatialConvolutionGemm() override;
 
     virtual void forwardProp(TorchData& input, TorchData **output) override;
@@ -33,14 +58,63 @@ class TorchStage;
     virtual void setWeightsFromStream( InputStream & ) override;
     virtual void setBiasesFromStream( InputStream & ) override;
 
+    virtual uint64_t workspaceBytes(const uint32_t in_dim,
+      const uint32_t* in_size) const override;
+
     virtual Tensor<float>* weights() override { return weights_; }
     virtual Tensor<float>* biases() override { return biases_; }
 
-    static TorchStage* loadFromStream( InputStream & stream ) noexcept;
-
   protected:
 
-    void init(TorchData& input, TorchData **output, Tensor<float>** ones, Tensor<float>** columns);
+    void init(TorchData& input, TorchData **output);
+
+    // Threads used for a forward pass, each needs its own columns panel
+    uint32_t slots() const;
+    // Output rows per im2col panel
+    uint32_t panelRows(const uint32_t outputWidth, const uint32_t outputHeight) const;
+
+    // out[0 : on][0 : pn] = weights[o0 : o0 + on] * columns + biases
+    // (+ activation), where columns is k x pn with leading dimension
+    // ldcolumns and the planes of out are ldout apart.  With sparse_ the
+    // product is computed from it instead (weights are then the full
+    // weights).
+    void multiply(float* columns, const int ldcolumns, const int pn,
+      const Blas::PackedMatrix& weights, const int o0, const int on,
+      float* out, const int ldout);
+
+    // Finds the input planes that are not entirely zero.  If few enough
+    // are left, copies them to sparse_input_ and returns true.  Their
+    // weights are packed into live_packed_ only if the live planes or the
+    // weights generation differ from the last time.
+    bool compactPlanes(Tensor<float>& in);
+    // Packs the weights into sparse_ if they are sparse enough, into
+    // packed_ otherwise
+    void packWeights();
+
+    // 1x1, stride 1, unpadded: the columns buffer would be a copy of the
+    // input, so the input is used as the GEMM operand directly.
+    bool pointwise() const {
+      return filt_width_ == 1 && filt_height_ == 1 && padw_ == 0 &&
+        padh_ == 0 && dw_ == 1 && dh_ == 1;
+    }
+
+    // Workspaces are kept between calls and only reallocated when the input
+    // size changes, so steady state forwardProp does not allocate them.
+    std::vector<float> columns_;  // One panel per thread
+    std::vector<float> band_;  // Unpooled panel output per thread (if pooling)
+    std::vector<uint32_t> live_;  // Input planes that are not all zero
+    std::vector<float> sparse_input_;  // The live planes (if compacted)
+    Blas::PackedMatrix* live_packed_;  // Their weights, packed (if compacted)
+    std::vector<uint32_t> live_packed_planes_;  // The planes live_packed_ holds
+    uint64_t live_packed_generation_;  // weights_ generation it was built from
+    // The weights packed for the kernel: block-sparse (sparse_, NULL if the
+    // weights are too dense) or dense (packed_).  Rebuilt on the next
+    // forwardProp whenever the generation of the weights tensor changes
+    // (setWeights, Tensor::setData / copy, ...); in-place writes through
+    // weights()->getData() must be followed by weights()->markModified().
+    Blas::BlockSparseMatrix* sparse_;
+    Blas::PackedMatrix* packed_;
+    uint64_t packed_generation_;  // weights_ generation they were built from
 
     // Non-copyable, non-assignable.
     SpatialConvolutionGemm(SpatialConvolutionGemm&);
@@ -0,0 +1,351 @@
+#include <stddef.h>       // for NULL
+#include <string.h>       // for memcpy
+#include <algorithm>      // for max, min
+#include <stdexcept>      // for runtime_error
+
+#include "Blas.hpp"       // for im2colRows
+#include "Kernels/LayerKernels.hpp"  // for layerKernels
+#include "PackedMatrix.hpp" // for PackedMatrix
+#include "SpatialConvolutionFactory.hpp"
+#include "SpatialConvolutionGemm.hpp"  // for GEMM_CONV_PANEL_BYTES
+#include "SpatialConvolutionGrouped.hpp"
+#include "Tensor.hpp"     // for Tensor, TO_TENSOR_PTR
+#include "ThreadPool.hpp" // for ThreadPool
+#include "TorchData.hpp"  // for TorchData, TorchDataType
+
+namespace mtorch {
+class TorchStage;
+}  // namespace mtorch
+
+#define SAFE_DELETE(x) if (x != NULL) { delete x; x = NULL; }
+#define SAFE_DELETE_ARR(x) if (x != NULL) { delete[] x; x = NULL; }
+
+
+namespace mtorch {
+
+SpatialConvolutionGrouped::DepthwiseKernel SpatialConvolutionGrouped::depthwiseKernel(
+    const uint32_t filt_height, const uint32_t filt_width, const uint32_t dh,
+    const uint32_t dw) {
+    return layerKernels().depthwiseConv(filt_height, filt_width, dh, dw);
+}
+
+SpatialConvolutionGrouped::SpatialConvolutionGrouped(const uint32_t feats_in,
+    const uint32_t feats_out, const uint32_t filt_height,
+    const uint32_t filt_width, const uint32_t groups, const uint32_t padw,
+    const uint32_t padh, const uint32_t dw, const uint32_t dh) {
+
+    if (groups == 0 || feats_in % groups != 0 || feats_out % groups != 0) {
+      throw std::runtime_error("SpatialConvolutionGrouped::"
+        "SpatialConvolutionGrouped() - ERROR: feats_in and feats_out must be "
+        "multiples of groups!");
+    }
+
+    filt_width_ = filt_width;
+    filt_height_ = filt_height;
+    feats_in_ = feats_in;
+    feats_out_ = feats_out;
+    padw_ = padw;
+    padh_ = padh;
+    dw_ = dw;
+    dh_ = dh;
+    groups_ = groups;
+
+    kernel_ = depthwise() ? depthwiseKernel(filt_height, filt_width, dh, dw) : NULL;
+
+    uint32_t dim = 4;
+    uint32_t size[4] = {filt_width_, filt_height_, feats_in_ / groups_, feats_out_};
+
+    weights_ = new Tensor<float>(dim, size);
+    biases_ = new Tensor<float>(1, &feats_out_);
+    padded_ = NULL;
+    columns_ = NULL;
+    packed_ = new Blas::PackedMatrix();
+    packed_generation_ = 0;
+}
+
+SpatialConvolutionGrouped::~SpatialConvolutionGrouped() {
+    SAFE_DELETE(weights_);
+    SAFE_DELETE(biases_);
+    SAFE_DELETE(padded_);
+    SAFE_DELETE(columns_);
+    SAFE_DELETE(packed_);
+}
+
+void SpatialConvolutionGrouped::setWeights(const float* weights) {
+    weights_->setData(weights);
+}
+
+void SpatialConvolutionGrouped::setBiases(const float* biases) {
+    biases_->setData(biases);
+}
+
+void SpatialConvolutionGrouped::setWeightsFromStream( InputStream & stream )
+{
+    weights_->setDataFromStream( stream );
+}
+
+void SpatialConvolutionGrouped::setBiasesFromStream( InputStream & stream )
+{
+    biases_->setDataFromStream( stream );
+}
+
+uint32_t SpatialConvolutionGrouped::panelRows(const uint32_t outputWidth,
+    const uint32_t outputHeight) const {
+    const uint64_t row_bytes = sizeof(float) * (uint64_t)outputWidth *
+      (feats_in_ / groups_) * filt_width_ * filt_height_;
+    const uint64_t rows = std::max<uint64_t>(1, GEMM_CONV_PANEL_BYTES / row_bytes);
+    return (uint32_t)std::min<uint64_t>(rows, outputHeight);
+}
+
+uint64_t SpatialConvolutionGrouped::workspaceBytes(const uint32_t in_dim,
+    const uint32_t* in_size) const {
+    std::vector<uint32_t> out_size;
+    if (!convOutputSize(in_dim, in_size, out_size)) {
+      return 0;
+    }
+    if (depthwise()) {
+      if (padw_ == 0 && padh_ == 0) {
+        return 0;
+      }
+      return sizeof(float) * (uint64_t)(in_size[0] + 2 * padw_) *
+        (in_size[1] + 2 * padh_) * in_size[2];
+    }
+    if (pointwise()) {
+      return 0;
+    }
+    // columns, one panel of output rows of one group
+    return sizeof(float) * panelRows(out_size[0], out_size[1]) * out_size[0] *
+      (feats_in_ / groups_) * filt_width_ * filt_height_;
+}
+
+void SpatialConvolutionGrouped::init(TorchData& input, TorchData **output)  {
+    if (input.type() != TorchDataType::TENSOR_DATA) {
+      throw std::runtime_error("SpatialConvolutionGrouped::init() - "
+        "FloatTensor expected!");
+    }
+    Tensor<float>& in = (Tensor<float>&)input;
+    if (in.dim() != 3) {
+      throw std::runtime_error("SpatialConvolutionGrouped::init() - Input not 3D!");
+    }
+    if (in.size()[2] != feats_in_) {
+      throw std::runtime_error("SpatialConvolutionGrouped::init() - ERROR: "
+        "incorrect number of input features!");
+    }
+
+    const uint32_t inputWidth = in.size()[0];
+    const uint32_t inputHeight = in.size()[1];
+    const uint32_t outputWidth = (inputWidth + 2 * padw_ - filt_width_) / dw_ + 1;
+    const uint32_t outputHeight = (inputHeight + 2 * padh_ - filt_height_) / dh_ + 1;
+
+    // Resize output
+    uint32_t out_dim[3];
+    out_dim[0] = outputWidth;
+    out_dim[1] = outputHeight;
+    out_dim[2] = feats_out_;
+    *output = new Tensor<float>(3, out_dim);
+
+    if (depthwise()) {
+      // Resize the padded input (the zero border is written once)
+      if (padw_ != 0 || padh_ != 0) {
+        uint32_t padded_dim[3];
+        padded_dim[0] = inputWidth + 2 * padw_;
+        padded_dim[1] = inputHeight + 2 * padh_;
+        padded_dim[2] = feats_in_;
+        if (padded_ == NULL || padded_->size()[0] != padded_dim[0] ||
+            padded_->size()[1] != padded_dim[1]) {
+          SAFE_DELETE(padded_);
+          padded_ = new Tensor<float>(3, padded_dim);
+        }
+      }
+      return;
+    }
+
+    if (pointwise()) {
+      SAFE_DELETE(columns_);
+      return;
+    }
+
+    // Resize temporary columns (one panel of output rows of one group)
+    uint32_t columns_dim[2];
+    columns_dim[0] = panelRows(outputWidth, outputHeight) * outputWidth;
+    columns_dim[1] = (feats_in_ / groups_) * filt_width_ * filt_height_;
+    if (columns_ == NULL || columns_->size()[0] != columns_dim[0] ||
+        columns_->size()[1] != columns_dim[1]) {
+      SAFE_DELETE(columns_);
+      columns_ = new Tensor<float>(2, columns_dim);
+    }
+}
+
+void SpatialConvolutionGrouped::forwardProp(TorchData& input, TorchData **output) {
+
+    init(input, output);
+
+    Tensor<float>& in = (Tensor<float>&)input;
+    Tensor<float>* out = (Tensor<float>*)(*output);
+
+    if (depthwise()) {
+      forwardDepthwise(in, *out);
+    } else {
+      forwardGroups(in, *out);
+    }
+
+    if (pooled()) {
+      poolOutput(output);
+    }
+}
+
+void SpatialConvolutionGrouped::forwardDepthwise(Tensor<float>& in,
+    Tensor<float>& out) {
+    int inputWidth = (int) in.size()[0];
+    int inputHeight = (int) in.size()[1];
+    const int outputWidth = (int) out.size()[0];
+    const int outputHeight = (int) out.size()[1];
+    const int nInputPlane = (int) feats_in_;
+    const int nOutputPlane = (int) feats_out_;
+    const int multiplier = nOutputPlane / nInputPlane;
+    const int padw = (int) padw_;
+    const int padh = (int) padh_;
+
+    const float* src = in.getData();
+    if (padded_ != NULL) {
+      // Copy the interior; the border stays zero from the allocation
+      const int paddedWidth = inputWidth + 2 * padw;
+      const int paddedHeight = inputHeight + 2 * padh;
+      float* dst = padded_->getData();
+      for (int c = 0; c < nInputPlane; c++) {
+        for (int h = 0; h < inputHeight; h++) {
+          memcpy(dst + (c * paddedHeight + h + padh) * paddedWidth + padw,
+            src + (c * inputHeight + h) * inputWidth,
+            sizeof(float) * inputWidth);
+        }
+      }
+      src = dst;
+      inputWidth = paddedWidth;
+      inputHeight = paddedHeight;
+    }
+
+    const float* weights = weights_->getData();
+    const float* biases = biases_->getData();
+    float* dst = out.getData();
+    if (kernel_ != NULL) {
+      // Threads split the input planes (with their multiplier output planes)
+      Blas::ThreadPool& pool = Blas::ThreadPool::shared();
+      const int threads = (int) std::min<uint32_t>(threads_, pool.threads());
+      const int block = (nInputPlane + 2 * threads - 1) / (2 * threads);
+      const int in_plane = inputHeight * inputWidth;
+      const int out_plane = outputHeight * outputWidth;
+      const int filt = (int) (filt_width_ * filt_height_);
+      pool.parallelFor((nInputPlane + block - 1) / block, threads,
+        [&](const int task, const int) {
+        const int c0 = task * block;
+        const int o0 = c0 * multiplier;
+        kernel_(src + c0 * in_plane, inputHeight, inputWidth, weights + o0 * filt,
+          biases + o0, std::min(block, nInputPlane - c0) * multiplier, multiplier,
+          dst + o0 * out_plane, outputHeight, outputWidth, activation_);
+      });
+      return;
+    }
+
+    // Other filter sizes and strides
+    const int kH = (int) filt_height_;
+    const int kW = (int) filt_width_;
+    const int dH = (int) dh_;
+    const int dW = (int) dw_;
+    for (int o = 0; o < nOutputPlane; o++) {
+      const float* plane = src + (o / multiplier) * inputHeight * inputWidth;
+      const float* w = weights + o * kH * kW;
+      for (int oy = 0; oy < outputHeight; oy++) {
+        for (int ox = 0; ox < outputWidth; ox++) {
+          float acc = biases[o];
+          for (int ky = 0; ky < kH; ky++) {
+            const float* row = plane + (oy * dH + ky) * inputWidth + ox * dW;
+            for (int kx = 0; kx < kW; kx++) {
+              acc += w[ky * kW + kx] * row[kx];
+            }
+          }
+          dst[(o * outputHeight + oy) * outputWidth + ox] = activation_(acc);
+        }
+      }
+    }
+}
+
+void SpatialConvolutionGrouped::forwardGroups(Tensor<float>& in,
+    Tensor<float>& out) {
+    const int inputWidth = (int) in.size()[0];
+    const int inputHeight = (int) in.size()[1];
+    const int outputWidth = (int) out.size()[0];
+    const int outputHeight = (int) out.size()[1];
+    const int kH = (int) filt_height_;
+    const int kW = (int) filt_width_;
+    const int inGroup = (int) (feats_in_ / groups_);
+    const int outGroup = (int) (feats_out_ / groups_);
+    const int n = outputHeight * outputWidth;
+    const int k = inGroup * kH * kW;
+    const int rows = (int) panelRows(outputWidth, outputHeight);
+
+    if (packed_generation_ != weights_->generation()) {
+      packed_->pack(weights_->getData(), (int) feats_out_, k, k, 1);
+      packed_generation_ = weights_->generation();
+    }
+
+    // Per group and panel of output rows:
+    //   out (outGroup x pixels) = weights (outGroup x k) * columns (k x pixels)
+    for (uint32_t g = 0; g < groups_; g++) {
+      float* src = in.getData() + (size_t)g * inGroup * inputHeight * inputWidth;
+      float* dst = out.getData() + (size_t)g * outGroup * n;
+      for (int row0 = 0; row0 < outputHeight; row0 += rows) {
+        const int nrows = std::min(rows, outputHeight - row0);
+        const int pn = nrows * outputWidth;
+        // 1x1 layers: the group's input planes already are its columns
+        float* columns = src + row0 * outputWidth;
+        int ldcolumns = n;
+        if (!pointwise()) {
+          Blas::im2colRows(src, inGroup, inputHeight, inputWidth, kH, kW,
+            (int) padh_, (int) padw_, (int) dh_, (int) dw_, row0, nrows,
+            columns_->getData());
+          columns = columns_->getData();
+          ldcolumns = pn;
+        }
+        float* panel = dst + row0 * outputWidth;
+        packed_->multiply(columns, ldcolumns, pn, biases_->getData(),
+          (int) g * outGroup, outGroup, panel, n);
+        if (!activation_.none()) {
+          for (int o = 0; o < outGroup; o++) {
+            activation_.apply(panel + (size_t)o * n, (size_t)pn);
+          }
+        }
+      }
+    }
+}
+
+TorchStage* SpatialConvolutionGrouped::loadFromStream( InputStream & stream ) noexcept
+{
+    int32_t filt_width, filt_height, n_input_features, n_output_features,
+      padw, padh, dw, dh, groups;
+
+    filt_width = stream.read< int32_t >();
+    filt_height = stream.read< int32_t >();
+    n_input_features = stream.read< int32_t >();
+    n_output_features = stream.read< int32_t >();
+    padw = stream.read< int32_t >();
+    padh = stream.read< int32_t >();
+    dw = stream.read< int32_t >();
+    dh = stream.read< int32_t >();
+    groups = stream.read< int32_t >();
+
+    SpatialConvolution* ret;
+    if (groups == 1) {
+      ret = SpatialConvolutionFactory::create(n_input_features,
+        n_output_features, filt_height, filt_width, padw, padh, dw, dh);
+    } else {
+      ret = new SpatialConvolutionGrouped(n_input_features, n_output_features,
+        filt_height, filt_width, groups, padw, padh, dw, dh);
+    }
+
+    ret->setWeightsFromStream( stream );
+    ret->setBiasesFromStream( stream );
+
+    return ret;
+}
+
+}  // namespace mtorch
@@ -0,0 +1,99 @@
+//
+//  SpatialConvolutionGrouped.hpp
+//
+//  Grouped convolution: the input and output planes are split into groups
+//  and output group g only sees input group g.  Weights are
+//  [feats_out][feats_in / groups][kh][kw].  Depthwise layers (groups ==
+//  feats_in, one or more output planes per input plane) run a kernel
+//  specialized on filter size and stride that vectorizes across the output
+//  width; other group counts run one im2col + GEMM per group, with the
+//  columns built one bounded panel of output rows at a time and the
+//  weights packed up front as in SpatialConvolutionGemm.
+//
+//  Serialized as SPATIAL_CONVOLUTION_GROUPED_STAGE: kW, kH, nInputPlane,
+//  nOutputPlane, padW, padH, dW, dH, groups (int32), weights, biases.
+//
+
+#pragma once
+#include <cstdint>                 // for uint32_t
+#include <string>                  // for istream
+
+#include "Kernels/LayerKernels.hpp"  // for DepthwiseConvKernel
+#include "SpatialConvolution.hpp"  // for SpatialConvolution
+#include "Tensor.hpp"              // for Tensor
+
+#define DEPTHWISE_CONV_WIDTH_BLOCK 8
+
+namespace Blas {
+class PackedMatrix;
+}
+
+namespace mtorch {
+
+class TorchData;
+class TorchStage;
+
+  class SpatialConvolutionGrouped final : public SpatialConvolution {
+  public:
+    typedef DepthwiseConvKernel DepthwiseKernel;
+
+    // Constructor / Destructor
+    SpatialConvolutionGrouped(const uint32_t feats_in, const uint32_t feats_out,
+      const uint32_t filt_height, const uint32_t filt_width,
+      const uint32_t groups, const uint32_t padw = 0, const uint32_t padh = 0,
+      const uint32_t dw = 1, const uint32_t dh = 1);
+    virtual ~SpatialConvolutionGrouped() override;
+
+    virtual TorchStageType type() const override { return SPATIAL_CONVOLUTION_GROUPED_STAGE; }
+    virtual std::string name() const override { return "SpatialConvolutionGrouped"; }
+    virtual void forwardProp(TorchData& input, TorchData **output) override;
+
+    virtual void setWeights(const float* weights) override;
+    virtual void setBiases(const float* biases) override;
+
+    virtual void setWeightsFromStream( InputStream & ) override;
+    virtual void setBiasesFromStream( InputStream & ) override;
+
+    virtual uint64_t workspaceBytes(const uint32_t in_dim,
+      const uint32_t* in_size) const override;
+
+    virtual Tensor<float>* weights() override { return weights_; }
+    virtual Tensor<float>* biases() override { return biases_; }
+
+    uint32_t groups() const { return groups_; }
+    bool depthwise() const { return groups_ == feats_in_; }
+
+    // Returns the specialized depthwise kernel for a filter size and stride,
+    // NULL if there is none (the generic one is used then).
+    static DepthwiseKernel depthwiseKernel(const uint32_t filt_height,
+      const uint32_t filt_width, const uint32_t dh = 1, const uint32_t dw = 1);
+
+    // Grouped records with a single group are loaded as a dense convolution
+    static TorchStage* loadFromStream( InputStream & stream ) noexcept;
+
+  protected:
+    uint32_t groups_;
+    DepthwiseKernel kernel_;
+    Tensor<float>* padded_;   // Zero padded copy of the input (depthwise, if padding)
+    Tensor<float>* columns_;  // One panel of one group's columns (grouped)
+    // The weights as a feats_out x (feats_in / groups * kh * kw) matrix packed
+    // for the kernel (grouped), group g is its rows of output planes.
+    // Repacked whenever the generation of the weights tensor changes.
+    Blas::PackedMatrix* packed_;
+    uint64_t packed_generation_;  // weights_ generation packed_ was built from
+
+    void init(TorchData& input, TorchData **output);
+    bool pointwise() const {
+      return filt_width_ == 1 && filt_height_ == 1 && padw_ == 0 &&
+        padh_ == 0 && dw_ == 1 && dh_ == 1;
+    }
+    uint32_t panelRows(const uint32_t outputWidth, const uint32_t outputHeight) const;
+    void forwardDepthwise(Tensor<float>& in, Tensor<float>& out);
+    void forwardGroups(Tensor<float>& in, Tensor<float>& out);
+
+    // Non-copyable, non-assignable.
+    SpatialConvolutionGrouped(SpatialConvolutionGrouped&);
+    SpatialConvolutionGrouped& operator=(const SpatialConvolutionGrouped&);
+  };
+
+};  // namespace mtorch
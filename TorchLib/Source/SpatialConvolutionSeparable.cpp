@@ -0,0 +1,440 @@
+#include <math.h>         // for fabs, sqrt
+#include <stddef.h>       // for NULL
+#include <string.h>       // for memcpy
+#include <algorithm>      // for fill, max, min, sort
+#include <stdexcept>      // for runtime_error
+
+#include "Simd.hpp"       // for float4
+#include "SpatialConvolutionFactory.hpp"  // for heuristic
+#include "SpatialConvolutionSeparable.hpp"
+#include "Tensor.hpp"     // for Tensor, TO_TENSOR_PTR
+#include "ThreadPool.hpp" // for ThreadPool
+#include "TorchData.hpp"  // for TorchData, TorchDataType
+
+namespace mtorch {
+class TorchStage;
+}  // namespace mtorch
+
+#define SAFE_DELETE(x) if (x != NULL) { delete x; x = NULL; }
+#define SAFE_DELETE_ARR(x) if (x != NULL) { delete[] x; x = NULL; }
+
+
+namespace mtorch {
+
+namespace {
+
+// Eigen decomposition of the symmetric n x n matrix a by cyclic Jacobi
+// rotations.  On return the diagonal of a holds the eigenvalues and column
+// j of v the eigenvector of a[j][j].
+void jacobiEigen(std::vector<double>& a, std::vector<double>& v, const int n) {
+    v.assign(n * n, 0.0);
+    for (int i = 0; i < n; i++) {
+        v[i * n + i] = 1.0;
+    }
+    double norm = 0;
+    for (int i = 0; i < n * n; i++) {
+        norm += a[i] * a[i];
+    }
+    for (int sweep = 0; sweep < 64; sweep++) {
+        double off = 0;
+        for (int p = 0; p < n; p++) {
+            for (int q = p + 1; q < n; q++) {
+                off += a[p * n + q] * a[p * n + q];
+            }
+        }
+        if (off <= 1e-30 * norm) {
+            break;
+        }
+        for (int p = 0; p < n; p++) {
+            for (int q = p + 1; q < n; q++) {
+                const double apq = a[p * n + q];
+                if (apq == 0) {
+                    continue;
+                }
+                const double theta = (a[q * n + q] - a[p * n + p]) / (2 * apq);
+                const double t = (theta >= 0 ? 1.0 : -1.0) /
+                    (fabs(theta) + sqrt(theta * theta + 1));
+                const double c = 1 / sqrt(t * t + 1);
+                const double s = t * c;
+                for (int k = 0; k < n; k++) {
+                    const double akp = a[k * n + p];
+                    const double akq = a[k * n + q];
+                    a[k * n + p] = c * akp - s * akq;
+                    a[k * n + q] = s * akp + c * akq;
+                }
+                for (int k = 0; k < n; k++) {
+                    const double apk = a[p * n + k];
+                    const double aqk = a[q * n + k];
+                    a[p * n + k] = c * apk - s * aqk;
+                    a[q * n + k] = s * apk + c * aqk;
+                }
+                for (int k = 0; k < n; k++) {
+                    const double vkp = v[k * n + p];
+                    const double vkq = v[k * n + q];
+                    v[k * n + p] = c * vkp - s * vkq;
+                    v[k * n + q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+}
+
+// Squared singular values of a kh x kw filter slice w in decreasing order
+// (values) and the matching right singular vectors (vectors, one per row)
+void singularPairs(const float* w, const int kh, const int kw,
+    std::vector<double>& values, std::vector<double>& vectors) {
+    std::vector<double> a(kw * kw, 0.0);
+    for (int x1 = 0; x1 < kw; x1++) {
+        for (int x2 = 0; x2 < kw; x2++) {
+            double sum = 0;
+            for (int y = 0; y < kh; y++) {
+                sum += (double)w[y * kw + x1] * w[y * kw + x2];
+            }
+            a[x1 * kw + x2] = sum;
+        }
+    }
+    std::vector<double> v;
+    jacobiEigen(a, v, kw);
+
+    std::vector<int> order(kw);
+    for (int j = 0; j < kw; j++) {
+        order[j] = j;
+    }
+    std::sort(order.begin(), order.end(), [&](const int i, const int j) {
+        return a[i * kw + i] > a[j * kw + j];
+    });
+    values.resize(kw);
+    vectors.resize(kw * kw);
+    for (int j = 0; j < kw; j++) {
+        values[j] = std::max(0.0, a[order[j] * kw + order[j]]);
+        for (int x = 0; x < kw; x++) {
+            vectors[j * kw + x] = v[x * kw + order[j]];
+        }
+    }
+}
+
+}  // unnamed namespace
+
+SpatialConvolutionSeparable::SpatialConvolutionSeparable(const uint32_t feats_in,
+    const uint32_t feats_out, const uint32_t filt_height,
+    const uint32_t filt_width, const uint32_t rank, const uint32_t padw,
+    const uint32_t padh, const uint32_t dw, const uint32_t dh) {
+
+    filt_width_ = filt_width;
+    filt_height_ = filt_height;
+    feats_in_ = feats_in;
+    feats_out_ = feats_out;
+    padw_ = padw;
+    padh_ = padh;
+    dw_ = dw;
+    dh_ = dh;
+
+    if (rank == 0 || rank > std::min(filt_width, filt_height)) {
+      throw std::runtime_error("SpatialConvolutionSeparable::"
+        "SpatialConvolutionSeparable() - ERROR: invalid rank!");
+    }
+    rank_ = rank;
+
+    uint32_t dim = 4;
+    uint32_t size[4] = {filt_width_, filt_height_, feats_in_, feats_out_};
+
+    weights_ = new Tensor<float>(dim, size);
+    biases_ = new Tensor<float>(1, &feats_out_);
+    padded_ = NULL;
+    factorized_generation_ = 0;
+}
+
+SpatialConvolutionSeparable::~SpatialConvolutionSeparable() {
+    SAFE_DELETE(weights_);
+    SAFE_DELETE(biases_);
+    SAFE_DELETE(padded_);
+}
+
+void SpatialConvolutionSeparable::setWeights(const float* weights) {
+    weights_->setData(weights);
+}
+
+void SpatialConvolutionSeparable::setBiases(const float* biases) {
+    biases_->setData(biases);
+}
+
+void SpatialConvolutionSeparable::setWeightsFromStream( InputStream & stream )
+{
+    weights_->setDataFromStream( stream );
+}
+
+void SpatialConvolutionSeparable::setBiasesFromStream( InputStream & stream )
+{
+    biases_->setDataFromStream( stream );
+}
+
+uint32_t SpatialConvolutionSeparable::rank(const float* weights,
+    const uint32_t feats_in, const uint32_t feats_out,
+    const uint32_t filt_height, const uint32_t filt_width,
+    const float tolerance) {
+    const int kh = (int) filt_height;
+    const int kw = (int) filt_width;
+    const double tolerance_sq = (double) tolerance * tolerance;
+    uint32_t rank = 1;
+    std::vector<double> values, vectors;
+    for (uint32_t s = 0; s < feats_out * feats_in; s++) {
+      singularPairs(weights + s * kh * kw, kh, kw, values, vectors);
+      double total = 0;
+      for (int j = 0; j < kw; j++) {
+        total += values[j];
+      }
+      // The residual of a rank r approximation is the sum of the squared
+      // singular values it drops
+      double residual = total;
+      uint32_t r = 0;
+      while (r < (uint32_t) kw && residual > tolerance_sq * total) {
+        residual -= values[r++];
+      }
+      rank = std::max(rank, std::min(r, (uint32_t) std::min(kh, kw)));
+    }
+    return rank;
+}
+
+SpatialConvolutionSeparable* SpatialConvolutionSeparable::decompose(
+    SpatialConvolution& conv, const float tolerance) {
+    const uint32_t kh = conv.filtHeight();
+    const uint32_t kw = conv.filtWidth();
+    const uint32_t rank = SpatialConvolutionSeparable::rank(
+      conv.weights()->getData(), conv.featsIn(), conv.featsOut(), kh, kw,
+      tolerance);
+    if (rank * (kh + kw) * SEPARABLE_CONV_MIN_GAIN > kh * kw) {
+      return NULL;
+    }
+    // The FFT cost does not grow with the filter area, it is only beaten
+    // by rank 1 filters
+    if (rank > 1 && SpatialConvolutionFactory::heuristic(conv.featsIn(),
+        conv.featsOut(), kh, kw, conv.strideW(), conv.strideH()) ==
+        CONV_ALGORITHM_FFT) {
+      return NULL;
+    }
+    SpatialConvolutionSeparable* ret = new SpatialConvolutionSeparable(
+      conv.featsIn(), conv.featsOut(), kh, kw, rank, conv.padW(), conv.padH(),
+      conv.strideW(), conv.strideH());
+    ret->setWeights(conv.weights()->getData());
+    ret->setBiases(conv.biases()->getData());
+    ret->setActivation(conv.activation());
+    ret->setPooling(conv.poolW(), conv.poolH());
+    ret->setNumThreads(conv.numThreads());
+    return ret;
+}
+
+void SpatialConvolutionSeparable::factorize() {
+    const int kh = (int) filt_height_;
+    const int kw = (int) filt_width_;
+    const int taps = kh + kw;
+    const uint32_t slices = feats_out_ * feats_in_;
+    factors_.resize((size_t) slices * rank_ * taps);
+    factorized_generation_ = weights_->generation();
+    std::vector<double> values, vectors;
+    for (uint32_t s = 0; s < slices; s++) {
+      const float* w = weights_->getData() + s * kh * kw;
+      singularPairs(w, kh, kw, values, vectors);
+      for (uint32_t r = 0; r < rank_; r++) {
+        // u = W v is the left singular vector scaled by the singular value
+        const double* v = &vectors[r * kw];
+        float* f = &factors_[((size_t) s * rank_ + r) * taps];
+        for (int y = 0; y < kh; y++) {
+          double sum = 0;
+          for (int x = 0; x < kw; x++) {
+            sum += w[y * kw + x] * v[x];
+          }
+          f[y] = (float) sum;
+        }
+        for (int x = 0; x < kw; x++) {
+          f[kh + x] = (float) v[x];
+        }
+      }
+    }
+}
+
+uint32_t SpatialConvolutionSeparable::slots() const {
+    return std::min<uint32_t>(threads_, Blas::ThreadPool::shared().threads());
+}
+
+uint64_t SpatialConvolutionSeparable::workspaceBytes(const uint32_t in_dim,
+    const uint32_t* in_size) const {
+    std::vector<uint32_t> out_size;
+    if (!convOutputSize(in_dim, in_size, out_size)) {
+      return 0;
+    }
+    uint64_t bytes = sizeof(float) * (uint64_t) slots() *
+      ((out_size[1] - 1) * dh_ + filt_height_) * out_size[0];
+    if (padw_ != 0 || padh_ != 0) {
+      bytes += sizeof(float) * (uint64_t)(in_size[0] + 2 * padw_) *
+        (in_size[1] + 2 * padh_) * in_size[2];
+    }
+    return bytes;
+}
+
+void SpatialConvolutionSeparable::init(TorchData& input, TorchData **output)  {
+    if (input.type() != TorchDataType::TENSOR_DATA) {
+      throw std::runtime_error("SpatialConvolution::init() - "
+        "FloatTensor expected!");
+    }
+    Tensor<float>& in = (Tensor<float>&)input;
+    if (in.dim() != 3) {
+      throw std::runtime_error("SpatialConvolution::init() - Input not 3D!");
+    }
+    if (in.size()[2] != feats_in_) {
+      throw std::runtime_error("SpatialConvolution::init() - ERROR: "
+        "incorrect number of input features!");
+    }
+
+    const uint32_t inputWidth = in.size()[0];
+    const uint32_t inputHeight = in.size()[1];
+    const uint32_t outputWidth = (inputWidth + 2 * padw_ - filt_width_) / dw_ + 1;
+    const uint32_t outputHeight = (inputHeight + 2 * padh_ - filt_height_) / dh_ + 1;
+
+    // Resize output
+    uint32_t out_dim[3];
+    out_dim[0] = outputWidth;
+    out_dim[1] = outputHeight;
+    out_dim[2] = feats_out_;
+    *output = new Tensor<float>(3, out_dim);
+
+    if (factorized_generation_ != weights_->generation()) {
+      factorize();
+    }
+
+    // Input rows the vertical pass reads, filtered horizontally
+    rows_.resize((size_t) slots() * ((outputHeight - 1) * dh_ + filt_height_) *
+      outputWidth);
+
+    // Resize the padded input (the zero border is written once)
+    if (padw_ != 0 || padh_ != 0) {
+      uint32_t padded_dim[3];
+      padded_dim[0] = inputWidth + 2 * padw_;
+      padded_dim[1] = inputHeight + 2 * padh_;
+      padded_dim[2] = feats_in_;
+      if (padded_ == NULL || padded_->size()[0] != padded_dim[0] ||
+          padded_->size()[1] != padded_dim[1]) {
+        SAFE_DELETE(padded_);
+        padded_ = new Tensor<float>(3, padded_dim);
+      }
+    }
+}
+
+void SpatialConvolutionSeparable::forwardProp(TorchData& input, TorchData **output) {
+
+    init(input, output);
+
+    Tensor<float>& in = (Tensor<float>&)input;
+    Tensor<float>* out = (Tensor<float>*)(*output);
+
+    int inputWidth = (int) in.size()[0];
+    int inputHeight = (int) in.size()[1];
+    const uint32_t* out_size = TO_TENSOR_PTR(*output)->size();
+    const int outputWidth = (int) out_size[0];
+    const int outputHeight = (int) out_size[1];
+    const int nInputPlane = (int) feats_in_;
+    const int nOutputPlane = (int) feats_out_;
+    const int padw = (int) padw_;
+    const int padh = (int) padh_;
+    const int kH = (int) filt_height_;
+    const int kW = (int) filt_width_;
+    const int dW = (int) dw_;
+    const int dH = (int) dh_;
+    const int rank = (int) rank_;
+
+    const float* src = in.getData();
+    if (padded_ != NULL) {
+      // Copy the interior; the border stays zero from the allocation
+      const int paddedWidth = inputWidth + 2 * padw;
+      const int paddedHeight = inputHeight + 2 * padh;
+      float* dst = padded_->getData();
+      for (int c = 0; c < nInputPlane; c++) {
+        for (int h = 0; h < inputHeight; h++) {
+          memcpy(dst + (c * paddedHeight + h + padh) * paddedWidth + padw,
+            src + (c * inputHeight + h) * inputWidth,
+            sizeof(float) * inputWidth);
+        }
+      }
+      src = dst;
+      inputWidth = paddedWidth;
+      inputHeight = paddedHeight;
+    }
+
+    // Threads split the output planes, each filters into its own rows
+    const int n = outputHeight * outputWidth;
+    const int usedRows = (outputHeight - 1) * dH + kH;
+    const int threads = (int) slots();
+    using Blas::simd::float4;
+    Blas::ThreadPool::shared().parallelFor(nOutputPlane, threads,
+      [&](const int o, const int slot) {
+      float* rows = rows_.data() + (size_t) slot * usedRows * outputWidth;
+      float* out_plane = out->getData() + (size_t) o * n;
+      std::fill(out_plane, out_plane + n, biases_->getData()[o]);
+
+      for (int i = 0; i < nInputPlane; i++) {
+        const float* in_plane = src + (size_t) i * inputHeight * inputWidth;
+        for (int r = 0; r < rank; r++) {
+          const float* u = &factors_[(((size_t) o * nInputPlane + i) * rank + r) * (kH + kW)];
+          const float* v = u + kH;
+
+          // Horizontal pass: rows[y][ox] = sum_kx v[kx] * in[y][ox * dW + kx]
+          for (int y = 0; y < usedRows; y++) {
+            const float* in_row = in_plane + y * inputWidth;
+            float* row = rows + y * outputWidth;
+            int ox = 0;
+            if (dW == 1) {
+              for (; ox + SEPARABLE_CONV_WIDTH_BLOCK <= outputWidth; ox += SEPARABLE_CONV_WIDTH_BLOCK) {
+                float4 acc0 = Blas::simd::broadcast4(0.0f);
+                float4 acc1 = acc0;
+                for (int kx = 0; kx < kW; kx++) {
+                  const float4 c = Blas::simd::broadcast4(v[kx]);
+                  acc0 += c * Blas::simd::load4(in_row + ox + kx);
+                  acc1 += c * Blas::simd::load4(in_row + ox + kx + 4);
+                }
+                Blas::simd::store4(row + ox, acc0);
+                Blas::simd::store4(row + ox + 4, acc1);
+              }
+            }
+            for (; ox < outputWidth; ox++) {
+              float sum = 0;
+              for (int kx = 0; kx < kW; kx++) {
+                sum += v[kx] * in_row[ox * dW + kx];
+              }
+              row[ox] = sum;
+            }
+          }
+
+          // Vertical pass: out[oy][ox] += sum_ky u[ky] * rows[oy * dH + ky][ox]
+          for (int oy = 0; oy < outputHeight; oy++) {
+            float* out_row = out_plane + oy * outputWidth;
+            const float* row = rows + oy * dH * outputWidth;
+            int ox = 0;
+            for (; ox + SEPARABLE_CONV_WIDTH_BLOCK <= outputWidth; ox += SEPARABLE_CONV_WIDTH_BLOCK) {
+              float4 acc0 = Blas::simd::load4(out_row + ox);
+              float4 acc1 = Blas::simd::load4(out_row + ox + 4);
+              for (int ky = 0; ky < kH; ky++) {
+                const float4 c = Blas::simd::broadcast4(u[ky]);
+                acc0 += c * Blas::simd::load4(row + ky * outputWidth + ox);
+                acc1 += c * Blas::simd::load4(row + ky * outputWidth + ox + 4);
+              }
+              Blas::simd::store4(out_row + ox, acc0);
+              Blas::simd::store4(out_row + ox + 4, acc1);
+            }
+            for (; ox < outputWidth; ox++) {
+              float sum = out_row[ox];
+              for (int ky = 0; ky < kH; ky++) {
+                sum += u[ky] * row[ky * outputWidth + ox];
+              }
+              out_row[ox] = sum;
+            }
+          }
+        }
+      }
+      activation_.apply(out_plane, n);
+    });
+
+    if (pooled()) {
+      poolOutput(output);
+    }
+}
+
+}  // namespace mtorch
@@ -0,0 +1,97 @@
+//
+//  SpatialConvolutionSeparable.hpp
+//
+//  Convolution with low-rank filters.  Every (output, input) filter slice
+//  W (kh x kw) is replaced by its first rank singular vector pairs,
+//  W ~= sum_r u_r v_r^T, and applied as a kw tap horizontal pass followed
+//  by a kh tap vertical pass: rank * (kh + kw) instead of kh * kw
+//  multiply-adds per output pixel and slice.
+//
+//  The stage computes an approximation of the original convolution.
+//  decompose() only builds it when the smallest rank that reproduces every
+//  slice within a relative (Frobenius norm) tolerance saves enough work,
+//  Sequential::separateFilters runs it over a loaded model.  The factors
+//  are recomputed on the next forward pass whenever the generation of the
+//  weights tensor changes (setWeights, Tensor::setData / copy, ...).
+//  In-place writes through weights()->getData() must be followed by
+//  weights()->markModified().
+//
+
+#pragma once
+#include <cstdint>                 // for uint32_t
+#include <string>                  // for istream
+#include <vector>                  // for vector
+
+#include "SpatialConvolution.hpp"  // for SpatialConvolution
+#include "Tensor.hpp"              // for Tensor
+
+// decompose() only replaces layers whose multiply-adds drop by at least
+// this factor: the two 1D passes run at a lower rate than the dense
+// implementations they replace.
+#define SEPARABLE_CONV_MIN_GAIN 2
+// Output columns both passes keep in registers
+#define SEPARABLE_CONV_WIDTH_BLOCK 8
+
+namespace mtorch {
+
+class TorchData;
+class TorchStage;
+
+  class SpatialConvolutionSeparable final : public SpatialConvolution {
+  public:
+    // Constructor / Destructor
+    SpatialConvolutionSeparable(const uint32_t feats_in, const uint32_t feats_out,
+      const uint32_t filt_height, const uint32_t filt_width, const uint32_t rank,
+      const uint32_t padw = 0, const uint32_t padh = 0,
+      const uint32_t dw = 1, const uint32_t dh = 1);
+    virtual ~SpatialConvolutionSeparable() override;
+
+    virtual std::string name() const override { return "SpatialConvolutionSeparable"; }
+    virtual void forwardProp(TorchData& input, TorchData **output) override;
+
+    virtual void setWeights(const float* weights) override;
+    virtual void setBiases(const float* biases) override;
+
+    virtual void setWeightsFromStream( InputStream & ) override;
+    virtual void setBiasesFromStream( InputStream & ) override;
+
+    virtual uint64_t workspaceBytes(const uint32_t in_dim,
+      const uint32_t* in_size) const override;
+
+    virtual Tensor<float>* weights() override { return weights_; }
+    virtual Tensor<float>* biases() override { return biases_; }
+
+    uint32_t rank() const { return rank_; }
+
+    // Smallest rank that approximates every filter slice of weights
+    // ([feats_out][feats_in][filt_height][filt_width]) within tolerance
+    static uint32_t rank(const float* weights, const uint32_t feats_in,
+      const uint32_t feats_out, const uint32_t filt_height,
+      const uint32_t filt_width, const float tolerance);
+
+    // Returns a separable copy of conv (parameters, activation, pooling,
+    // threads), or NULL if the rank needed for tolerance does not save
+    // enough work (ranks above 1 do not beat the FFT layers).
+    static SpatialConvolutionSeparable* decompose(SpatialConvolution& conv,
+      const float tolerance);
+
+  protected:
+    uint32_t rank_;
+    // [feats_out][feats_in][rank][filt_height + filt_width]: the vertical
+    // taps (scaled by the singular value), then the horizontal taps
+    std::vector<float> factors_;
+    uint64_t factorized_generation_;  // weights_ generation factors_ was built from
+
+    Tensor<float>* padded_;  // Zero padded copy of the input (if padding)
+    std::vector<float> rows_;  // Horizontal pass output, one per thread
+
+    void init(TorchData& input, TorchData **output);
+    void factorize();
+    uint32_t slots() const;
+
+    // Non-copyable, non-assignable.
+    SpatialConvolutionSeparable(SpatialConvolutionSeparable&);
+    SpatialConvolutionSeparable& operator=(const SpatialConvolutionSeparable&);
+  };
+
+};  // namespace mtorch
@@ -0,0 +1,355 @@
+#include <math.h>         // for fabs
+#include <stddef.h>       // for NULL
+#include <string.h>       // for memcpy
+#include <algorithm>      // for swap
+#include <stdexcept>      // for runtime_error
+
+#include "Kernels/LayerKernels.hpp"  // for layerKernels
+#include "PackedMatrix.hpp" // for PackedMatrix
+#include "SpatialConvolutionWinograd.hpp"
+#include "Tensor.hpp"     // for Tensor, TO_TENSOR_PTR
+#include "TorchData.hpp"  // for TorchData, TorchDataType
+
+namespace mtorch {
+class TorchStage;
+}  // namespace mtorch
+
+#define SAFE_DELETE(x) if (x != NULL) { delete x; x = NULL; }
+#define SAFE_DELETE_ARR(x) if (x != NULL) { delete[] x; x = NULL; }
+
+
+namespace mtorch {
+
+namespace {
+
+// Builds the Winograd F(m, r) transforms from the Cook-Toom points
+// 0, 1, -1, 2, -2, ... and infinity (Lavin & Gray, "Fast Algorithms for
+// Convolutional Neural Networks").  AT and G are the usual evaluation
+// matrices; BT is then the unique matrix satisfying
+//   sum_j AT[i][j] * G[j][k] * BT[j][l] == (l == i + k)
+// for every output i, tap k and input l, which is solved for column by
+// column in double precision.
+void buildTransforms(const int m, const int r, std::vector<float>& AT,
+    std::vector<float>& G, std::vector<float>& BT) {
+    const int alpha = m + r - 1;
+    std::vector<double> points(alpha - 1);
+    for (int j = 0; j < alpha - 1; j++) {
+        points[j] = (j == 0) ? 0.0 : ((j + 1) / 2) * ((j % 2 == 1) ? 1.0 : -1.0);
+    }
+
+    std::vector<double> at(m * alpha, 0.0);
+    std::vector<double> g(alpha * r, 0.0);
+    for (int j = 0; j < alpha - 1; j++) {
+        double f = 1.0;
+        for (int l = 0; l < alpha - 1; l++) {
+            if (l != j) {
+                f *= points[j] - points[l];
+            }
+        }
+        double p = 1.0;
+        for (int i = 0; i < m; i++, p *= points[j]) {
+            at[i * alpha + j] = p;
+        }
+        p = 1.0;
+        for (int k = 0; k < r; k++, p *= points[j]) {
+            g[j * r + k] = p / f;
+        }
+    }
+    at[(m - 1) * alpha + alpha - 1] = 1.0;
+    g[(alpha - 1) * r + r - 1] = 1.0;
+
+    // Normal equations E^T E x = E^T b with E[(i,k)][j] = AT[i][j] * G[j][k]
+    std::vector<double> ete(alpha * alpha, 0.0);
+    for (int a = 0; a < alpha; a++) {
+        for (int b = 0; b < alpha; b++) {
+            for (int i = 0; i < m; i++) {
+                for (int k = 0; k < r; k++) {
+                    ete[a * alpha + b] += at[i * alpha + a] * g[a * r + k] *
+                        at[i * alpha + b] * g[b * r + k];
+                }
+            }
+        }
+    }
+
+    std::vector<double> bt(alpha * alpha, 0.0);
+    for (int l = 0; l < alpha; l++) {
+        std::vector<double> lhs(ete);
+        std::vector<double> x(alpha, 0.0);
+        for (int j = 0; j < alpha; j++) {
+            for (int i = 0; i < m; i++) {
+                const int k = l - i;
+                if (k >= 0 && k < r) {
+                    x[j] += at[i * alpha + j] * g[j * r + k];
+                }
+            }
+        }
+        // Gaussian elimination with partial pivoting
+        for (int c = 0; c < alpha; c++) {
+            int pivot = c;
+            for (int row = c + 1; row < alpha; row++) {
+                if (fabs(lhs[row * alpha + c]) > fabs(lhs[pivot * alpha + c])) {
+                    pivot = row;
+                }
+            }
+            for (int col = 0; col < alpha; col++) {
+                std::swap(lhs[c * alpha + col], lhs[pivot * alpha + col]);
+            }
+            std::swap(x[c], x[pivot]);
+            for (int row = 0; row < alpha; row++) {
+                if (row != c) {
+                    const double s = lhs[row * alpha + c] / lhs[c * alpha + c];
+                    for (int col = c; col < alpha; col++) {
+                        lhs[row * alpha + col] -= s * lhs[c * alpha + col];
+                    }
+                    x[row] -= s * x[c];
+                }
+            }
+        }
+        for (int j = 0; j < alpha; j++) {
+            bt[j * alpha + l] = x[j] / lhs[j * alpha + j];
+        }
+    }
+
+    // The points are exact small integers, so the solution is too (up to
+    // rounding); snap it so the float transforms carry no solver noise.
+    for (size_t i = 0; i < bt.size(); i++) {
+        bt[i] = floor(bt[i] * 1024.0 + 0.5) / 1024.0;
+    }
+
+    AT.assign(at.begin(), at.end());
+    G.assign(g.begin(), g.end());
+    BT.assign(bt.begin(), bt.end());
+}
+
+}  // unnamed namespace
+
+bool SpatialConvolutionWinograd::supports(const uint32_t filt_height,
+    const uint32_t filt_width, const uint32_t tile) {
+    if (filt_height != filt_width) {
+        return false;
+    }
+    return (filt_width == 3 && (tile == 2 || tile == 4)) ||
+        (filt_width == 5 && tile == 2);
+}
+
+SpatialConvolutionWinograd::SpatialConvolutionWinograd(const uint32_t feats_in,
+    const uint32_t feats_out, const uint32_t filt_height,
+    const uint32_t filt_width, const uint32_t padw, const uint32_t padh,
+    const uint32_t tile) {
+
+    filt_width_ = filt_width;
+    filt_height_ = filt_height;
+    feats_in_ = feats_in;
+    feats_out_ = feats_out;
+    padw_ = padw;
+    padh_ = padh;
+
+    if (!supports(filt_height, filt_width, tile)) {
+      throw std::runtime_error("SpatialConvolutionWinograd::"
+        "SpatialConvolutionWinograd() - ERROR: unsupported filter / tile size!");
+    }
+    tile_ = tile;
+    alpha_ = tile + filt_width - 1;
+    buildTransforms((int)tile_, (int)filt_width_, AT_, G_, BT_);
+
+    uint32_t dim = 4;
+    uint32_t size[4] = {filt_width_, filt_height_, feats_in_, feats_out_};
+
+    weights_ = new Tensor<float>(dim, size);
+    biases_ = new Tensor<float>(1, &feats_out_);
+    padded_ = NULL;
+    padded_width_ = 0;
+    padded_height_ = 0;
+    U_ = new Blas::PackedMatrix();
+    transformed_generation_ = 0;
+}
+
+SpatialConvolutionWinograd::~SpatialConvolutionWinograd() {
+    SAFE_DELETE(weights_);
+    SAFE_DELETE(biases_);
+    SAFE_DELETE(padded_);
+    SAFE_DELETE(U_);
+}
+
+void SpatialConvolutionWinograd::setWeights(const float* weights) {
+    weights_->setData(weights);
+}
+
+void SpatialConvolutionWinograd::setBiases(const float* biases) {
+    biases_->setData(biases);
+}
+
+void SpatialConvolutionWinograd::setWeightsFromStream( InputStream & stream )
+{
+    weights_->setDataFromStream( stream );
+}
+
+void SpatialConvolutionWinograd::setBiasesFromStream( InputStream & stream )
+{
+    biases_->setDataFromStream( stream );
+}
+
+void SpatialConvolutionWinograd::transformFilters() {
+    const int A = (int)alpha_;
+    const int R = (int)filt_width_;
+    const int nIn = (int)feats_in_;
+    const int nOut = (int)feats_out_;
+    const int ustride = nOut * nIn;
+    const float* w = weights_->getData();
+
+    std::vector<float> U((size_t)A * A * ustride);
+    std::vector<float> tmp(A * R);
+    for (int o = 0; o < nOut; o++) {
+        for (int c = 0; c < nIn; c++) {
+            // Torch filter layout is [feats_out][feats_in][kh][kw]
+            const float* g = w + (o * nIn + c) * R * R;
+            for (int a = 0; a < A; a++) {
+                for (int x = 0; x < R; x++) {
+                    float s = 0;
+                    for (int y = 0; y < R; y++) {
+                        s += G_[a * R + y] * g[y * R + x];
+                    }
+                    tmp[a * R + x] = s;
+                }
+            }
+            for (int a = 0; a < A; a++) {
+                for (int b = 0; b < A; b++) {
+                    float s = 0;
+                    for (int x = 0; x < R; x++) {
+                        s += tmp[a * R + x] * G_[b * R + x];
+                    }
+                    U[(a * A + b) * ustride + o * nIn + c] = s;
+                }
+            }
+        }
+    }
+    U_->pack(U.data(), A * A * nOut, nIn, nIn, 1);
+    transformed_generation_ = weights_->generation();
+}
+
+uint64_t SpatialConvolutionWinograd::workspaceBytes(const uint32_t in_dim,
+    const uint32_t* in_size) const {
+    if (in_dim != 3) {
+      return 0;
+    }
+    const uint64_t outputWidth = in_size[0] - filt_width_ + 1 + 2 * padw_;
+    const uint64_t outputHeight = in_size[1] - filt_height_ + 1 + 2 * padh_;
+    const uint64_t tilesW = (outputWidth + tile_ - 1) / tile_;
+    const uint64_t tilesH = (outputHeight + tile_ - 1) / tile_;
+    const uint64_t padded = (tilesW * tile_ + filt_width_ - 1) *
+      (tilesH * tile_ + filt_height_ - 1) * feats_in_;
+    return sizeof(float) * (padded +
+      (uint64_t)alpha_ * alpha_ * tilesW * tilesH * (feats_in_ + feats_out_));
+}
+
+void SpatialConvolutionWinograd::init(TorchData& input, TorchData **output)  {
+    if (input.type() != TorchDataType::TENSOR_DATA) {
+      throw std::runtime_error("SpatialConvolution::init() - "
+        "FloatTensor expected!");
+    }
+    Tensor<float>& in = (Tensor<float>&)input;
+    if (in.dim() != 3) {
+      throw std::runtime_error("SpatialConvolution::init() - Input not 3D!");
+    }
+    if (in.size()[2] != feats_in_) {
+      throw std::runtime_error("SpatialConvolution::init() - ERROR: "
+        "incorrect number of input features!");
+    }
+
+    const uint32_t inputWidth = in.size()[0];
+    const uint32_t inputHeight = in.size()[1];
+    const uint32_t outputWidth = inputWidth - filt_width_ + 1 + 2 * padw_;
+    const uint32_t outputHeight = inputHeight - filt_height_ + 1 + 2 * padh_;
+
+    // Resize output
+    uint32_t out_dim[3];
+    out_dim[0] = outputWidth;
+    out_dim[1] = outputHeight;
+    out_dim[2] = feats_out_;
+    *output = new Tensor<float>(3, out_dim);
+
+    // Resize the padded input.  It covers whole tiles, everything outside
+    // the copied interior is zero.  A different input can round up to the
+    // same buffer, its border then holds the previous input's pixels and is
+    // cleared again.
+    const uint32_t tilesW = (outputWidth + tile_ - 1) / tile_;
+    const uint32_t tilesH = (outputHeight + tile_ - 1) / tile_;
+    uint32_t padded_dim[3];
+    padded_dim[0] = tilesW * tile_ + filt_width_ - 1;
+    padded_dim[1] = tilesH * tile_ + filt_height_ - 1;
+    padded_dim[2] = feats_in_;
+    if (padded_ == NULL || padded_->size()[0] != padded_dim[0] ||
+        padded_->size()[1] != padded_dim[1]) {
+      SAFE_DELETE(padded_);
+      padded_ = new Tensor<float>(3, padded_dim);
+    } else if (padded_width_ != inputWidth || padded_height_ != inputHeight) {
+      Tensor<float>::zero(*padded_);
+    }
+    padded_width_ = inputWidth;
+    padded_height_ = inputHeight;
+
+    const size_t tiles = (size_t)tilesW * tilesH;
+    V_.resize((size_t)alpha_ * alpha_ * feats_in_ * tiles);
+    M_.resize((size_t)alpha_ * alpha_ * feats_out_ * tiles);
+
+    if (transformed_generation_ != weights_->generation()) {
+      transformFilters();
+    }
+}
+
+void SpatialConvolutionWinograd::forwardProp(TorchData& input, TorchData **output) {
+
+    init(input, output);
+
+    Tensor<float>& in = (Tensor<float>&)input;
+    Tensor<float>* out = (Tensor<float>*)(*output);
+
+    const int inputWidth = (int) in.size()[0];
+    const int inputHeight = (int) in.size()[1];
+    const uint32_t* out_size = TO_TENSOR_PTR(*output)->size();
+    const int outputWidth = (int) out_size[0];
+    const int outputHeight = (int) out_size[1];
+    const int nInputPlane = (int) feats_in_;
+    const int nOutputPlane = (int) feats_out_;
+    const int paddedWidth = (int) padded_->size()[0];
+    const int paddedHeight = (int) padded_->size()[1];
+    const int tile = (int) tile_;
+    const int tilesW = (outputWidth + tile - 1) / tile;
+    const int tilesH = (outputHeight + tile - 1) / tile;
+    const int tiles = tilesW * tilesH;
+    const int A = (int) alpha_;
+
+    // Copy the interior into the padded buffer
+    const float* src = in.getData();
+    float* padded = padded_->getData();
+    for (int c = 0; c < nInputPlane; c++) {
+      for (int h = 0; h < inputHeight; h++) {
+        memcpy(padded + (c * paddedHeight + h + padh_) * paddedWidth + padw_,
+          src + (c * inputHeight + h) * inputWidth,
+          sizeof(float) * inputWidth);
+      }
+    }
+
+    const LayerKernels& kernels = layerKernels();
+    kernels.winogradInput(tile, A)(padded, paddedHeight, paddedWidth,
+      nInputPlane, tilesH, tilesW, BT_.data(), V_.data());
+
+    // One GEMM per transformed element: M[xi] = U[xi] * V[xi], (feats_out x
+    // tiles) = (feats_out x feats_in) * (feats_in x tiles), with U[xi] rows
+    // xi * feats_out onwards of the packed filters.
+    for (int xi = 0; xi < A * A; xi++) {
+      U_->multiply(V_.data() + (size_t)xi * nInputPlane * tiles, tiles, tiles,
+        NULL, xi * nOutputPlane, nOutputPlane,
+        M_.data() + (size_t)xi * nOutputPlane * tiles, tiles);
+    }
+
+    kernels.winogradOutput(tile, A)(M_.data(), nOutputPlane, tilesH, tilesW,
+      AT_.data(), biases_->getData(), out->getData(), outputHeight,
+      outputWidth, activation_);
+
+    if (pooled()) {
+      poolOutput(output);
+    }
+}
+
+}  // namespace mtorch
@@ -0,0 +1,94 @@
+//
+//  SpatialConvolutionWinograd.hpp
+//
+//  Winograd minimal filtering F(m x m, r x r) for stride 1 convolutions:
+//  F(2x2,3x3), F(4x4,3x3) and F(2x2,5x5).  The filters are transformed once
+//  (U = G g G^T), every input tile is transformed (V = B^T d B), the
+//  products are computed as alpha^2 batched GEMMs over the channels in the
+//  transformed domain and the results are transformed back (Y = A^T M A).
+//
+//  The transforms are generated from Cook-Toom interpolation points
+//  (0, +-1, +-2, inf).  Compared with im2col + GEMM on the same data the
+//  outputs agree to ~1e-5 relative error for F(2x2,3x3) and F(2x2,5x5) and
+//  ~1e-4 for F(4x4,3x3), which has the larger transform constants.
+//
+//  The transformed filters are packed for the product kernel (see
+//  Blas::PackedMatrix), so the GEMMs pack nothing per call.  They are
+//  recomputed lazily on the next forward pass whenever the generation of
+//  the weights tensor changes (setWeights, Tensor::setData / copy, ...).
+//  In-place writes through weights()->getData() must be followed by
+//  weights()->markModified().
+//
+
+#pragma once
+#include <cstdint>                 // for uint32_t
+#include <string>                  // for istream
+#include <vector>                  // for vector
+
+#include "SpatialConvolution.hpp"  // for SpatialConvolution
+#include "Tensor.hpp"              // for Tensor
+
+namespace Blas {
+class PackedMatrix;
+}
+
+namespace mtorch {
+
+class TorchData;
+class TorchStage;
+
+  class SpatialConvolutionWinograd final : public SpatialConvolution {
+  public:
+    // Constructor / Destructor
+    // tile is the output tile size m (2 or 4 for 3x3 filters, 2 for 5x5).
+    SpatialConvolutionWinograd(const uint32_t feats_in, const uint32_t feats_out,
+      const uint32_t filt_height, const uint32_t filt_width,
+      const uint32_t padw = 0, const uint32_t padh = 0,
+      const uint32_t tile = 2);
+    virtual ~SpatialConvolutionWinograd() override;
+
+    virtual std::string name() const override { return "SpatialConvolutionWinograd"; }
+    virtual void forwardProp(TorchData& input, TorchData **output) override;
+
+    virtual void setWeights(const float* weights) override;
+    virtual void setBiases(const float* biases) override;
+
+    virtual void setWeightsFromStream( InputStream & ) override;
+    virtual void setBiasesFromStream( InputStream & ) override;
+
+    virtual uint64_t workspaceBytes(const uint32_t in_dim,
+      const uint32_t* in_size) const override;
+
+    virtual Tensor<float>* weights() override { return weights_; }
+    virtual Tensor<float>* biases() override { return biases_; }
+
+    static bool supports(const uint32_t filt_height, const uint32_t filt_width,
+      const uint32_t tile);
+
+  protected:
+    uint32_t tile_;   // m
+    uint32_t alpha_;  // m + r - 1, the transformed tile size
+
+    std::vector<float> AT_;  // m x alpha
+    std::vector<float> G_;   // alpha x r
+    std::vector<float> BT_;  // alpha x alpha
+
+    // Transformed filters, [alpha^2 * feats_out] x feats_in packed
+    Blas::PackedMatrix* U_;
+    uint64_t transformed_generation_;  // weights_ generation U_ was computed from
+
+    Tensor<float>* padded_;  // Zero padded input, rounded up to whole tiles
+    uint32_t padded_width_;   // Input width / height padded_ was zeroed
+    uint32_t padded_height_;  // around
+    std::vector<float> V_;  // Transformed input [alpha^2][feats_in][tiles]
+    std::vector<float> M_;  // Products [alpha^2][feats_out][tiles]
+
+    void init(TorchData& input, TorchData **output);
+    void transformFilters();
+
+    // Non-copyable, non-assignable.
+    SpatialConvolutionWinograd(SpatialConvolutionWinograd&);
+    SpatialConvolutionWinograd& operator=(const SpatialConvolutionWinograd&);
+  };
+
+};  // namespace mtorch
@@ -38,6 +38,12 @@ namespace mtorch {
     Tensor<float>::mul(*TO_TENSOR_PTR(*output), 1 - p_);
   }
 
+  bool SpatialDropout::outputSize(const uint32_t in_dim, const uint32_t* in_size,
+    std::vector<uint32_t>& out_size) const {
+    out_size.assign(in_size, in_size + in_dim);
+    return true;
+  }
+
   TorchStage* SpatialDropout::loadFromStream( InputStream & stream ) noexcept
   {
     float p = stream.read< float >();
@@ -26,6 +26,8 @@ class TorchData;
     virtual TorchStageType type() const { return SPATIAL_DROPOUT; }
     virtual std::string name() const { return "SpatialDropout"; }
     virtual void forwardProp(TorchData& input, TorchData **output);
+    virtual bool outputSize(const uint32_t in_dim, const uint32_t* in_size,
+      std::vector<uint32_t>& out_size) const;
 
     static TorchStage* loadFromStream( InputStream & stream ) noexcept;
 
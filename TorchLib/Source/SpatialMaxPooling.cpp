@@ -113,6 +113,18 @@ namespace mtorch {
 
   }
 
+  bool SpatialMaxPooling::outputSize(const uint32_t in_dim,
+    const uint32_t* in_size, std::vector<uint32_t>& out_size) const {
+    if ((in_dim != 2 && in_dim != 3) || in_size[0] % kw_ != 0 ||
+        in_size[1] % kh_ != 0) {
+      return false;
+    }
+    out_size.assign(in_size, in_size + in_dim);
+    out_size[0] = in_size[0] / kw_;
+    out_size[1] = in_size[1] / kh_;
+    return true;
+  }
+
   TorchStage* SpatialMaxPooling::loadFromStream( InputStream & stream ) noexcept
   {
     int kw, kh, dw, dh, padw, padh;
@@ -25,6 +25,11 @@ class TorchData;
     virtual TorchStageType type() const { return SPATIAL_MAX_POOLING_STAGE; }
     virtual std::string name() const { return "SpatialMaxPooling"; }
     virtual void forwardProp(TorchData& input, TorchData **output);
+    virtual bool outputSize(const uint32_t in_dim, const uint32_t* in_size,
+      std::vector<uint32_t>& out_size) const;
+
+    uint32_t poolW() const { return kw_; }
+    uint32_t poolH() const { return kh_; }
 
     static TorchStage* loadFromStream( InputStream & stream ) noexcept;
 
@@ -41,6 +41,12 @@ namespace mtorch {
 	}   
   }
 
+  bool Tanh::outputSize(const uint32_t in_dim, const uint32_t* in_size,
+    std::vector<uint32_t>& out_size) const {
+    out_size.assign(in_size, in_size + in_dim);
+    return true;
+  }
+
   TorchStage* Tanh::loadFromStream( InputStream & ) noexcept
   {
     // Nothing to do for Tanh
@@ -13,10 +13,13 @@
 
 #include "Utils/InputStream.hpp"
 
+#include <atomic>
 #include <iomanip>
 #include <iostream>
 #include <cfloat>
 #include <cmath>
+#include <cstring>
+#include <stdexcept>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -36,6 +39,11 @@ namespace mtorch {
     Tensor(const int dim, const int* size, float *data);
     virtual ~Tensor();
 
+    // Wrap returns a tensor header on top of externally owned memory (for
+    // instance a memory mapped TensorArchive).  The returned tensor never
+    // frees data, so data must outlive it.  The caller owns the header.
+    static Tensor<T>* wrap(const uint32_t dim, const uint32_t* size, T* data);
+
     virtual TorchDataType type() const { return TENSOR_DATA; }
 
 	// setData and getData are EXPENSIVE --> They require a CPU to GPU copy
@@ -44,11 +52,21 @@ namespace mtorch {
     void setDataFromStream( InputStream & stream );
 	T* getData();
 
+    // Generation changes whenever the contents are written through this
+    // class (setData, setDataAt, copy, the math operations, ...).  Values
+    // are never reused, by this or any other tensor, and are never 0, so
+    // data derived from a tensor (packed or transformed weights) can be
+    // cached against it.  Writes through getData() must be followed by
+    // markModified().
+    uint64_t generation() const { return generation_; }
+    void markModified() { generation_ = nextGeneration(); }
+
     // View returns a new view on the same object.  The caller owns the new
     // memory (ie, it is transferred).
     Tensor<T>* view(const uint32_t dim, const uint32_t* size);
 
     uint32_t dim() const { return dim_; }
+    bool ownsData() const { return owns_data_; }
     const uint32_t* size() const { return size_; }
     bool isSameSizeAs(const Tensor<T>& src) const;
 
@@ -81,9 +99,16 @@ namespace mtorch {
 
   protected:
 	T* data_;
+    bool owns_data_;
     uint32_t dim_;
     uint32_t* size_;  // size_[0] is lowest contiguous dimension,
                       // size_[2] is highest dimension
+    uint64_t generation_;
+
+    static std::atomic<uint64_t> next_generation_;
+    static uint64_t nextGeneration() {
+      return next_generation_.fetch_add(1, std::memory_order_relaxed);
+    }
 
     Tensor();  // Default constructor used internally (in view function)
 
@@ -92,12 +117,18 @@ namespace mtorch {
     Tensor& operator=(const Tensor&);
   };
 
+  // Constant initialized, so there is no static guard involved
+  template <typename T>
+  std::atomic<uint64_t> Tensor<T>::next_generation_(1);
+
   template <typename T>
   Tensor<T>::Tensor(const uint32_t dim, const uint32_t* size) {
     this->dim_ = dim;
     this->size_ = new uint32_t[dim];
     memcpy(this->size_, size, sizeof(this->size_[0]) * dim);
 	this->data_ = new T[this->nelems()]();
+    this->owns_data_ = true;
+    this->generation_ = nextGeneration();
   }
 
   template <typename T>
@@ -106,6 +137,7 @@ namespace mtorch {
     this->size_ = new uint32_t[dim];
     memcpy(this->size_, size, sizeof(this->size_[0]) * dim);
     this->data_ = NULL;
+    this->owns_data_ = true;
     setData(data);
   }
 
@@ -136,6 +168,19 @@ namespace mtorch {
     dim_ = 0;
     size_ = NULL;
     data_ = NULL;
+    owns_data_ = true;
+    generation_ = nextGeneration();
+  }
+
+  template <typename T>
+  Tensor<T>* Tensor<T>::wrap(const uint32_t dim, const uint32_t* size, T* data) {
+    Tensor<T>* ret = new Tensor<T>();
+    ret->dim_ = dim;
+    ret->size_ = new uint32_t[dim];
+    memcpy(ret->size_, size, sizeof(ret->size_[0]) * dim);
+    ret->data_ = data;
+    ret->owns_data_ = false;
+    return ret;
   }
 
   template <typename T>
@@ -143,7 +188,7 @@ namespace mtorch {
     if (size_ != NULL) {
       delete[] size_;
     }
-    if (data_ != NULL){
+    if (data_ != NULL && owns_data_){
       delete[] data_;
 	}
   }
@@ -183,27 +228,31 @@ namespace mtorch {
 
   template <typename T>
   void Tensor<T>::setData(const T* data) {
-      if (this->data_ != NULL){
+      if (this->data_ != NULL && this->owns_data_){
 		  delete[] this->data_;
 	  }
 	  this->data_ = new T[this->nelems()];
+	  this->owns_data_ = true;
 	  memcpy(this->data_, data, sizeof(this->data_[0]) * this->nelems());
+	  markModified();
   }
 
 template< typename T >
 void Tensor<T>::setDataFromStream( InputStream & stream )
 {
-    if (this->data_ != NULL){
+    if (this->data_ != NULL && this->owns_data_){
         delete[] this->data_;
     }
     this->data_ = new T[ this->nelems() ];
+    this->owns_data_ = true;
     stream.readArray( this->data_, this->nelems() );
-
+    markModified();
 }
 
   template <typename T>
   void Tensor<T>::setDataAt(const T data, int index){
 	  this->data_[index] = data;
+	  markModified();
   }
 
   template <typename T>
@@ -407,10 +456,12 @@ void Tensor<T>::setDataFromStream( InputStream & stream )
     uint32_t nelem = dst.nelems();
 	T* src1 = x.getData();
 	T* src2 = y.getData();
+	T* data = dst.getData();
 	for (uint32_t i = 0; i < nelem; i++)
 	{
-		dst.setDataAt(src1[i] + src2[i], i);
+		data[i] = src1[i] + src2[i];
 	}
+	dst.markModified();
   }
 
   template <typename T>
@@ -419,8 +470,9 @@ void Tensor<T>::setDataFromStream( InputStream & stream )
 	  T* data = x.getData();
 	  for (uint32_t i = 0; i < nelem; i++)
 	  {
-		  x.setDataAt(data[i] * mul_val, i);
+		  data[i] = data[i] * mul_val;
 	  }
+	  x.markModified();
   }
 
   template <typename T>
@@ -429,8 +481,9 @@ void Tensor<T>::setDataFromStream( InputStream & stream )
 	  T* data = x.getData();
 	  for (uint32_t i = 0; i < nelem; i++)
 	  {
-		  x.setDataAt(data[i] / div_val, i);
+		  data[i] = data[i] / div_val;
 	  }
+	  x.markModified();
   }
 
   template <typename T>
@@ -440,8 +493,9 @@ void Tensor<T>::setDataFromStream( InputStream & stream )
 	  T* addition = src.getData();
 	  for (uint32_t i = 0; i < nelem; i++)
 	  {
-		  dst.setDataAt(base[i] + addition[i], i);
+		  base[i] = base[i] + addition[i];
 	  }
+	  dst.markModified();
   }
 
   template <typename T>
@@ -463,9 +517,11 @@ void Tensor<T>::setDataFromStream( InputStream & stream )
 	template <typename T>
 	void Tensor<T>::fill(Tensor<T>& dst, float value) {
 		int32_t nelems = dst.nelems();
+		T* data = dst.getData();
 		for (int32_t i = 0; i < nelems; i++) {
-			dst.setDataAt(value, i);
+			data[i] = (T)value;
 		}
+		dst.markModified();
 	}
 
   template <typename T>
@@ -485,10 +541,9 @@ void Tensor<T>::setDataFromStream( InputStream & stream )
       }
       new_tensor = new Tensor<T>(dim, size);
 
-      T* data = new T[new_tensor->nelems()];
-      ifile.read((char*)(data), sizeof(data[0]) * new_tensor->nelems());
-      new_tensor->setData(data);
-      delete[] data;
+      // Read straight into the tensor storage (no temporary copy)
+      ifile.read((char*)(new_tensor->getData()),
+        sizeof(T) * new_tensor->nelems());
       ifile.close();
       delete[] size;
     } else {
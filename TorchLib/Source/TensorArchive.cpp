@@ -0,0 +1,290 @@
+#include <stddef.h>       // for NULL
+#include <cstring>        // for memcpy, memcmp
+#include <fstream>        // for ifstream, ofstream
+#include <limits>         // for numeric_limits
+#include <sstream>        // for stringstream
+#include <stdexcept>      // for runtime_error
+
+#ifdef _WIN32
+#include <malloc.h>       // for _aligned_malloc, _aligned_free
+#else
+#include <fcntl.h>        // for open
+#include <sys/mman.h>     // for mmap, munmap
+#include <sys/stat.h>     // for fstat
+#include <unistd.h>       // for close
+#endif
+
+#include "TensorArchive.hpp"
+#include "Tensor.hpp"     // for Tensor
+
+namespace mtorch {
+
+  namespace {
+
+    const char kMagic[4] = {'M', 'T', 'A', 'R'};
+    const uint32_t kVersion = 1;
+    const size_t kHeaderSize = 4 * sizeof(uint32_t) + sizeof(uint64_t);
+
+    void throwMalformed(const std::string& file, const char* reason) {
+      std::stringstream ss;
+      ss << "TensorArchive::open() - ERROR: " << file << " is malformed ("
+         << reason << ")";
+      throw std::runtime_error(ss.str());
+    }
+
+    template <typename V>
+    V readAt(const uint8_t* base, size_t length, size_t& pos,
+      const std::string& file) {
+      if (pos + sizeof(V) > length) {
+        throwMalformed(file, "truncated index");
+      }
+      V ret;
+      memcpy(&ret, base + pos, sizeof(V));
+      pos += sizeof(V);
+      return ret;
+    }
+
+    uint64_t alignUp(uint64_t value) {
+      const uint64_t a = TENSOR_ARCHIVE_ALIGNMENT;
+      return (value + a - 1) / a * a;
+    }
+
+  }  // unnamed namespace
+
+  TensorArchive::TensorArchive() {
+    mapping_ = NULL;
+    mapping_size_ = 0;
+  }
+
+  TensorArchive::~TensorArchive() {
+    if (mapping_ != NULL) {
+#ifdef _WIN32
+      _aligned_free(mapping_);
+#else
+      munmap(mapping_, mapping_size_);
+#endif
+    }
+  }
+
+  TensorArchive* TensorArchive::open(const std::string& file) {
+    TensorArchive* ret = new TensorArchive();
+    try {
+#ifdef _WIN32
+      // Read into a buffer aligned like a mapping, so the payloads keep
+      // their TENSOR_ARCHIVE_ALIGNMENT
+      std::ifstream ifile(file.c_str(), std::ios::in | std::ios::binary |
+        std::ios::ate);
+      if (!ifile.is_open()) {
+        throw std::runtime_error("TensorArchive::open() - ERROR: Could not "
+          "open file " + file);
+      }
+      const std::streamoff size = ifile.tellg();
+      if (size < (std::streamoff)kHeaderSize) {
+        throwMalformed(file, "too small");
+      }
+      ret->mapping_ = _aligned_malloc((size_t)size, TENSOR_ARCHIVE_ALIGNMENT);
+      if (ret->mapping_ == NULL) {
+        throw std::runtime_error("TensorArchive::open() - ERROR: out of "
+          "memory reading " + file);
+      }
+      ret->mapping_size_ = (size_t)size;
+      ifile.seekg(0, std::ios::beg);
+      ifile.read((char*)ret->mapping_, (std::streamsize)size);
+      if (!ifile.good()) {
+        throw std::runtime_error("TensorArchive::open() - ERROR: Could not "
+          "read file " + file);
+      }
+      ret->parse((uint8_t*)ret->mapping_, ret->mapping_size_, file);
+#else
+      int fd = ::open(file.c_str(), O_RDONLY);
+      if (fd < 0) {
+        throw std::runtime_error("TensorArchive::open() - ERROR: Could not "
+          "open file " + file);
+      }
+      struct ::stat info;
+      if (::fstat(fd, &info) != 0 || info.st_size < (off_t)kHeaderSize) {
+        ::close(fd);
+        throwMalformed(file, "too small");
+      }
+      // Private + writable: tensors handed out by get() may be modified in
+      // place without touching the file (pages are copied on write).
+      void* mapping = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (mapping == MAP_FAILED) {
+        throw std::runtime_error("TensorArchive::open() - ERROR: mmap failed "
+          "for " + file);
+      }
+      ret->mapping_ = mapping;
+      ret->mapping_size_ = (size_t)info.st_size;
+      ret->parse((uint8_t*)mapping, ret->mapping_size_, file);
+#endif
+    } catch (...) {
+      delete ret;
+      throw;
+    }
+    return ret;
+  }
+
+  void TensorArchive::parse(uint8_t* base, size_t length,
+    const std::string& file) {
+    if (length < kHeaderSize || memcmp(base, kMagic, sizeof(kMagic)) != 0) {
+      throwMalformed(file, "bad magic");
+    }
+    size_t pos = sizeof(kMagic);
+    uint32_t version = readAt<uint32_t>(base, length, pos, file);
+    if (version != kVersion) {
+      throwMalformed(file, "unsupported version");
+    }
+    uint32_t count = readAt<uint32_t>(base, length, pos, file);
+    readAt<uint32_t>(base, length, pos, file);  // reserved
+    uint64_t data_offset = readAt<uint64_t>(base, length, pos, file);
+
+    index_.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t name_len = readAt<uint32_t>(base, length, pos, file);
+      if (pos + name_len > length) {
+        throwMalformed(file, "truncated name");
+      }
+      std::string name((const char*)base + pos, name_len);
+      pos += name_len;
+
+      Entry entry;
+      uint32_t dim = readAt<uint32_t>(base, length, pos, file);
+      if (dim > (length - pos) / sizeof(uint32_t)) {
+        throwMalformed(file, "truncated index");
+      }
+      entry.size.resize(dim);
+      entry.nelems = 1;
+      // Checked: the product must not wrap before the bounds check below,
+      // and must fit Tensor's 32 bit element count
+      for (uint32_t d = 0; d < dim; d++) {
+        entry.size[d] = readAt<uint32_t>(base, length, pos, file);
+        if (entry.size[d] != 0 && entry.nelems >
+            std::numeric_limits<uint32_t>::max() / entry.size[d]) {
+          throwMalformed(file, "tensor too large");
+        }
+        entry.nelems *= entry.size[d];
+      }
+      uint64_t offset = readAt<uint64_t>(base, length, pos, file);
+      if (offset < data_offset || offset % sizeof(float) != 0 ||
+          offset > length ||
+          entry.nelems * sizeof(float) > length - offset) {
+        throwMalformed(file, "tensor payload out of range");
+      }
+      entry.data = (float*)(base + offset);
+      if (!index_.emplace(name, entry).second) {
+        throwMalformed(file, "duplicate tensor name");
+      }
+    }
+  }
+
+  bool TensorArchive::contains(const std::string& name) const {
+    return index_.find(name) != index_.end();
+  }
+
+  const TensorArchive::Entry* TensorArchive::find(
+    const std::string& name) const {
+    auto it = index_.find(name);
+    return it == index_.end() ? NULL : &it->second;
+  }
+
+  std::vector<std::string> TensorArchive::names() const {
+    std::vector<std::string> ret;
+    ret.reserve(index_.size());
+    for (auto it = index_.begin(); it != index_.end(); ++it) {
+      ret.push_back(it->first);
+    }
+    return ret;
+  }
+
+  Tensor<float>* TensorArchive::get(const std::string& name) const {
+    const Entry* entry = find(name);
+    if (entry == NULL) {
+      throw std::runtime_error("TensorArchive::get() - ERROR: no tensor "
+        "named " + name);
+    }
+    return Tensor<float>::wrap((uint32_t)entry->size.size(),
+      entry->size.data(), entry->data);
+  }
+
+  Tensor<float>* TensorArchive::load(const std::string& name) const {
+    const Entry* entry = find(name);
+    if (entry == NULL) {
+      throw std::runtime_error("TensorArchive::load() - ERROR: no tensor "
+        "named " + name);
+    }
+    Tensor<float>* ret = new Tensor<float>((uint32_t)entry->size.size(),
+      entry->size.data());
+    ret->setData(entry->data);
+    return ret;
+  }
+
+  TensorArchiveWriter::TensorArchiveWriter() {
+  }
+
+  TensorArchiveWriter::~TensorArchiveWriter() {
+  }
+
+  void TensorArchiveWriter::add(const std::string& name,
+    Tensor<float>& tensor) {
+    entries_.push_back(std::make_pair(name, &tensor));
+  }
+
+  void TensorArchiveWriter::save(const std::string& file) const {
+    std::ofstream ofile(file.c_str(), std::ios::out | std::ios::binary);
+    if (!ofile.is_open()) {
+      throw std::runtime_error("TensorArchiveWriter::save() - ERROR: Could "
+        "not open file " + file);
+    }
+
+    // Size the index first so the payload offsets are known up front
+    uint64_t index_size = 0;
+    for (size_t i = 0; i < entries_.size(); i++) {
+      index_size += sizeof(uint32_t) + entries_[i].first.size() +
+        sizeof(uint32_t) * (1 + entries_[i].second->dim()) + sizeof(uint64_t);
+    }
+    const uint64_t data_offset = alignUp(kHeaderSize + index_size);
+
+    std::vector<uint64_t> offsets(entries_.size());
+    uint64_t cur = data_offset;
+    for (size_t i = 0; i < entries_.size(); i++) {
+      offsets[i] = cur;
+      cur = alignUp(cur + sizeof(float) * entries_[i].second->nelems());
+    }
+
+    const uint32_t count = (uint32_t)entries_.size();
+    const uint32_t reserved = 0;
+    ofile.write(kMagic, sizeof(kMagic));
+    ofile.write((const char*)&kVersion, sizeof(kVersion));
+    ofile.write((const char*)&count, sizeof(count));
+    ofile.write((const char*)&reserved, sizeof(reserved));
+    ofile.write((const char*)&data_offset, sizeof(data_offset));
+    for (size_t i = 0; i < entries_.size(); i++) {
+      const std::string& name = entries_[i].first;
+      Tensor<float>* tensor = entries_[i].second;
+      const uint32_t name_len = (uint32_t)name.size();
+      const uint32_t dim = tensor->dim();
+      ofile.write((const char*)&name_len, sizeof(name_len));
+      ofile.write(name.data(), name_len);
+      ofile.write((const char*)&dim, sizeof(dim));
+      ofile.write((const char*)tensor->size(), sizeof(uint32_t) * dim);
+      ofile.write((const char*)&offsets[i], sizeof(offsets[i]));
+    }
+
+    const char zeros[TENSOR_ARCHIVE_ALIGNMENT] = {0};
+    uint64_t written = kHeaderSize + index_size;
+    for (size_t i = 0; i < entries_.size(); i++) {
+      ofile.write(zeros, (std::streamsize)(offsets[i] - written));
+      const uint64_t bytes = sizeof(float) * entries_[i].second->nelems();
+      ofile.write((const char*)entries_[i].second->getData(),
+        (std::streamsize)bytes);
+      written = offsets[i] + bytes;
+    }
+    if (!ofile.good()) {
+      throw std::runtime_error("TensorArchiveWriter::save() - ERROR: write "
+        "failed for " + file);
+    }
+  }
+
+}  // namespace mtorch
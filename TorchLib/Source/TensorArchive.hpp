@@ -0,0 +1,91 @@
+//
+//  TensorArchive.hpp
+//
+//  Indexed container for many named float tensors in a single file.  The
+//  archive is memory mapped on open, the index is hashed by name (O(1)
+//  lookup) and tensors can be handed out as zero-copy views on the mapping.
+//
+//  On-disk layout (native endian, offsets relative to the start of file):
+//    header:  char magic[4] = "MTAR", uint32 version, uint32 count,
+//             uint32 reserved, uint64 data_offset
+//    index:   count x { uint32 name_len, char name[name_len], uint32 dim,
+//                       uint32 size[dim], uint64 offset }
+//    data:    raw float payloads, each aligned to TENSOR_ARCHIVE_ALIGNMENT
+//
+//  size[0] is the lowest contiguous dimension (same as Tensor::size()).
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#define TENSOR_ARCHIVE_ALIGNMENT 64
+
+namespace mtorch {
+
+  template <typename T> class Tensor;
+
+  class TensorArchive {
+  public:
+    struct Entry {
+      std::vector<uint32_t> size;
+      float* data;
+      uint64_t nelems;
+    };
+
+    ~TensorArchive();
+
+    // Open maps the whole archive and builds the index.  Throws
+    // std::runtime_error if the file is missing or malformed.
+    static TensorArchive* open(const std::string& file);
+
+    uint32_t size() const { return (uint32_t)index_.size(); }
+    bool contains(const std::string& name) const;
+    const Entry* find(const std::string& name) const;  // NULL if missing
+    std::vector<std::string> names() const;
+
+    // get returns a zero-copy tensor on top of the mapping (caller owns the
+    // header, the archive owns the data and must outlive the tensor).  The
+    // mapping is private, so writes to the tensor never reach the file.
+    Tensor<float>* get(const std::string& name) const;
+    // load returns a tensor that owns a copy of the data.
+    Tensor<float>* load(const std::string& name) const;
+
+  protected:
+    // The mapping, or where mmap is unavailable a copy of the file read
+    // into memory aligned like the payloads
+    void* mapping_;
+    size_t mapping_size_;
+    std::unordered_map<std::string, Entry> index_;
+
+    TensorArchive();
+    void parse(uint8_t* base, size_t length, const std::string& file);
+
+    // Non-copyable, non-assignable.
+    TensorArchive(TensorArchive&);
+    TensorArchive& operator=(const TensorArchive&);
+  };
+
+  class TensorArchiveWriter {
+  public:
+    TensorArchiveWriter();
+    ~TensorArchiveWriter();
+
+    // add keeps a reference to tensor, which must stay alive until save.
+    void add(const std::string& name, Tensor<float>& tensor);
+    void save(const std::string& file) const;
+
+  protected:
+    std::vector<std::pair<std::string, Tensor<float>*> > entries_;
+
+    // Non-copyable, non-assignable.
+    TensorArchiveWriter(TensorArchiveWriter&);
+    TensorArchiveWriter& operator=(const TensorArchiveWriter&);
+  };
+
+};  // namespace mtorch
@@ -6,6 +6,7 @@
 #include "Reshape.hpp"
 #include "Sequential.hpp"
 #include "SpatialConvolutionFactory.hpp"
+#include "SpatialConvolutionGrouped.hpp"
 #include "SpatialDropout.hpp"
 #include "SpatialMaxPooling.hpp"
 #include "Tanh.hpp"
@@ -20,6 +21,36 @@ namespace mtorch {
   TorchStage::TorchStage() = default;
   TorchStage::~TorchStage() = default;
 
+  void TorchStage::parameters(std::vector<Tensor<float>*>&) {
+    // Parameter-free by default
+  }
+
+  bool TorchStage::outputSize(const uint32_t, const uint32_t*,
+    std::vector<uint32_t>&) const {
+    return false;
+  }
+
+  uint64_t TorchStage::workspaceBytes(const uint32_t, const uint32_t*) const {
+    return 0;
+  }
+
+  uint32_t TorchStage::planAlgorithm(const uint32_t, const uint32_t*) {
+    return 0;
+  }
+
+  bool TorchStage::useAlgorithm(const uint32_t, const uint32_t*,
+    const uint32_t algorithm) {
+    return canUseAlgorithm(algorithm);
+  }
+
+  bool TorchStage::canUseAlgorithm(const uint32_t algorithm) const {
+    return algorithm == 0;
+  }
+
+  void TorchStage::setNumThreads(const uint32_t) {
+    // Single threaded stage
+  }
+
   TorchStage* TorchStage::loadFromFile( std::string_view const file ) noexcept
   {
     auto buf = FileUtils::fileReadToBuffer( file.data() );
@@ -73,6 +104,12 @@ namespace mtorch {
     case SPATIAL_CONVOLUTION_MM_STAGE:
         node = SpatialConvolutionFactory::loadFromStream( stream );
       break;
+    case SPATIAL_CONVOLUTION_STRIDED_STAGE:
+        node = SpatialConvolutionFactory::loadFromStream( stream, true );
+      break;
+    case SPATIAL_CONVOLUTION_GROUPED_STAGE:
+        node = SpatialConvolutionGrouped::loadFromStream( stream );
+      break;
     case SPATIAL_DROPOUT:
       node = SpatialDropout::loadFromStream( stream );
       break;
@@ -12,7 +12,9 @@
 
 #include "Utils/InputStream.hpp"
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace mtorch {
 
@@ -39,10 +41,13 @@ namespace mtorch {
     C_ADD_TABLE_STAGE = 19,
     SPATIAL_CONVOLUTION_MM_STAGE = 20,
     SPATIAL_DROPOUT = 21,
+    SPATIAL_CONVOLUTION_STRIDED_STAGE = 22,  // SpatialConvolution + dW, dH
+    SPATIAL_CONVOLUTION_GROUPED_STAGE = 23,  // Strided + groups (depthwise)
   } TorchStageType;
 
 
   class TorchData;
+  template <typename T> class Tensor;
 
   class TorchStage {
   public:
@@ -53,6 +58,36 @@ namespace mtorch {
     virtual TorchStageType type() const { return UNDEFINED_STAGE; }
     virtual std::string name() const = 0;
     virtual void forwardProp(TorchData& input, TorchData** output) = 0;  // Pure virtual
+    // True if forwardProp frees its input (Sequential does), so the caller
+    // must not delete it afterwards.
+    virtual bool consumesInput() const { return false; }
+
+    // Appends the learned parameters (weights, biases) of this stage and of
+    // any child stages.  Used to pre-fault or lock model memory.
+    virtual void parameters(std::vector<Tensor<float>*>& params);
+
+    // Planning hooks (see ExecutionPlan.hpp).  outputSize does shape
+    // inference without running the stage and returns false if the input
+    // size is not supported.  workspaceBytes is the scratch memory a forward
+    // pass needs.  planAlgorithm picks (and may benchmark) the implementation
+    // used for an input size, useAlgorithm applies a previously recorded
+    // choice and returns false if it is not valid for this stage
+    // (canUseAlgorithm, which changes nothing).  Stages with a single
+    // implementation use algorithm 0.
+    virtual bool outputSize(const uint32_t in_dim, const uint32_t* in_size,
+      std::vector<uint32_t>& out_size) const;
+    virtual uint64_t workspaceBytes(const uint32_t in_dim,
+      const uint32_t* in_size) const;
+    virtual uint32_t planAlgorithm(const uint32_t in_dim,
+      const uint32_t* in_size);
+    virtual bool useAlgorithm(const uint32_t in_dim, const uint32_t* in_size,
+      const uint32_t algorithm);
+    virtual bool canUseAlgorithm(const uint32_t algorithm) const;
+
+    // Maximum number of threads (including the caller) a forward pass of
+    // this stage and its children may use from the shared intra-op pool
+    // (Blas::ThreadPool::shared()).  Stages run single threaded by default.
+    virtual void setNumThreads(const uint32_t threads);
 
     // Top level read-write
     static TorchStage* loadFromFile( std::string_view file ) noexcept;
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+namespace mtorch
+{
+
+// Blocking multi-producer / multi-consumer FIFO with a fixed capacity.
+// push blocks while the queue is full, pop blocks while it is empty.  Once
+// closed, push fails and pop drains the remaining items and then fails.
+// Both report how long the caller was blocked, for stall accounting.
+template< typename T >
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue( std::size_t capacity ) noexcept :
+        capacity_( capacity == 0 ? 1 : capacity ),
+        closed_( false )
+    {}
+
+    bool push( T item, double & stallSeconds )
+    {
+        std::unique_lock< std::mutex > lock( mutex_ );
+        auto const start( std::chrono::steady_clock::now() );
+        notFull_.wait( lock, [ this ]{ return closed_ || items_.size() < capacity_; } );
+        stallSeconds += std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+        if ( closed_ ) return false;
+        items_.push_back( std::move( item ) );
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    bool pop( T & item, double & stallSeconds )
+    {
+        std::unique_lock< std::mutex > lock( mutex_ );
+        auto const start( std::chrono::steady_clock::now() );
+        notEmpty_.wait( lock, [ this ]{ return closed_ || !items_.empty(); } );
+        stallSeconds += std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+        if ( items_.empty() ) return false;
+        item = std::move( items_.front() );
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+
+    void close() noexcept
+    {
+        std::lock_guard< std::mutex > lock( mutex_ );
+        closed_ = true;
+        notFull_.notify_all();
+        notEmpty_.notify_all();
+    }
+
+private:
+    std::size_t             const capacity_;
+    bool                          closed_;
+    std::deque< T >               items_;
+    std::mutex                    mutex_;
+    std::condition_variable       notFull_;
+    std::condition_variable       notEmpty_;
+};
+
+}
@@ -8,5 +8,22 @@ if( NOT TARGET TorchLib )
     add_library( TorchLib STATIC ${SOURCES} )
     target_include_directories( TorchLib PUBLIC ${CMAKE_CURRENT_LIST_DIR}/Source )
 
-    target_link_libraries( TorchLib PUBLIC BlasLibrary )
+    # Kernels/LayerKernels.cpp is also built for wider instruction sets, as
+    # BlasLibrary's kernels are, and Kernels/Dispatch.cpp picks the copy
+    # matching the one BlasLibrary picked
+    if( CMAKE_SYSTEM_PROCESSOR MATCHES "x86_64|AMD64|i.86" AND NOT EMSCRIPTEN )
+        foreach( isa avx2 avx512 )
+            add_library( TorchKernels_${isa} OBJECT ${CMAKE_CURRENT_LIST_DIR}/Source/Kernels/LayerKernels.cpp )
+            target_include_directories( TorchKernels_${isa} PRIVATE ${CMAKE_CURRENT_LIST_DIR}/Source ${CMAKE_CURRENT_LIST_DIR}/../BlasLibrary/Source )
+            target_compile_definitions( TorchKernels_${isa} PRIVATE TORCH_KERNELS_ISA=${isa} )
+            target_sources( TorchLib PRIVATE $<TARGET_OBJECTS:TorchKernels_${isa}> )
+        endforeach()
+        target_compile_options( TorchKernels_avx2 PRIVATE -mavx2 -mfma )
+        target_compile_options( TorchKernels_avx512 PRIVATE -mavx512f -mavx2 -mfma )
+        target_compile_definitions( TorchLib PRIVATE TORCH_KERNELS_X86 )
+    endif()
+
+    find_package( Threads REQUIRED )
+
+    target_link_libraries( TorchLib PUBLIC BlasLibrary Threads::Threads )
 endif()
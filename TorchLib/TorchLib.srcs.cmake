@@ -1,8 +1,20 @@
 set( SOURCES "" )
 
 set( Source
+    ${CMAKE_CURRENT_LIST_DIR}/Source/Activation.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/Activation.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/BatchEvaluator.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/BatchEvaluator.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/DepthFirst.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/DepthFirst.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/ExecutionPlan.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/ExecutionPlan.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/Linear.cpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/Linear.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/ModelWarmup.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/ModelWarmup.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/PlanCache.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/PlanCache.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/ReLU.cpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/ReLU.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/Reshape.cpp
@@ -11,9 +23,21 @@ set( Source
     ${CMAKE_CURRENT_LIST_DIR}/Source/Sequential.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialConvolution.cpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialConvolution.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialConvolutionAuto.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialConvolutionAuto.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialConvolutionDirect.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialConvolutionDirect.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialConvolutionFFT.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialConvolutionFFT.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialConvolutionFactory.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialConvolutionGemm.cpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialConvolutionGemm.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialConvolutionGrouped.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialConvolutionGrouped.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialConvolutionSeparable.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialConvolutionSeparable.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialConvolutionWinograd.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialConvolutionWinograd.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialDropout.cpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialDropout.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/SpatialMaxPooling.cpp
@@ -21,6 +45,8 @@ set( Source
     ${CMAKE_CURRENT_LIST_DIR}/Source/Tanh.cpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/Tanh.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/Tensor.hpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/TensorArchive.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/TensorArchive.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/TorchData.cpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/TorchData.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/TorchStage.cpp
@@ -29,7 +55,16 @@ set( Source
 source_group( "Source" FILES ${Source} )
 list( APPEND SOURCES ${Source} )
 
+set( Source_Kernels
+    ${CMAKE_CURRENT_LIST_DIR}/Source/Kernels/Dispatch.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/Kernels/LayerKernels.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/Source/Kernels/LayerKernels.hpp
+)
+source_group( "Source\\Kernels" FILES ${Source_Kernels} )
+list( APPEND SOURCES ${Source_Kernels} )
+
 set( Source_Utils
+    ${CMAKE_CURRENT_LIST_DIR}/Source/Utils/BoundedQueue.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/Utils/InputStream.hpp
     ${CMAKE_CURRENT_LIST_DIR}/Source/Utils/VectorManaged.hpp
 )
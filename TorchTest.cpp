@@ -1,27 +1,45 @@
+#include "Blas.hpp"
 #include "FileUtils.hpp"
 #include "Linear.hpp"
+#include "ModelWarmup.hpp"
 #include "Paths.h"
+#include "PlanCache.hpp"
 #include "ReLU.hpp"
 #include "Reshape.hpp"
 #include "Sequential.hpp"
 #include "SpatialConvolution.hpp"
+#include "SpatialConvolutionAuto.hpp"
+#include "SpatialConvolutionDirect.hpp"
+#include "SpatialConvolutionFFT.hpp"
 #include "SpatialConvolutionFactory.hpp"
+#include "SpatialConvolutionGemm.hpp"
+#include "SpatialConvolutionGrouped.hpp"
+#include "SpatialConvolutionSeparable.hpp"
+#include "SpatialConvolutionWinograd.hpp"
 #include "SpatialMaxPooling.hpp"
 #include "Tanh.hpp"
 #include "Tensor.hpp"
+#include "TensorArchive.hpp"
 #include "TorchData.hpp"
 
 #include <math.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 #define mtorch_FLOAT_PRECISION 1e-6f
+#define WINOGRAD_PRECISION 1e-4f
+#define FFT_PRECISION 1e-4f
+#define SEPARABLE_PRECISION 1e-5f
 #define LOOSE_EPSILON 0.000001f
 #define SAFE_DELETE(x) if (x != NULL) { delete x; x = NULL; }
 
@@ -29,13 +47,19 @@ using namespace mtorch;
 
 class TorchLibTest {
 public:
-    TorchLibTest() {}
-    virtual ~TorchLibTest() {}
+    TorchLibTest() : golden_(NULL) {}
+    virtual ~TorchLibTest() { SAFE_DELETE(golden_); }
 
 protected:
     void testmtorchValue(mtorch::Tensor<float>* data, const std::string& filename,
       float precision);
     void assertTrue(bool value, const std::string& module_name);
+    void packGoldenArchive(const std::string& archive,
+      const std::vector<std::string>& filenames);
+    void testWeightsRefresh(mtorch::TorchStage& stage, mtorch::Tensor<float>& weights,
+      mtorch::Tensor<float>& biases, mtorch::TorchData& input, const std::string& module_name);
+
+    mtorch::TensorArchive* golden_;  // golden references, keyed by filename
 
 };
 
@@ -45,7 +69,8 @@ void TorchLibTest::testmtorchValue(mtorch::Tensor<float>* data, const std::strin
   float* correct_data;
   float* model_data;
 
-  Tensor<float>* correct_data_tensor = Tensor<float>::loadFromFile(filename);
+  Tensor<float>* correct_data_tensor = golden_ != NULL && golden_->contains(filename) ?
+    golden_->get(filename) : Tensor<float>::loadFromFile(filename);
 
   if (!correct_data_tensor->isSameSizeAs(*data)) {
     std::cout << "Test FAILED (size mismatch)!: " << filename << std::endl;
@@ -98,6 +123,78 @@ void TorchLibTest::assertTrue(bool value, const std::string& module_name) {
   }
 }
 
+void TorchLibTest::packGoldenArchive(const std::string& archive,
+  const std::vector<std::string>& filenames) {
+
+  std::vector<Tensor<float>*> tensors;
+  TensorArchiveWriter writer;
+  for (size_t i = 0; i < filenames.size(); i++) {
+    tensors.push_back(Tensor<float>::loadFromFile(filenames[i]));
+    writer.add(filenames[i], *tensors.back());
+  }
+  writer.save(archive);
+
+  SAFE_DELETE(golden_);
+  golden_ = TensorArchive::open(archive);
+
+  bool archive_correct = golden_->size() == filenames.size();
+  for (size_t i = 0; i < filenames.size() && archive_correct; i++) {
+    Tensor<float>* mapped = golden_->get(filenames[i]);
+    archive_correct = mapped->isSameSizeAs(*tensors[i]) &&
+      memcmp(mapped->getData(), tensors[i]->getData(),
+        sizeof(float) * mapped->nelems()) == 0;
+    delete mapped;
+  }
+  assertTrue(archive_correct, "TensorArchive");
+
+  for (size_t i = 0; i < tensors.size(); i++) {
+    delete tensors[i];
+  }
+}
+
+// Changing the parameters through the tensors (setData reallocates at the
+// same size, mul works in place) must reach the stage's packed or
+// transformed copies: doubling weights and biases doubles the output
+void TorchLibTest::testWeightsRefresh(TorchStage& stage, Tensor<float>& weights,
+  Tensor<float>& biases, TorchData& input, const std::string& module_name) {
+
+  TorchData* output = NULL;
+  stage.forwardProp(input, &output);
+  std::vector<float> expected(TO_TENSOR_PTR(output)->getData(),
+    TO_TENSOR_PTR(output)->getData() + TO_TENSOR_PTR(output)->nelems());
+  for (size_t i = 0; i < expected.size(); i++) {
+    expected[i] *= 2.0f;
+  }
+  SAFE_DELETE(output);
+
+  std::vector<float> doubled(weights.getData(), weights.getData() + weights.nelems());
+  for (size_t i = 0; i < doubled.size(); i++) {
+    doubled[i] *= 2.0f;
+  }
+  weights.setData(doubled.data());
+  Tensor<float>::mul(biases, 2.0f);
+  stage.forwardProp(input, &output);
+
+  bool correct = true;
+  const float* out = TO_TENSOR_PTR(output)->getData();
+  for (size_t i = 0; correct && i < expected.size(); i++) {
+    correct = fabsf(out[i] - expected[i]) <=
+      WINOGRAD_PRECISION * std::max<float>(1.0f, fabsf(expected[i]));
+  }
+  SAFE_DELETE(output);
+
+  Tensor<float>::mul(weights, 0.5f);
+  Tensor<float>::mul(biases, 0.5f);
+  stage.forwardProp(input, &output);
+  out = TO_TENSOR_PTR(output)->getData();
+  for (size_t i = 0; correct && i < expected.size(); i++) {
+    correct = fabsf(2.0f * out[i] - expected[i]) <=
+      WINOGRAD_PRECISION * std::max<float>(1.0f, fabsf(expected[i]));
+  }
+  SAFE_DELETE(output);
+  assertTrue(correct, module_name + " weights refresh");
+}
+
 class FinalTest : public TorchLibTest {
 public:
 
@@ -128,6 +225,42 @@ public:
 
         std::cout << "Beginning mtorch tests..." << std::endl;
 
+        packGoldenArchive("golden_reference.mtar", {"data_in.bin",
+            "tanh_result.bin", "threshold.bin", "spatial_convolution.bin",
+            "spatial_convolution_mm_padding.bin", "spatial_max_pooling.bin",
+            "linear.bin"});
+
+        // An entry whose sizes multiply past 64 bits (65536^4 wraps to 0
+        // elements) must be rejected, not mapped as an empty tensor
+        {
+            const char magic[4] = {'M', 'T', 'A', 'R'};
+            const uint32_t header[3] = {1, 1, 0};  // version, count, reserved
+            const uint64_t data_offset = 64;
+            const uint32_t name_len = 1, dim = 4;
+            const uint32_t sizes[4] = {65536, 65536, 65536, 65536};
+            const uint64_t offset = 64;
+            std::ofstream ofile("overflow.mtar", std::ios::out | std::ios::binary);
+            ofile.write(magic, sizeof(magic));
+            ofile.write((const char*)header, sizeof(header));
+            ofile.write((const char*)&data_offset, sizeof(data_offset));
+            ofile.write((const char*)&name_len, sizeof(name_len));
+            ofile.write("w", 1);
+            ofile.write((const char*)&dim, sizeof(dim));
+            ofile.write((const char*)sizes, sizeof(sizes));
+            ofile.write((const char*)&offset, sizeof(offset));
+            const char zeros[64] = {0};
+            ofile.write(zeros, sizeof(zeros));
+            ofile.close();
+            bool rejected = false;
+            try {
+                delete TensorArchive::open("overflow.mtar");
+            } catch (const std::runtime_error&) {
+                rejected = true;
+            }
+            remove("overflow.mtar");
+            assertTrue(rejected, "TensorArchive size overflow");
+        }
+
         const uint32_t isize[3] = {width, height, num_feats_in};
         Tensor<float>* data_in = new Tensor<float>(3, isize);
 
@@ -197,10 +330,120 @@ public:
             }
             conv->setWeights(cweights);
             conv->setBiases(cbiases);
+            {
+                // Background warmup; the real pass below reuses its workspaces
+                ModelWarmup warmup(*conv, TO_TENSOR_PTR(output)->dim(), TO_TENSOR_PTR(output)->size());
+                WarmupReport report = warmup.wait();
+                assertTrue(warmup.ready() && report.weight_bytes == sizeof(cweights) + sizeof(cbiases),
+                    "ModelWarmup");
+            }
             conv->forwardProp(*output, &output_conv);
             testmtorchValue(TO_TENSOR_PTR(output_conv),"spatial_convolution.bin");
             SAFE_DELETE(output_conv);
 
+            // The factory runs this shape directly, check im2col + GEMM as well
+            SpatialConvolutionGemm conv_gemm(num_feats_in, num_feats_out, filt_height, filt_width);
+            conv_gemm.setWeights(cweights);
+            conv_gemm.setBiases(cbiases);
+            conv_gemm.forwardProp(*output, &output_conv);
+            testmtorchValue(TO_TENSOR_PTR(output_conv),"spatial_convolution.bin");
+            SAFE_DELETE(output_conv);
+            testWeightsRefresh(conv_gemm, *conv_gemm.weights(), *conv_gemm.biases(),
+                *output, "SpatialConvolutionGemm");
+
+            // Winograd F(2x2,5x5); the transforms round differently from the
+            // direct sum, hence the looser tolerance
+            SpatialConvolutionWinograd conv_winograd(num_feats_in, num_feats_out, filt_height, filt_width);
+            conv_winograd.setWeights(cweights);
+            conv_winograd.setBiases(cbiases);
+            conv_winograd.forwardProp(*output, &output_conv);
+            testmtorchValue(TO_TENSOR_PTR(output_conv),"spatial_convolution.bin", WINOGRAD_PRECISION);
+            SAFE_DELETE(output_conv);
+            testWeightsRefresh(conv_winograd, *conv_winograd.weights(), *conv_winograd.biases(),
+                *output, "SpatialConvolutionWinograd");
+
+            // A smaller input that rounds up to the same whole tiles must not
+            // see the previous input's pixels in its border
+            {
+                SpatialConvolutionWinograd conv_sizes(1, 1, 3, 3, 1, 1, 2);
+                Tensor<float>::fill(*conv_sizes.weights(), 1.0f);
+                Tensor<float>::zero(*conv_sizes.biases());
+                uint32_t large_size[3] = {10, 10, 1};
+                uint32_t small_size[3] = {9, 9, 1};
+                Tensor<float> large(3, large_size);
+                Tensor<float> small(3, small_size);
+                Tensor<float>::fill(large, 100.0f);
+                Tensor<float>::zero(small);
+                TorchData* out_sizes = NULL;
+                conv_sizes.forwardProp(large, &out_sizes);
+                SAFE_DELETE(out_sizes);
+                conv_sizes.forwardProp(small, &out_sizes);
+                Tensor<float>* out = TO_TENSOR_PTR(out_sizes);
+                bool correct = out->size()[0] == 9 && out->size()[1] == 9;
+                for (uint32_t i = 0; correct && i < out->nelems(); i++) {
+                    correct = fabsf(out->getData()[i]) <= WINOGRAD_PRECISION;
+                }
+                SAFE_DELETE(out_sizes);
+                assertTrue(correct, "SpatialConvolutionWinograd input sizes");
+            }
+
+            SpatialConvolutionFFT conv_fft(num_feats_in, num_feats_out, filt_height, filt_width);
+            conv_fft.setWeights(cweights);
+            conv_fft.setBiases(cbiases);
+            conv_fft.forwardProp(*output, &output_conv);
+            testmtorchValue(TO_TENSOR_PTR(output_conv),"spatial_convolution.bin", FFT_PRECISION);
+            SAFE_DELETE(output_conv);
+            testWeightsRefresh(conv_fft, *conv_fft.weights(), *conv_fft.biases(),
+                *output, "SpatialConvolutionFFT");
+
+            // The Gaussian filters are separable: their rank 1 decomposition
+            // must reproduce the dense convolution (also padded and
+            // strided), while full rank filters are left alone
+            {
+                bool correct = true;
+                for (uint32_t stride = 1; stride <= 2; stride++) {
+                    SpatialConvolutionGemm dense(num_feats_in, num_feats_out, filt_height, filt_width,
+                        3, 3, stride, stride);
+                    dense.setWeights(cweights);
+                    dense.setBiases(cbiases);
+                    SpatialConvolutionSeparable* separable = SpatialConvolutionSeparable::decompose(dense, 1e-4f);
+                    correct = correct && separable != NULL && separable->rank() == 1;
+                    if (separable != NULL) {
+                        TorchData* out_separable = NULL;
+                        dense.forwardProp(*output, &output_conv);
+                        separable->forwardProp(*output, &out_separable);
+                        Tensor<float>* a = TO_TENSOR_PTR(out_separable);
+                        Tensor<float>* b = TO_TENSOR_PTR(output_conv);
+                        correct = correct && a->isSameSizeAs(*b);
+                        for (uint32_t i = 0; correct && i < a->nelems(); i++) {
+                            correct = fabsf(a->getData()[i] - b->getData()[i]) <=
+                                SEPARABLE_PRECISION * std::max<float>(1.0f, fabsf(b->getData()[i]));
+                        }
+                        SAFE_DELETE(out_separable);
+                        SAFE_DELETE(output_conv);
+                        if (stride == 1) {
+                            testWeightsRefresh(*separable, *separable->weights(), *separable->biases(),
+                                *output, "SpatialConvolutionSeparable");
+                        }
+                        delete separable;
+                    }
+                }
+
+                std::vector<float> noise(num_feats_out * num_feats_out * filt_height * filt_width);
+                for (size_t i = 0; i < noise.size(); i++) {
+                    noise[i] = (float)((i * 7919) % 101) / 101.0f - 0.5f;
+                }
+                Sequential model;
+                model.add(new SpatialConvolutionGemm(num_feats_in, num_feats_out, filt_height, filt_width));
+                model.add(new SpatialConvolutionGemm(num_feats_out, num_feats_out, filt_height, filt_width));
+                ((SpatialConvolution*)model.get(0))->setWeights(cweights);
+                ((SpatialConvolution*)model.get(1))->setWeights(noise.data());
+                correct = correct && model.separateFilters(1e-4f) == 1 &&
+                    model.get(0)->name() == "SpatialConvolutionSeparable" &&
+                    model.get(1)->name() != "SpatialConvolutionSeparable";
+                assertTrue(correct, "SpatialConvolutionSeparable");
+            }
+
         const uint32_t padding = 6;
         SpatialConvolution* convmm = SpatialConvolutionFactory::create(num_feats_in, num_feats_out, filt_height,
             filt_width, padding, padding);
@@ -209,6 +452,806 @@ public:
         convmm->forwardProp(*output, &output_conv);
         testmtorchValue(TO_TENSOR_PTR(output_conv),"spatial_convolution_mm_padding.bin");
         SAFE_DELETE(output_conv);
+
+        // Padding lands in the overlap-add offsets rather than in the input
+        SpatialConvolutionFFT conv_fft_padded(num_feats_in, num_feats_out, filt_height, filt_width,
+            padding, padding);
+        Tensor<float>::copy(*conv_fft_padded.weights(), *conv->weights());
+        Tensor<float>::copy(*conv_fft_padded.biases(), *conv->biases());
+        conv_fft_padded.forwardProp(*output, &output_conv);
+        testmtorchValue(TO_TENSOR_PTR(output_conv),"spatial_convolution_mm_padding.bin", FFT_PRECISION);
+        SAFE_DELETE(output_conv);
+
+        // Stride 2 must produce every other output of the stride 1 convolution,
+        // both through the factory (direct kernels) and through im2col + GEMM
+        {
+            const std::string golden_file = "spatial_convolution_mm_padding.bin";
+            Tensor<float>* full = golden_ != NULL && golden_->contains(golden_file) ?
+                golden_->get(golden_file) : Tensor<float>::loadFromFile(golden_file);
+            SpatialConvolution* strided[2] = {
+                SpatialConvolutionFactory::create(num_feats_in, num_feats_out, filt_height, filt_width,
+                    padding, padding, 2, 2),
+                new SpatialConvolutionGemm(num_feats_in, num_feats_out, filt_height, filt_width,
+                    padding, padding, 2, 2)};
+            const char* labels[2] = {"SpatialConvolution stride 2", "SpatialConvolutionGemm stride 2"};
+            for (uint32_t s = 0; s < 2; s++) {
+                Tensor<float>::copy(*strided[s]->weights(), *conv->weights());
+                Tensor<float>::copy(*strided[s]->biases(), *conv->biases());
+                strided[s]->forwardProp(*output, &output_conv);
+                Tensor<float>* out = TO_TENSOR_PTR(output_conv);
+                const uint32_t fw = full->size()[0];
+                const uint32_t fh = full->size()[1];
+                const uint32_t ow = (fw + 1) / 2;
+                const uint32_t oh = (fh + 1) / 2;
+                bool correct = out->size()[0] == ow && out->size()[1] == oh;
+                for (uint32_t f = 0; correct && f < num_feats_out; f++) {
+                    for (uint32_t v = 0; correct && v < oh; v++) {
+                        for (uint32_t u = 0; correct && u < ow; u++) {
+                            const float expected = full->getData()[(f * fh + 2 * v) * fw + 2 * u];
+                            const float actual = out->getData()[(f * oh + v) * ow + u];
+                            correct = fabsf(actual - expected) <=
+                                mtorch_FLOAT_PRECISION * std::max<float>(1.0f, fabsf(expected));
+                        }
+                    }
+                }
+                assertTrue(correct, labels[s]);
+                SAFE_DELETE(output_conv);
+                delete strided[s];
+            }
+            delete full;
+        }
+
+        // 1x1 convolution runs the GEMM on the input itself, check it against
+        // the per pixel weighted sum of the input planes
+        {
+            SpatialConvolution* pointwise = SpatialConvolutionFactory::create(num_feats_in, num_feats_out, 1, 1);
+            std::vector<float> pweights(num_feats_out * num_feats_in);
+            for (uint32_t i = 0; i < pweights.size(); i++) {
+                pweights[i] = (float)(i % 7) / 7.0f - 0.4f;
+            }
+            pointwise->setWeights(pweights.data());
+            pointwise->setBiases(cbiases);
+            pointwise->forwardProp(*output, &output_conv);
+            Tensor<float>* in = TO_TENSOR_PTR(output);
+            const uint32_t plane = in->size()[0] * in->size()[1];
+            bool correct = TO_TENSOR_PTR(output_conv)->nelems() == plane * num_feats_out;
+            for (uint32_t o = 0; correct && o < num_feats_out; o++) {
+                for (uint32_t p = 0; correct && p < plane; p++) {
+                    float expected = cbiases[o];
+                    for (uint32_t c = 0; c < num_feats_in; c++) {
+                        expected += pweights[o * num_feats_in + c] * in->getData()[c * plane + p];
+                    }
+                    correct = fabsf(TO_TENSOR_PTR(output_conv)->getData()[o * plane + p] - expected) <=
+                        mtorch_FLOAT_PRECISION * std::max<float>(1.0f, fabsf(expected));
+                }
+            }
+            assertTrue(correct, "SpatialConvolution 1x1");
+            SAFE_DELETE(output_conv);
+            delete pointwise;
+        }
+
+        // A wide input needs several im2col panels (the last one partial);
+        // the implicit GEMM must agree with the direct kernels and keep its
+        // workspace within one panel
+        {
+            const uint32_t wide_size[3] = {300, 41, num_feats_in};
+            Tensor<float> wide(3, wide_size);
+            for (uint32_t i = 0; i < wide.nelems(); i++) {
+                wide.getData()[i] = (float)((i * 7919) % 101) / 101.0f - 0.5f;
+            }
+            SpatialConvolutionGemm wide_gemm(num_feats_in, num_feats_out, filt_height, filt_width, 2, 2);
+            SpatialConvolutionDirect wide_direct(num_feats_in, num_feats_out, filt_height, filt_width, 2, 2);
+            wide_gemm.setWeights(cweights);
+            wide_gemm.setBiases(cbiases);
+            wide_direct.setWeights(cweights);
+            wide_direct.setBiases(cbiases);
+            TorchData* out_direct = NULL;
+            wide_gemm.forwardProp(wide, &output_conv);
+            wide_direct.forwardProp(wide, &out_direct);
+            Tensor<float>* a = TO_TENSOR_PTR(output_conv);
+            Tensor<float>* b = TO_TENSOR_PTR(out_direct);
+            bool correct = a->isSameSizeAs(*b) &&
+                wide_gemm.workspaceBytes(3, wide_size) <= GEMM_CONV_PANEL_BYTES &&
+                wide_gemm.workspaceBytes(3, wide_size) < sizeof(float) * a->size()[0] * a->size()[1] *
+                    num_feats_in * filt_height * filt_width;
+            for (uint32_t i = 0; correct && i < a->nelems(); i++) {
+                correct = fabsf(a->getData()[i] - b->getData()[i]) <=
+                    mtorch_FLOAT_PRECISION * std::max<float>(1.0f, fabsf(b->getData()[i]));
+            }
+            assertTrue(correct, "SpatialConvolutionGemm panels");
+            SAFE_DELETE(output_conv);
+
+            // Threaded passes split panels and output planes across threads and
+            // must give the same result
+            wide_gemm.setNumThreads(4);
+            wide_direct.setNumThreads(4);
+            TorchData* out_threaded[2] = {NULL, NULL};
+            wide_gemm.forwardProp(wide, &out_threaded[0]);
+            wide_direct.forwardProp(wide, &out_threaded[1]);
+            correct = true;
+            for (uint32_t t = 0; t < 2; t++) {
+                Tensor<float>* a = TO_TENSOR_PTR(out_threaded[t]);
+                correct = correct && a->isSameSizeAs(*b);
+                for (uint32_t i = 0; correct && i < a->nelems(); i++) {
+                    correct = fabsf(a->getData()[i] - b->getData()[i]) <=
+                        mtorch_FLOAT_PRECISION * std::max<float>(1.0f, fabsf(b->getData()[i]));
+                }
+                SAFE_DELETE(out_threaded[t]);
+            }
+            assertTrue(correct, "SpatialConvolution threaded");
+
+            // SpatialConvolutionAuto must agree with the direct kernels with
+            // every algorithm it accepts, and a plan must record the
+            // algorithm it timed as the fastest
+            SpatialConvolutionAuto conv_auto(num_feats_in, num_feats_out, filt_height, filt_width, 2, 2);
+            conv_auto.setWeights(cweights);
+            conv_auto.setBiases(cbiases);
+            const float precision[CONV_ALGORITHM_COUNT] = {mtorch_FLOAT_PRECISION,
+                mtorch_FLOAT_PRECISION, WINOGRAD_PRECISION, WINOGRAD_PRECISION, FFT_PRECISION};
+            auto matches = [&](const uint32_t algorithm) {
+                TorchData* out_auto = NULL;
+                conv_auto.forwardProp(wide, &out_auto);
+                Tensor<float>* a = TO_TENSOR_PTR(out_auto);
+                bool same = a->isSameSizeAs(*b);
+                for (uint32_t i = 0; same && i < a->nelems(); i++) {
+                    same = fabsf(a->getData()[i] - b->getData()[i]) <=
+                        precision[algorithm] * std::max<float>(1.0f, fabsf(b->getData()[i]));
+                }
+                SAFE_DELETE(out_auto);
+                return same;
+            };
+            uint32_t accepted = 0;
+            correct = true;
+            for (uint32_t algorithm = 0; algorithm < CONV_ALGORITHM_COUNT; algorithm++) {
+                if (conv_auto.useAlgorithm(3, wide_size, algorithm)) {
+                    accepted++;
+                    correct = correct && conv_auto.algorithm(3, wide_size) == algorithm &&
+                        matches(algorithm);
+                }
+            }
+            ExecutionPlan plan = ExecutionPlanner::build(conv_auto, 3, wide_size);
+            correct = correct && accepted == 4 && plan.stages.size() == 1 &&
+                plan.stages[0].algorithm == conv_auto.algorithm(3, wide_size) &&
+                matches(plan.stages[0].algorithm);
+            assertTrue(correct, "SpatialConvolutionAuto");
+
+            // A plan one stage of which cannot take its algorithm (F(4x4,3x3)
+            // on a 5x5 filter) is rejected before any stage is changed
+            {
+                Sequential planned;
+                SpatialConvolutionAuto* first = new SpatialConvolutionAuto(2, 3, 3, 3, 1, 1);
+                planned.add(first);
+                planned.add(new SpatialConvolutionAuto(3, 2, 5, 5, 2, 2));
+                const uint32_t plan_size[3] = {12, 12, 2};
+                ExecutionPlan bad = ExecutionPlanner::build(planned, 3, plan_size);
+                const uint32_t before = first->algorithm(3, plan_size);
+                bad.stages[0].algorithm = before == CONV_ALGORITHM_DIRECT ?
+                    CONV_ALGORITHM_GEMM : CONV_ALGORITHM_DIRECT;
+                bad.stages[1].algorithm = CONV_ALGORITHM_WINOGRAD_4;
+                assertTrue(bad.stages.size() == 2 && !ExecutionPlanner::apply(planned, bad) &&
+                    first->algorithm(3, plan_size) == before, "ExecutionPlanner::apply rejected plan");
+            }
+            SAFE_DELETE(out_direct);
+        }
+
+        // Grouped and depthwise convolution must match a dense convolution
+        // whose weights are zero between groups.  The depthwise cases cover
+        // the specialized kernels (3x3, stride 1 and 2) and the generic one
+        // (4x4); the last case is loaded from a serialized record.
+        {
+            const uint32_t gin = 6;
+            const uint32_t gsize[3] = {17, 13, gin};
+            Tensor<float> ginput(3, gsize);
+            for (uint32_t i = 0; i < ginput.nelems(); i++) {
+                ginput.getData()[i] = (float)((i * 7919) % 97) / 97.0f - 0.5f;
+            }
+            // feats_out, kernel, groups, pad, stride
+            const uint32_t configs[6][5] = {{12, 3, 6, 1, 1}, {6, 3, 6, 1, 2}, {6, 4, 6, 2, 1},
+                {4, 3, 2, 1, 1}, {9, 1, 3, 0, 1}, {6, 3, 6, 1, 1}};
+            bool correct = true;
+            for (uint32_t t = 0; correct && t < 6; t++) {
+                const uint32_t gout = configs[t][0], kk = configs[t][1], groups = configs[t][2];
+                const uint32_t pad = configs[t][3], stride = configs[t][4];
+                const uint32_t in_group = gin / groups, out_group = gout / groups;
+                std::vector<float> gweights(gout * in_group * kk * kk);
+                std::vector<float> dense(gout * gin * kk * kk, 0.0f);
+                std::vector<float> gbiases(gout);
+                for (uint32_t o = 0; o < gout; o++) {
+                    gbiases[o] = 0.1f * (float)o - 0.3f;
+                    for (uint32_t c = 0; c < in_group; c++) {
+                        for (uint32_t f = 0; f < kk * kk; f++) {
+                            const float w = (float)((o * 31 + c * 7 + f * 3) % 11) / 11.0f - 0.45f;
+                            gweights[(o * in_group + c) * kk * kk + f] = w;
+                            dense[(o * gin + (o / out_group) * in_group + c) * kk * kk + f] = w;
+                        }
+                    }
+                }
+                SpatialConvolutionGemm reference(gin, gout, kk, kk, pad, pad, stride, stride);
+                reference.setWeights(dense.data());
+                reference.setBiases(gbiases.data());
+                SpatialConvolution* grouped = NULL;
+                if (t < 5) {
+                    grouped = new SpatialConvolutionGrouped(gin, gout, kk, kk, groups, pad, pad, stride, stride);
+                    grouped->setWeights(gweights.data());
+                    grouped->setBiases(gbiases.data());
+                } else {
+                    // Sequential (type, CONVNET, no labels, 2 nodes) of the grouped stage and Tanh
+                    const int32_t header[15] = {SEQUENTIAL_STAGE, SEQUENTIAL_STAGE, 1, 0, 2,
+                        SPATIAL_CONVOLUTION_GROUPED_STAGE, (int32_t)kk, (int32_t)kk, (int32_t)gin,
+                        (int32_t)gout, (int32_t)pad, (int32_t)pad, (int32_t)stride, (int32_t)stride,
+                        (int32_t)groups};
+                    const int32_t tanh_stage = TANH_STAGE;
+                    std::vector<uint8_t> record(sizeof(header) + sizeof(float) *
+                        (gweights.size() + gbiases.size()) + sizeof(tanh_stage));
+                    size_t written = 0;
+                    auto append = [&record, &written](const void* p, const size_t bytes) {
+                        memcpy(record.data() + written, p, bytes);
+                        written += bytes;
+                    };
+                    append(header, sizeof(header));
+                    append(gweights.data(), sizeof(float) * gweights.size());
+                    append(gbiases.data(), sizeof(float) * gbiases.size());
+                    append(&tanh_stage, sizeof(tanh_stage));
+                    Sequential* loaded = (Sequential*)TorchStage::loadFromBuffer(record);
+                    // The Tanh is fused into the grouped stage on load
+                    correct = loaded->size() == 1 &&
+                        loaded->get(0)->type() == SPATIAL_CONVOLUTION_GROUPED_STAGE;
+                    grouped = (SpatialConvolution*)loaded->get(0);
+                    reference.setActivation(Activation::tanh());
+                    TorchData* out_reference = NULL;
+                    TorchData* out_grouped = NULL;
+                    reference.forwardProp(ginput, &out_reference);
+                    loaded->forwardProp(*Tensor<float>::clone(ginput), &out_grouped);
+                    Tensor<float>* a = TO_TENSOR_PTR(out_grouped);
+                    Tensor<float>* b = TO_TENSOR_PTR(out_reference);
+                    correct = correct && a->isSameSizeAs(*b);
+                    for (uint32_t i = 0; correct && i < a->nelems(); i++) {
+                        correct = fabsf(a->getData()[i] - b->getData()[i]) <=
+                            mtorch_FLOAT_PRECISION * std::max<float>(1.0f, fabsf(b->getData()[i]));
+                    }
+                    SAFE_DELETE(out_reference);
+                    SAFE_DELETE(out_grouped);
+                    delete loaded;
+                    continue;
+                }
+                TorchData* out_reference = NULL;
+                TorchData* out_grouped = NULL;
+                reference.forwardProp(ginput, &out_reference);
+                grouped->forwardProp(ginput, &out_grouped);
+                Tensor<float>* a = TO_TENSOR_PTR(out_grouped);
+                Tensor<float>* b = TO_TENSOR_PTR(out_reference);
+                correct = a->isSameSizeAs(*b);
+                for (uint32_t i = 0; correct && i < a->nelems(); i++) {
+                    correct = fabsf(a->getData()[i] - b->getData()[i]) <=
+                        mtorch_FLOAT_PRECISION * std::max<float>(1.0f, fabsf(b->getData()[i]));
+                }
+                SAFE_DELETE(out_reference);
+                SAFE_DELETE(out_grouped);
+                if (groups != gin) {
+                    testWeightsRefresh(*grouped, *grouped->weights(), *grouped->biases(),
+                        ginput, "SpatialConvolutionGrouped");
+                }
+                delete grouped;
+            }
+            assertTrue(correct, "SpatialConvolutionGrouped");
+        }
+
+        // Fused activation: every implementation must match the plain
+        // convolution followed by Threshold, and Sequential::fuseActivations
+        // must fold a Threshold stage into the convolution before it
+        {
+            const std::string golden_file = "spatial_convolution.bin";
+            Tensor<float>* plain = golden_ != NULL && golden_->contains(golden_file) ?
+                golden_->get(golden_file) : Tensor<float>::loadFromFile(golden_file);
+            const float threshold = 0.5f;
+            const float val = 0.1f;
+            SpatialConvolution* fused[4] = {
+                SpatialConvolutionFactory::create(num_feats_in, num_feats_out, filt_height, filt_width),
+                new SpatialConvolutionGemm(num_feats_in, num_feats_out, filt_height, filt_width),
+                new SpatialConvolutionWinograd(num_feats_in, num_feats_out, filt_height, filt_width),
+                new SpatialConvolutionFFT(num_feats_in, num_feats_out, filt_height, filt_width)};
+            const float precision[4] = {mtorch_FLOAT_PRECISION, mtorch_FLOAT_PRECISION,
+                WINOGRAD_PRECISION, FFT_PRECISION};
+            const char* labels[4] = {"SpatialConvolution fused Threshold", "SpatialConvolutionGemm fused Threshold",
+                "SpatialConvolutionWinograd fused Threshold", "SpatialConvolutionFFT fused Threshold"};
+            for (uint32_t s = 0; s < 4; s++) {
+                Tensor<float>::copy(*fused[s]->weights(), *conv->weights());
+                Tensor<float>::copy(*fused[s]->biases(), *conv->biases());
+                fused[s]->setActivation(Activation::threshold(threshold, val));
+                fused[s]->forwardProp(*output, &output_conv);
+                Tensor<float>* out = TO_TENSOR_PTR(output_conv);
+                bool correct = out->nelems() == plain->nelems();
+                for (uint32_t i = 0; correct && i < plain->nelems(); i++) {
+                    const float x = plain->getData()[i];
+                    // Values this close to the threshold may land on either side
+                    if (fabsf(x - threshold) <= precision[s]) {
+                        continue;
+                    }
+                    const float expected = x > threshold ? x : val;
+                    correct = fabsf(out->getData()[i] - expected) <=
+                        precision[s] * std::max<float>(1.0f, fabsf(expected));
+                }
+                assertTrue(correct, labels[s]);
+                SAFE_DELETE(output_conv);
+                delete fused[s];
+            }
+
+            Sequential net;
+            SpatialConvolutionGemm* net_conv = new SpatialConvolutionGemm(num_feats_in, num_feats_out,
+                filt_height, filt_width);
+            Tensor<float>::copy(*net_conv->weights(), *conv->weights());
+            Tensor<float>::copy(*net_conv->biases(), *conv->biases());
+            net.add(net_conv);
+            net.add(new mtorch::Threshold());
+            ((mtorch::Threshold*)net.get(1))->threshold = threshold;
+            ((mtorch::Threshold*)net.get(1))->val = val;
+            // Sequential::forwardProp consumes its input
+            net.forwardProp(*Tensor<float>::clone(*TO_TENSOR_PTR(output)), &output_conv);
+            Tensor<float>* unfused = Tensor<float>::clone(*TO_TENSOR_PTR(output_conv));
+            SAFE_DELETE(output_conv);
+            const uint32_t removed = net.fuseActivations();
+            net.forwardProp(*Tensor<float>::clone(*TO_TENSOR_PTR(output)), &output_conv);
+            bool correct = removed == 1 && net.size() == 1 &&
+                net_conv->activation().type == ACTIVATION_THRESHOLD;
+            for (uint32_t i = 0; correct && i < unfused->nelems(); i++) {
+                correct = fabsf(TO_TENSOR_PTR(output_conv)->getData()[i] - unfused->getData()[i]) <=
+                    mtorch_FLOAT_PRECISION * std::max<float>(1.0f, fabsf(unfused->getData()[i]));
+            }
+            assertTrue(correct, "Sequential::fuseActivations");
+            SAFE_DELETE(output_conv);
+            delete unfused;
+            delete plain;
+        }
+
+        // Fused pooling: Sequential::fusePooling must fold a 2x2
+        // SpatialMaxPooling into the convolution before it (natively pooled
+        // by Gemm and Direct, pooled after the fact by FFT), also when the
+        // Threshold comes after the pooling stage
+        {
+            bool correct = true;
+            for (uint32_t s = 0; s < 3; s++) {
+                const bool pool_first = s == 2;
+                Sequential nets[2];
+                for (uint32_t n = 0; n < 2; n++) {
+                    SpatialConvolution* c;
+                    if (s == 0) {
+                        c = new SpatialConvolutionGemm(num_feats_in, num_feats_out, filt_height, filt_width, 2, 2);
+                    } else if (s == 1) {
+                        c = new SpatialConvolutionDirect(num_feats_in, num_feats_out, filt_height, filt_width, 2, 2);
+                    } else {
+                        c = new SpatialConvolutionFFT(num_feats_in, num_feats_out, filt_height, filt_width, 2, 2);
+                    }
+                    Tensor<float>::copy(*c->weights(), *conv->weights());
+                    Tensor<float>::copy(*c->biases(), *conv->biases());
+                    mtorch::Threshold* relu = new mtorch::Threshold();
+                    relu->threshold = 0.5f;
+                    relu->val = 0.1f;
+                    nets[n].add(c);
+                    if (pool_first) {
+                        nets[n].add(new SpatialMaxPooling(2, 2, 2, 2, 0, 0));
+                        nets[n].add(relu);
+                    } else {
+                        nets[n].add(relu);
+                        nets[n].add(new SpatialMaxPooling(2, 2, 2, 2, 0, 0));
+                    }
+                }
+                uint32_t removed = nets[1].fuseActivations();
+                removed += nets[1].fusePooling();
+                removed += nets[1].fuseActivations();
+                correct = correct && removed == 2 && nets[1].size() == 1 &&
+                    ((SpatialConvolution*)nets[1].get(0))->pooled();
+
+                TorchData* out_fused = NULL;
+                nets[0].forwardProp(*Tensor<float>::clone(*TO_TENSOR_PTR(output)), &output_conv);
+                nets[1].forwardProp(*Tensor<float>::clone(*TO_TENSOR_PTR(output)), &out_fused);
+                Tensor<float>* a = TO_TENSOR_PTR(out_fused);
+                Tensor<float>* b = TO_TENSOR_PTR(output_conv);
+                correct = correct && a->isSameSizeAs(*b);
+                for (uint32_t i = 0; correct && i < a->nelems(); i++) {
+                    correct = fabsf(a->getData()[i] - b->getData()[i]) <=
+                        mtorch_FLOAT_PRECISION * std::max<float>(1.0f, fabsf(b->getData()[i]));
+                }
+                SAFE_DELETE(out_fused);
+                SAFE_DELETE(output_conv);
+            }
+            assertTrue(correct, "Sequential::fusePooling");
+        }
+
+        // Depth-first execution: a chain with padding, a pooled
+        // convolution, a pooling stage and a strided convolution must give
+        // the layer at a time result for tiles of one output pixel and larger
+        {
+            const uint32_t df_size[3] = {24, 24, 3};
+            Tensor<float>* df_in = new Tensor<float>(3, df_size);
+            for (uint32_t i = 0; i < df_in->nelems(); i++) {
+                df_in->getData()[i] = (float)((i * 37) % 23) / 23.0f - 0.3f;
+            }
+            bool correct = true;
+            Tensor<float>* reference = NULL;
+            const uint64_t tile_bytes[3] = {0, 1, 8192};
+            for (uint32_t t = 0; t < 3; t++) {
+                Sequential net;
+                SpatialConvolution* convs[3] = {
+                    new SpatialConvolutionGemm(3, 8, 3, 3, 1, 1),
+                    new SpatialConvolutionDirect(8, 8, filt_height, filt_width, 2, 2),
+                    new SpatialConvolutionGemm(8, 4, 3, 3, 1, 1, 2, 2)};
+                for (uint32_t c = 0; c < 3; c++) {
+                    Tensor<float>* w = convs[c]->weights();
+                    for (uint32_t i = 0; i < w->nelems(); i++) {
+                        w->getData()[i] = (float)((i * 13 + c) % 17) / 17.0f - 0.5f;
+                    }
+                    Tensor<float>::fill(*convs[c]->biases(), 0.1f);
+                }
+                convs[1]->setPooling(2, 2);
+                net.add(convs[0]);
+                net.add(new mtorch::Threshold());
+                net.add(convs[1]);
+                net.add(new SpatialMaxPooling(2, 2, 2, 2, 0, 0));
+                net.add(convs[2]);
+                // No limit on the recomputation, so the tiles do not grow
+                // back to the whole (small) image
+                net.setDepthFirst(tile_bytes[t], 100000);
+                net.forwardProp(*Tensor<float>::clone(*df_in), &output_conv);
+                Tensor<float>* out = TO_TENSOR_PTR(output_conv);
+                if (reference == NULL) {
+                    reference = out;
+                    output_conv = NULL;
+                    continue;
+                }
+                correct = correct && out->isSameSizeAs(*reference);
+                for (uint32_t i = 0; correct && i < out->nelems(); i++) {
+                    correct = fabsf(out->getData()[i] - reference->getData()[i]) <=
+                        mtorch_FLOAT_PRECISION * std::max<float>(1.0f, fabsf(reference->getData()[i]));
+                }
+                SAFE_DELETE(output_conv);
+            }
+            assertTrue(correct, "Sequential::setDepthFirst");
+            delete reference;
+            delete df_in;
+        }
+
+        // Activation sparsity: Linear skips zero inputs, and Gemm drops
+        // all-zero input planes (3x3 padded and 1x1); both must match a
+        // naive dense computation
+        {
+            bool correct = true;
+            const uint32_t n_in = 37, n_out = 13;
+            Linear sparse_lin(n_in, n_out);
+            std::vector<float> x(n_in);
+            for (uint32_t z = 0; z < 2; z++) {
+                for (uint32_t i = 0; i < n_in * n_out; i++) {
+                    sparse_lin.weights()->getData()[i] = (float)((i * 7) % 19) / 19.0f - 0.5f;
+                }
+                for (uint32_t i = 0; i < n_out; i++) {
+                    sparse_lin.biases()->getData()[i] = 0.1f * i;
+                }
+                // Two thirds zero, then all zero
+                for (uint32_t j = 0; j < n_in; j++) {
+                    x[j] = z == 0 && j % 3 == 0 ? (float)j / n_in - 0.2f : 0.0f;
+                }
+                Tensor<float> lin_in(1, &n_in);
+                lin_in.setData(x.data());
+                sparse_lin.forwardProp(lin_in, &output_conv);
+                for (uint32_t i = 0; correct && i < n_out; i++) {
+                    float expected = sparse_lin.biases()->getData()[i];
+                    for (uint32_t j = 0; j < n_in; j++) {
+                        expected += sparse_lin.weights()->getData()[j * n_out + i] * x[j];
+                    }
+                    correct = fabsf(TO_TENSOR_PTR(output_conv)->getData()[i] - expected) <=
+                        mtorch_FLOAT_PRECISION * std::max<float>(1.0f, fabsf(expected));
+                }
+                SAFE_DELETE(output_conv);
+            }
+
+            const uint32_t sp_size[3] = {9, 7, 8};
+            Tensor<float> sp_in(3, sp_size);
+            const uint32_t plane = sp_size[0] * sp_size[1];
+            for (uint32_t f = 1; f <= 3; f += 2) {
+                const int32_t pad = (int32_t)f / 2;
+                SpatialConvolutionGemm gemm(sp_size[2], 6, f, f, pad, pad);
+                const float* w = gemm.weights()->getData();
+                for (uint32_t i = 0; i < gemm.weights()->nelems(); i++) {
+                    gemm.weights()->getData()[i] = (float)((i * 3) % 17) / 17.0f - 0.4f;
+                }
+                Tensor<float>::fill(*gemm.biases(), 0.2f);
+                // The same live planes twice (the packed weights are reused),
+                // then different ones
+                for (uint32_t pass = 0; pass < 3; pass++) {
+                    const uint32_t on = pass < 2 ? 0 : 1;
+                    for (uint32_t c = 0; c < sp_size[2]; c++) {
+                        for (uint32_t i = 0; i < plane; i++) {
+                            // Planes 1, 2, 4, 5 and 7 are switched off (then 0, 2, 3, 5 and 6)
+                            sp_in.getData()[c * plane + i] = c % 3 == on ? (float)((i * 5 + c) % 11) / 11.0f : 0.0f;
+                        }
+                    }
+                    gemm.forwardProp(sp_in, &output_conv);
+                    Tensor<float>* a = TO_TENSOR_PTR(output_conv);
+                    correct = correct && a->size()[0] == sp_size[0] && a->size()[1] == sp_size[1];
+                    for (int32_t o = 0; correct && o < 6; o++) {
+                        for (int32_t y = 0; correct && y < (int32_t)sp_size[1]; y++) {
+                            for (int32_t u = 0; correct && u < (int32_t)sp_size[0]; u++) {
+                                float expected = 0.2f;
+                                for (int32_t c = 0; c < (int32_t)sp_size[2]; c++) {
+                                    for (int32_t v = 0; v < (int32_t)f; v++) {
+                                        for (int32_t t = 0; t < (int32_t)f; t++) {
+                                            const int32_t iy = y + v - pad;
+                                            const int32_t ix = u + t - pad;
+                                            if (iy >= 0 && ix >= 0 && iy < (int32_t)sp_size[1] && ix < (int32_t)sp_size[0]) {
+                                                expected += w[((o * sp_size[2] + c) * f + v) * f + t] *
+                                                    sp_in.getData()[c * plane + iy * sp_size[0] + ix];
+                                            }
+                                        }
+                                    }
+                                }
+                                const float got = a->getData()[(o * sp_size[1] + y) * sp_size[0] + u];
+                                correct = fabsf(got - expected) <=
+                                    mtorch_FLOAT_PRECISION * 10 * std::max<float>(1.0f, fabsf(expected));
+                            }
+                        }
+                    }
+                    SAFE_DELETE(output_conv);
+                }
+                testWeightsRefresh(gemm, *gemm.weights(), *gemm.biases(), sp_in,
+                    "SpatialConvolutionGemm compacted");
+            }
+            assertTrue(correct, "Activation sparsity");
+        }
+
+        // Linear with its rows split over threads (past
+        // LINEAR_PARALLEL_MIN_WORK, rows not a multiple of the split)
+        {
+            bool correct = true;
+            const uint32_t n_in = 301, n_out = 1003;
+            Linear threaded_lin(n_in, n_out);
+            for (uint32_t i = 0; i < n_in * n_out; i++) {
+                threaded_lin.weights()->getData()[i] = (float)((i * 11) % 23) / 23.0f - 0.5f;
+            }
+            threaded_lin.weights()->markModified();
+            for (uint32_t i = 0; i < n_out; i++) {
+                threaded_lin.biases()->getData()[i] = 0.01f * i;
+            }
+            Tensor<float> lin_in(1, &n_in);
+            for (uint32_t j = 0; j < n_in; j++) {
+                lin_in.getData()[j] = (float)(j % 13) / 13.0f;
+            }
+            threaded_lin.setNumThreads(4);
+            threaded_lin.forwardProp(lin_in, &output_conv);
+            for (uint32_t i = 0; correct && i < n_out; i++) {
+                float expected = threaded_lin.biases()->getData()[i];
+                for (uint32_t j = 0; j < n_in; j++) {
+                    expected += threaded_lin.weights()->getData()[j * n_out + i] * lin_in.getData()[j];
+                }
+                correct = fabsf(TO_TENSOR_PTR(output_conv)->getData()[i] - expected) <=
+                    mtorch_FLOAT_PRECISION * 10 * std::max<float>(1.0f, fabsf(expected));
+            }
+            SAFE_DELETE(output_conv);
+            assertTrue(correct, "Linear threaded");
+        }
+
+        // Block-sparse weights: pruned Linear and Gemm weights (a third of
+        // the 4x4 blocks kept, sizes not multiples of 4) take the sparse
+        // path, which must match a naive product and the Direct convolution
+        {
+            bool correct = true;
+            const uint32_t n_in = 37, n_out = 13;
+            Linear pruned_lin(n_in, n_out);
+            std::vector<float> lw(n_in * n_out);
+            for (uint32_t j = 0; j < n_in; j++) {
+                for (uint32_t i = 0; i < n_out; i++) {
+                    lw[j * n_out + i] = (i / 4 + j / 4) % 3 == 0 ?
+                        (float)((i * 7 + j * 3) % 19) / 19.0f - 0.5f : 0.0f;
+                }
+            }
+            pruned_lin.setWeights(lw.data());
+            Tensor<float>::fill(*pruned_lin.biases(), 0.3f);
+            std::vector<float> x(n_in);
+            for (uint32_t j = 0; j < n_in; j++) {
+                // Inputs 8 to 15 are zero, a whole block column is skipped
+                x[j] = j / 8 == 1 ? 0.0f : (float)j / n_in - 0.4f;
+            }
+            Tensor<float> lin_in(1, &n_in);
+            lin_in.setData(x.data());
+            pruned_lin.forwardProp(lin_in, &output_conv);
+            for (uint32_t i = 0; correct && i < n_out; i++) {
+                float expected = 0.3f;
+                for (uint32_t j = 0; j < n_in; j++) {
+                    expected += lw[j * n_out + i] * x[j];
+                }
+                correct = fabsf(TO_TENSOR_PTR(output_conv)->getData()[i] - expected) <=
+                    mtorch_FLOAT_PRECISION * std::max<float>(1.0f, fabsf(expected));
+            }
+            SAFE_DELETE(output_conv);
+            testWeightsRefresh(pruned_lin, *pruned_lin.weights(), *pruned_lin.biases(),
+                lin_in, "Linear block-sparse");
+
+            const uint32_t fin = 6, fout = 7;
+            const uint32_t bs_size[3] = {10, 6, fin};
+            Tensor<float> bs_in(3, bs_size);
+            for (uint32_t i = 0; i < bs_in.nelems(); i++) {
+                bs_in.getData()[i] = (float)((i * 13) % 23) / 23.0f - 0.5f;
+            }
+            std::vector<float> cw(fout * fin * 9);
+            for (uint32_t o = 0; o < fout; o++) {
+                for (uint32_t kk = 0; kk < fin * 9; kk++) {
+                    cw[o * fin * 9 + kk] = (o / 4 + kk / 4) % 3 == 1 ?
+                        (float)((o * 5 + kk) % 17) / 17.0f - 0.5f : 0.0f;
+                }
+            }
+            for (uint32_t s = 0; s < 2; s++) {
+                SpatialConvolutionGemm gemm(fin, fout, 3, 3, 1, 1);
+                SpatialConvolutionDirect direct(fin, fout, 3, 3, 1, 1);
+                SpatialConvolution* convs[2] = {&gemm, &direct};
+                for (uint32_t c = 0; c < 2; c++) {
+                    convs[c]->setWeights(cw.data());
+                    Tensor<float>::fill(*convs[c]->biases(), -0.1f);
+                    // Thresholded, then also pooled
+                    convs[c]->setActivation(Activation::threshold(0, 0));
+                    if (s == 1) {
+                        convs[c]->setPooling(2, 2);
+                    }
+                }
+                TorchData* direct_out = NULL;
+                gemm.forwardProp(bs_in, &output_conv);
+                direct.forwardProp(bs_in, &direct_out);
+                Tensor<float>* a = TO_TENSOR_PTR(output_conv);
+                Tensor<float>* b = TO_TENSOR_PTR(direct_out);
+                correct = correct && a->isSameSizeAs(*b);
+                for (uint32_t i = 0; correct && i < a->nelems(); i++) {
+                    correct = fabsf(a->getData()[i] - b->getData()[i]) <=
+                        mtorch_FLOAT_PRECISION * 10 * std::max<float>(1.0f, fabsf(b->getData()[i]));
+                }
+                SAFE_DELETE(output_conv);
+                SAFE_DELETE(direct_out);
+                if (s == 0) {
+                    testWeightsRefresh(gemm, *gemm.weights(), *gemm.biases(), bs_in,
+                        "SpatialConvolutionGemm block-sparse");
+                }
+            }
+            assertTrue(correct, "Block-sparse weights");
+        }
+
+        // Packed weights: K deeper than one rank-k update (40 * 3 * 3),
+        // output planes and pixels that are not multiples of the kernel's
+        // tile; Gemm must match Direct
+        {
+            const uint32_t fin = 40, fout = 13;
+            const uint32_t pk_size[3] = {9, 7, fin};
+            Tensor<float> pk_in(3, pk_size);
+            for (uint32_t i = 0; i < pk_in.nelems(); i++) {
+                pk_in.getData()[i] = (float)((i * 11) % 29) / 29.0f - 0.5f;
+            }
+            std::vector<float> pw(fout * fin * 9);
+            for (uint32_t i = 0; i < pw.size(); i++) {
+                pw[i] = (float)((i * 7) % 31) / 31.0f - 0.5f;
+            }
+            SpatialConvolutionGemm gemm(fin, fout, 3, 3, 1, 1);
+            SpatialConvolutionDirect direct(fin, fout, 3, 3, 1, 1);
+            gemm.setWeights(pw.data());
+            direct.setWeights(pw.data());
+            Tensor<float>::fill(*gemm.biases(), 0.25f);
+            Tensor<float>::fill(*direct.biases(), 0.25f);
+            TorchData* direct_out = NULL;
+            gemm.forwardProp(pk_in, &output_conv);
+            direct.forwardProp(pk_in, &direct_out);
+            Tensor<float>* a = TO_TENSOR_PTR(output_conv);
+            Tensor<float>* b = TO_TENSOR_PTR(direct_out);
+            bool correct = a->isSameSizeAs(*b);
+            for (uint32_t i = 0; correct && i < a->nelems(); i++) {
+                correct = fabsf(a->getData()[i] - b->getData()[i]) <=
+                    mtorch_FLOAT_PRECISION * 10 * std::max<float>(1.0f, fabsf(b->getData()[i]));
+            }
+            SAFE_DELETE(output_conv);
+            SAFE_DELETE(direct_out);
+            assertTrue(correct, "Packed weights");
+        }
+
+        // Threaded GEMM: products big enough to be split by rows (m > n) and
+        // by columns, in every transpose, with both bias modes, must match a
+        // serial reference
+        {
+            const int dims[2][2] = {{150, 70}, {70, 150}};
+            const int k = 300;
+            std::vector<float> ga(150 * k), gb(150 * k), gbias(150);
+            for (size_t i = 0; i < ga.size(); i++) {
+                ga[i] = (float)((i * 13) % 37) / 37.0f - 0.5f;
+                gb[i] = (float)((i * 5) % 23) / 23.0f - 0.5f;
+            }
+            for (size_t i = 0; i < gbias.size(); i++) {
+                gbias[i] = (float)i / 150.0f;
+            }
+            Blas::setGemmThreads(4);
+            bool correct = true;
+            for (int d = 0; d < 2; d++) {
+                const int m = dims[d][0], n = dims[d][1];
+                for (int t = 0; t < 8; t++) {
+                    const char ta = (t & 1) ? 't' : 'n';
+                    const char tb = (t & 2) ? 't' : 'n';
+                    const bool columns = (t & 4) != 0;
+                    const int lda = ta == 'n' ? m : k;
+                    const int ldb = tb == 'n' ? k : n;
+                    std::vector<float> c(m * n, 1.0f);
+                    Blas::gemmBias(ta, tb, m, n, k, 1, ga.data(), lda, gb.data(), ldb, 0.5f,
+                        c.data(), m, gbias.data(), columns ? Blas::BIAS_COLUMNS : Blas::BIAS_ROWS);
+                    for (int j = 0; correct && j < n; j++) {
+                        for (int i = 0; correct && i < m; i++) {
+                            double ref = 0.5 + gbias[columns ? j : i];
+                            for (int kk = 0; kk < k; kk++) {
+                                ref += (double)ga[ta == 'n' ? i + kk * lda : kk + i * lda] *
+                                    gb[tb == 'n' ? kk + j * ldb : j + kk * ldb];
+                            }
+                            correct = fabs(c[i + j * m] - ref) <=
+                                mtorch_FLOAT_PRECISION * 10 * std::max(1.0, fabs(ref)) * k;
+                        }
+                    }
+                }
+            }
+            Blas::setGemmThreads(0);
+            assertTrue(correct, "Blas::gemm threaded");
+        }
+
+        // Native GEMM backend: edge tiles, matrix-vector products, more
+        // columns than one cache block (GEMM_NC) and rows than one panel
+        // block (GEMM_MC), k past one rank-k update, an empty k, every
+        // transpose, beta and both bias modes applied as the tiles are stored
+        {
+            const int shapes[7][3] = {{1, 1, 1}, {37, 5, 300}, {5, 37, 19}, {130, 1, 513},
+                                      {1100, 13, 20}, {19, 80, 7}, {7, 9, 0}};
+            std::vector<float> ga(1100 * 513), gb(513 * 80), gbias(1100);
+            for (size_t i = 0; i < ga.size(); i++) {
+                ga[i] = (float)((i * 13) % 37) / 37.0f - 0.5f;
+            }
+            for (size_t i = 0; i < gb.size(); i++) {
+                gb[i] = (float)((i * 5) % 23) / 23.0f - 0.5f;
+            }
+            for (size_t i = 0; i < gbias.size(); i++) {
+                gbias[i] = (float)(i % 7) / 7.0f;
+            }
+            Blas::setGemmBackend(Blas::GEMM_NATIVE);
+            Blas::setGemmThreads(1);
+            bool correct = true;
+            for (int s = 0; s < 7; s++) {
+                const int m = shapes[s][0], n = shapes[s][1], k = shapes[s][2];
+                const Blas::BiasMode mode = (s & 1) ? Blas::BIAS_COLUMNS : Blas::BIAS_ROWS;
+                for (int t = 0; t < 8; t++) {
+                    const char ta = (t & 1) ? 't' : 'n';
+                    const char tb = (t & 2) ? 't' : 'n';
+                    const bool biased = (t & 4) != 0;
+                    const int lda = std::max(ta == 'n' ? m : k, 1);
+                    const int ldb = std::max(tb == 'n' ? k : n, 1);
+                    const int ldc = m + 3;
+                    const float beta = biased ? (t & 1 ? 0 : 0.25f) : 0.5f;
+                    std::vector<float> c(ldc * n, 1.0f);
+                    if (biased) {
+                        Blas::gemmBias(ta, tb, m, n, k, 0.5f, ga.data(), lda, gb.data(), ldb, beta,
+                            c.data(), ldc, gbias.data(), mode);
+                    } else {
+                        Blas::gemm(ta, tb, m, n, k, 0.5f, ga.data(), lda, gb.data(), ldb, beta,
+                            c.data(), ldc);
+                    }
+                    for (int j = 0; correct && j < n; j++) {
+                        for (int i = 0; correct && i < ldc; i++) {
+                            if (i >= m) {
+                                correct = c[i + j * ldc] == 1.0f;
+                                continue;
+                            }
+                            double ref = beta;
+                            if (biased) {
+                                ref += gbias[mode == Blas::BIAS_ROWS ? i : j];
+                            }
+                            for (int kk = 0; kk < k; kk++) {
+                                ref += 0.5 * ga[ta == 'n' ? i + kk * lda : kk + i * lda] *
+                                    gb[tb == 'n' ? kk + j * ldb : j + kk * ldb];
+                            }
+                            correct = fabs(c[i + j * ldc] - ref) <=
+                                mtorch_FLOAT_PRECISION * 10 * std::max(1.0, fabs(ref)) * std::max(k, 1);
+                        }
+                    }
+                }
+            }
+            Blas::setGemmThreads(0);
+            Blas::setGemmBackend(Blas::GEMM_EIGEN);
+            assertTrue(correct, "Blas::gemm native");
+        }
         SAFE_DELETE(output);
         delete conv;
         delete convmm;
@@ -254,6 +1297,25 @@ public:
         lin_stage.forwardProp(*data, &output);
         testmtorchValue(TO_TENSOR_PTR(output),"linear.bin");
         SAFE_DELETE(output);
+
+        // ***********************************************
+        // Test PlanCache (the weights stand in for the model bytes)
+        std::vector<uint8_t> model_bytes((uint8_t*)lweights, (uint8_t*)lweights + sizeof(lweights));
+        // The entry is removed first, so a rerun starts from a miss again
+        PlanCache cache(".");
+        const std::string entry = cache.entryPath(PlanCache::makeKey(model_bytes, 3, isize));
+        remove(entry.c_str());
+        bool hit_first = true, hit_second = false, hit_corrupt = true;
+        ExecutionPlan plan = cache.prepare(model_bytes, lin_stage, 3, isize, &hit_first);
+        cache.prepare(model_bytes, lin_stage, 3, isize, &hit_second);
+        std::fstream corrupt(entry.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        corrupt.seekp(16);
+        corrupt.put('\x7f');
+        corrupt.close();
+        cache.prepare(model_bytes, lin_stage, 3, isize, &hit_corrupt);
+        remove(entry.c_str());
+        assertTrue(!hit_first && hit_second && !hit_corrupt && plan.stages.size() == 2 &&
+            plan.stages[1].out_size == std::vector<uint32_t>(1, lin_size_out), "PlanCache");
         }
 
         /*